@@ -17,17 +17,16 @@ You should have received a copy of the GNU General Public License
 along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <stdio.h>
+/*
+ * The bencode tree that krpc.c replaced, as it was. Only krpc-bench uses it
+ * to compare both decoders. The encoder is gone.
+ */
+
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/stat.h>
-#include <arpa/inet.h>
-#include <netinet/in.h>
-#include <signal.h>
 #include <errno.h>
 
-#include "ben.h"
+#include "ben-tree.h"
 
 BEN *ben_init(int type)
 {
@@ -133,21 +132,6 @@ ITEM *ben_free_item(BEN * node, ITEM * item)
 	return list_del(node->v.d, item);
 }
 
-RAW *raw_init(void)
-{
-	RAW *raw = (RAW *) myalloc(sizeof(RAW));
-	raw->code = NULL;
-	raw->size = 0;
-	raw->p = NULL;
-	return raw;
-}
-
-void raw_free(RAW * raw)
-{
-	myfree(raw->code);
-	myfree(raw);
-}
-
 TUPLE *tuple_init(BEN * key, BEN * val)
 {
 	TUPLE *tuple = (TUPLE *) myalloc(sizeof(TUPLE));
@@ -243,187 +227,6 @@ void ben_int(BEN * node, LONG i)
 	node->v.i = i;
 }
 
-LONG ben_enc_size(BEN * node)
-{
-	ITEM *item = NULL;
-	TUPLE *tuple = NULL;
-	char buf[BUF_SIZE];
-	LONG size = 0;
-
-	if (node == NULL) {
-		return size;
-	}
-
-	switch (node->t) {
-	case BEN_DICT:
-		size += 2;	/* de */
-
-		if (node->v.d == NULL) {
-			return size;
-		}
-
-		if (node->v.d->item == NULL) {
-			return size;
-		}
-
-		item = list_start(node->v.d);
-		do {
-			tuple = list_value(item);
-
-			if (tuple->key != NULL && tuple->val != NULL) {
-				size += ben_enc_size(tuple->key);
-				size += ben_enc_size(tuple->val);
-			}
-
-			item = list_next(item);
-
-		} while (item != NULL);
-
-		break;
-
-	case BEN_LIST:
-		size += 2;	/* le */
-
-		if (node->v.l == NULL) {
-			return size;
-		}
-
-		if (node->v.l->item == NULL) {
-			return size;
-		}
-
-		item = list_start(node->v.l);
-		do {
-			if (item->val != NULL) {
-				size += ben_enc_size(item->val);
-			}
-			item = list_next(item);
-
-		} while (item != NULL);
-
-		break;
-
-	case BEN_INT:
-		snprintf(buf, BUF_SIZE, "i%lie", node->v.i);
-		size += strlen(buf);
-		break;
-
-	case BEN_STR:
-		snprintf(buf, BUF_SIZE, "%li:", node->v.s->i);
-		size += strlen(buf) + node->v.s->i;
-		break;
-
-	}
-
-	return size;
-}
-
-RAW *ben_enc(BEN * node)
-{
-	RAW *raw = raw_init();
-
-	/* Calculate size of ben data */
-	raw->size = ben_enc_size(node);
-	if (raw->size <= 0) {
-		raw_free(raw);
-		return NULL;
-	}
-
-	/* Encode ben object */
-	raw->code = (UCHAR *) myalloc(raw->size * sizeof(UCHAR));
-	raw->p = ben_enc_rec(node, raw->code);
-	if (raw->p == NULL || (LONG) (raw->p - raw->code) != raw->size) {
-		raw_free(raw);
-		return NULL;
-	}
-
-	return raw;
-}
-
-UCHAR *ben_enc_rec(BEN * node, UCHAR * p)
-{
-	ITEM *item = NULL;
-	TUPLE *tuple = NULL;
-	char buf[BUF_SIZE];
-	LONG len = 0;
-
-	if (node == NULL || p == NULL) {
-		return NULL;
-	}
-
-	switch (node->t) {
-	case BEN_DICT:
-		*p++ = 'd';
-
-		if (node->v.d != NULL && node->v.d->item != NULL) {
-			item = list_start(node->v.d);
-			do {
-				tuple = list_value(item);
-
-				if (tuple->key != NULL && tuple->val != NULL) {
-					if ((p =
-					     ben_enc_rec(tuple->key,
-							 p)) == NULL) {
-						return NULL;
-					}
-
-					if ((p =
-					     ben_enc_rec(tuple->val,
-							 p)) == NULL) {
-						return NULL;
-					}
-				}
-
-				item = list_next(item);
-
-			} while (item != NULL);
-		}
-
-		*p++ = 'e';
-		break;
-
-	case BEN_LIST:
-		*p++ = 'l';
-
-		if (node->v.l != NULL && node->v.l->item != NULL) {
-			item = list_start(node->v.l);
-			do {
-				if ((p = ben_enc_rec(item->val, p)) == NULL) {
-					return NULL;
-				}
-
-				item = list_next(item);
-
-			} while (item != NULL);
-		}
-
-		*p++ = 'e';
-		break;
-
-	case BEN_INT:
-		snprintf(buf, BUF_SIZE, "i%lie", node->v.i);
-		len = strlen(buf);
-		memcpy(p, buf, len);
-		p += len;
-		break;
-
-	case BEN_STR:
-		/* Meta */
-		snprintf(buf, BUF_SIZE, "%li:", node->v.s->i);
-		len = strlen(buf);
-		memcpy(p, buf, len);
-		p += len;
-		/* Data */
-		if (node->v.s->i > 0) {
-			memcpy(p, node->v.s->s, node->v.s->i);
-			p += node->v.s->i;
-		}
-		break;
-
-	}
-
-	return p;
-}
 
 BEN *ben_dec(UCHAR * bencode, LONG bensize)
 {
@@ -969,107 +772,6 @@ LONG ben_str_i(BEN * node)
 	return node->v.s->i;
 }
 
-#if 0
-void ben_sort(BEN * node)
-{
-	ITEM *item = NULL;
-	ITEM *next = NULL;
-	BEN *key1 = NULL;
-	BEN *key2 = NULL;
-	TUPLE *tuple_this = NULL;
-	TUPLE *tuple_next = NULL;
-	LONG switchcounter = 0;
-	int result = 0;
-
-	if (node == NULL) {
-		fail("ben_sort( 1 )");
-	}
-	if (node->t != BEN_DICT) {
-		fail("ben_sort( 2 )");
-	}
-	if (node->v.d == NULL) {
-		return;
-	}
-	if (node->v.d->counter < 2) {
-		return;
-	}
-
-	item = node->v.d->start;
-
-	while (1) {
-		next = list_next(item);
-
-		/* Reached the end */
-		if (next == node->v.d->start) {
-			if (switchcounter == 0) {
-				/* The list is sorted now */
-				break;
-			}
-
-			/* Reset switchcounter ... */
-			switchcounter = 0;
-
-			/* ... and start again */
-			item = node->v.d->start;
-			next = list_next(item);
-		}
-
-		tuple_this = list_value(item);
-		tuple_next = list_value(next);
-		key1 = tuple_this->key;
-		key2 = tuple_next->key;
-
-		result = ben_str_compare(key1, key2);
-		if (result > 0) {
-			list_swap(node->v.d, item, next);
-			switchcounter++;
-
-			/* Continue moving up until start is reached */
-			if (next != node->v.d->start) {
-				item = list_prev(next);
-			}
-		} else {
-			/* Move down */
-			item = next;
-		}
-	}
-}
-
-int ben_str_compare(BEN * key1, BEN * key2)
-{
-	LONG size = 0;
-	LONG i = 0;
-
-	if (!ben_is_str(key1)) {
-		return -1;
-	}
-
-	if (!ben_is_str(key2)) {
-		return 1;
-	}
-
-	size = (key1->v.s->i > key2->v.s->i) ? key1->v.s->i : key2->v.s->i;
-
-	for (i = 0; i < size; i++) {
-		if (key1->v.s->s[i] > key2->v.s->s[i]) {
-			return 1;
-		} else if (key1->v.s->s[i] < key2->v.s->s[i]) {
-			return -1;
-		}
-	}
-
-	/* Strings are equal for the first $size characters */
-	if (key1->v.s->i > key2->v.s->i) {
-		return 1;
-	} else if (key1->v.s->i < key2->v.s->i) {
-		return -1;
-	}
-
-	/* Equal */
-	return 0;
-}
-#endif
-
 STR *str_init(UCHAR * buf, LONG size)
 {
 	STR *str = (STR *) myalloc(sizeof(STR));
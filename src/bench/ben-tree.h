@@ -0,0 +1,90 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BEN_TREE_H
+#define BEN_TREE_H
+
+#include "../shr/config.h"
+#include "../shr/list.h"
+#include "../shr/fail.h"
+#include "../p2p/ben.h"
+
+#define BEN_STR  0
+#define BEN_INT  1
+#define BEN_LIST 2
+#define BEN_DICT 3
+
+typedef struct {
+	int t;
+
+	union {
+		LONG i;
+		STR *s;
+		LIST *d;
+		LIST *l;
+	} v;
+} BEN;
+
+typedef struct {
+	BEN *key;
+	BEN *val;
+} TUPLE;
+
+BEN *ben_init(int type);
+void ben_free(BEN * node);
+void ben_free_r(BEN * node);
+ITEM *ben_free_item(BEN * node, ITEM * item);
+
+void ben_dict(BEN * node, BEN * key, BEN * val);
+void ben_list(BEN * node, BEN * val);
+void ben_str(BEN * node, UCHAR * str, LONG len);
+void ben_int(BEN * node, LONG i);
+
+TUPLE *tuple_init(BEN * key, BEN * val);
+void tuple_free(TUPLE * tuple);
+
+int ben_validate(UCHAR * bencode, LONG bensize);
+int ben_validate_r(RAW * raw);
+int ben_validate_d(RAW * raw);
+int ben_validate_l(RAW * raw);
+int ben_validate_i(RAW * raw);
+int ben_validate_s(RAW * raw);
+
+BEN *ben_dec(UCHAR * bencode, LONG bensize);
+BEN *ben_dec_r(RAW * raw);
+BEN *ben_dec_d(RAW * raw);
+BEN *ben_dec_l(RAW * raw);
+BEN *ben_dec_i(RAW * raw);
+BEN *ben_dec_s(RAW * raw);
+
+int ben_is_dict(BEN * node);
+int ben_is_list(BEN * node);
+int ben_is_str(BEN * node);
+int ben_is_int(BEN * node);
+
+BEN *ben_dict_search_key(BEN * node, BEN * key);
+BEN *ben_dict_search_str(BEN * node, const char *buffer);
+
+UCHAR *ben_str_s(BEN * node);
+LONG ben_str_i(BEN * node);
+
+STR *str_init(UCHAR * buf, LONG size);
+void str_free(STR * str);
+
+#endif
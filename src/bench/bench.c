@@ -0,0 +1,41 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <time.h>
+
+#include "bench.h"
+#include "../shr/log.h"
+
+/* Nothing gets logged, but the pool of list items wants to */
+struct obj_log *_log = NULL;
+
+double bench_now(void)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void bench_print(const char *name, double seconds, long int rounds)
+{
+	printf("%-32s %10.1f ns\n", name, seconds / rounds * 1e9);
+}
@@ -0,0 +1,33 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "../shr/config.h"
+
+/*
+ * Micro benchmarks. They are not part of "make all". Run "make bench". Every
+ * benchmark checks its results first and exits with 1 if they are wrong.
+ */
+
+double bench_now(void);
+void bench_print(const char *name, double seconds, long int rounds);
+
+#endif
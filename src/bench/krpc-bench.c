@@ -0,0 +1,291 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "krpc-bench.h"
+
+#define KRPC_BENCH_ID "abcdefghij0123456789"
+#define KRPC_BENCH_NODE "abcdefghijklmnopqrstuvwxyz"
+
+#ifdef IPV6
+#define KRPC_BENCH_NODES "6:nodes6"
+#elif IPV4
+#define KRPC_BENCH_NODES "5:nodes"
+#endif
+
+/* Typical datagrams. The ids are printable to keep them readable here. */
+static const KRPC_SAMPLE krpc_sample[] = {
+	{"ping",
+	 "d1:ad2:id20:" KRPC_BENCH_ID "e1:q4:ping1:t4:aaaa1:y1:qe"},
+	{"find_node",
+	 "d1:ad2:id20:" KRPC_BENCH_ID "6:target20:" KRPC_BENCH_ID
+	 "e1:q9:find_node1:t4:aaaa1:y1:qe"},
+	{"get_peers",
+	 "d1:ad2:id20:" KRPC_BENCH_ID "9:info_hash20:" KRPC_BENCH_ID
+	 "e1:q9:get_peers1:t4:aaaa1:y1:qe"},
+	{"announce_peer",
+	 "d1:ad2:id20:" KRPC_BENCH_ID "9:info_hash20:" KRPC_BENCH_ID
+	 "4:porti6881e5:token8:tokentkne1:q13:announce_peer1:t4:aaaa1:y1:qe"},
+	{"find_node reply",
+	 "d1:rd2:id20:" KRPC_BENCH_ID KRPC_BENCH_NODES "208:"
+	 KRPC_BENCH_NODE KRPC_BENCH_NODE KRPC_BENCH_NODE KRPC_BENCH_NODE
+	 KRPC_BENCH_NODE KRPC_BENCH_NODE KRPC_BENCH_NODE KRPC_BENCH_NODE
+	 "e1:t4:aaaa1:y1:re"},
+	{"get_peers reply",
+	 "d1:rd2:id20:" KRPC_BENCH_ID "5:token8:tokentkn6:valuesl"
+	 "6:AAAAAA6:BBBBBB6:CCCCCC6:DDDDDD6:EEEEEE6:FFFFFF6:GGGGGG6:HHHHHH"
+	 "ee1:t4:aaaa1:y1:re"},
+	{"error",
+	 "d1:eli201e13:Generic Errore1:t4:aaaa1:y1:ee"},
+};
+
+int main(void)
+{
+	int n = sizeof(krpc_sample) / sizeof(KRPC_SAMPLE);
+	int bad = 0;
+	int i = 0;
+
+	for (i = 0; i < n; i++) {
+		bad += krpc_bench_compare(&krpc_sample[i]);
+	}
+	if (bad > 0) {
+		printf("%i samples decoded differently\n", bad);
+		return 1;
+	}
+
+	for (i = 0; i < n; i++) {
+		krpc_bench_decode(&krpc_sample[i]);
+	}
+
+	return 0;
+}
+
+int krpc_bench_compare(const KRPC_SAMPLE * sample)
+{
+	UCHAR *bencode = (UCHAR *) sample->bencode;
+	LONG bensize = strlen(sample->bencode);
+	KRPC tree;
+	KRPC flat;
+	BEN *packet = NULL;
+	int bad = 0;
+
+	packet = krpc_bench_tree(&tree, bencode, bensize);
+	if (packet == NULL || !krpc_decode(&flat, bencode, bensize)) {
+		printf("%s: Not decoded\n", sample->name);
+		ben_free(packet);
+		return 1;
+	}
+
+	if (!krpc_bench_same(&tree, &flat)) {
+		printf("%s: Decoded differently\n", sample->name);
+		bad = 1;
+	}
+
+	ben_free(packet);
+
+	return bad;
+}
+
+void krpc_bench_decode(const KRPC_SAMPLE * sample)
+{
+	UCHAR *bencode = (UCHAR *) sample->bencode;
+	LONG bensize = strlen(sample->bencode);
+	char name[64];
+	KRPC msg;
+	double start = 0;
+	long int i = 0;
+
+	start = bench_now();
+	for (i = 0; i < KRPC_BENCH_ROUNDS; i++) {
+		ben_free(krpc_bench_tree(&msg, bencode, bensize));
+	}
+	snprintf(name, sizeof(name), "ben tree, %s", sample->name);
+	bench_print(name, bench_now() - start, KRPC_BENCH_ROUNDS);
+
+	start = bench_now();
+	for (i = 0; i < KRPC_BENCH_ROUNDS; i++) {
+		krpc_decode(&msg, bencode, bensize);
+	}
+	snprintf(name, sizeof(name), "krpc_decode, %s", sample->name);
+	bench_print(name, bench_now() - start, KRPC_BENCH_ROUNDS);
+}
+
+/* The old way. The slices point into the tree, so it has to live on. */
+BEN *krpc_bench_tree(KRPC * msg, UCHAR * bencode, LONG bensize)
+{
+	BEN *packet = NULL;
+	BEN *node = NULL;
+
+	memset(msg, '\0', sizeof(KRPC));
+
+	if (!ben_validate(bencode, bensize)) {
+		return NULL;
+	}
+
+	packet = ben_dec(bencode, bensize);
+	if (!ben_is_dict(packet)) {
+		ben_free(packet);
+		return NULL;
+	}
+
+	krpc_bench_str(&msg->y, ben_dict_search_str(packet, "y"));
+	krpc_bench_str(&msg->t, ben_dict_search_str(packet, "t"));
+	krpc_bench_str(&msg->q, ben_dict_search_str(packet, "q"));
+
+	node = ben_dict_search_str(packet, "a");
+	if (ben_is_dict(node)) {
+		msg->a = 1;
+		krpc_bench_arg(msg, node);
+	}
+
+	node = ben_dict_search_str(packet, "r");
+	if (ben_is_dict(node)) {
+		msg->r = 1;
+		krpc_bench_arg(msg, node);
+	}
+
+	node = ben_dict_search_str(packet, "e");
+	if (ben_is_list(node)) {
+		msg->e = 1;
+		krpc_bench_error(msg, node);
+	}
+
+	return packet;
+}
+
+void krpc_bench_arg(KRPC * msg, BEN * dict)
+{
+	BEN *node = NULL;
+	ITEM *item = NULL;
+
+	krpc_bench_str(&msg->id, ben_dict_search_str(dict, "id"));
+	krpc_bench_str(&msg->target, ben_dict_search_str(dict, "target"));
+	krpc_bench_str(&msg->info_hash,
+		       ben_dict_search_str(dict, "info_hash"));
+	krpc_bench_str(&msg->token, ben_dict_search_str(dict, "token"));
+#ifdef IPV6
+	krpc_bench_str(&msg->nodes, ben_dict_search_str(dict, "nodes6"));
+#elif IPV4
+	krpc_bench_str(&msg->nodes, ben_dict_search_str(dict, "nodes"));
+#endif
+
+	node = ben_dict_search_str(dict, "port");
+	if (ben_is_int(node)) {
+		msg->port_found = 1;
+		msg->port = node->v.i;
+	}
+
+	node = ben_dict_search_str(dict, "values");
+	if (!ben_is_list(node)) {
+		return;
+	}
+
+	msg->values_found = 1;
+	item = list_start(node->v.l);
+	while (item != NULL && msg->values_size < KRPC_VALUES_MAX) {
+		krpc_bench_str(&msg->values[msg->values_size],
+			       list_value(item));
+		msg->values_size++;
+		item = list_next(item);
+	}
+}
+
+void krpc_bench_error(KRPC * msg, BEN * list)
+{
+	ITEM *item = list_start(list->v.l);
+	BEN *node = NULL;
+
+	if (item == NULL) {
+		return;
+	}
+
+	node = list_value(item);
+	if (ben_is_int(node)) {
+		msg->e_code_found = 1;
+		msg->e_code = node->v.i;
+		item = list_next(item);
+	}
+
+	while (item != NULL) {
+		krpc_bench_str(&msg->e_msg, list_value(item));
+		item = list_next(item);
+	}
+}
+
+void krpc_bench_str(STR * str, BEN * node)
+{
+	if (!ben_is_str(node)) {
+		str->s = NULL;
+		str->i = 0;
+		return;
+	}
+
+	str->s = ben_str_s(node);
+	str->i = ben_str_i(node);
+}
+
+int krpc_bench_same(const KRPC * a, const KRPC * b)
+{
+	int i = 0;
+
+	if (!krpc_bench_same_str(&a->y, &b->y) ||
+	    !krpc_bench_same_str(&a->t, &b->t) ||
+	    !krpc_bench_same_str(&a->q, &b->q) ||
+	    !krpc_bench_same_str(&a->id, &b->id) ||
+	    !krpc_bench_same_str(&a->target, &b->target) ||
+	    !krpc_bench_same_str(&a->info_hash, &b->info_hash) ||
+	    !krpc_bench_same_str(&a->token, &b->token) ||
+	    !krpc_bench_same_str(&a->nodes, &b->nodes) ||
+	    !krpc_bench_same_str(&a->e_msg, &b->e_msg)) {
+		return 0;
+	}
+
+	if (a->a != b->a || a->r != b->r || a->e != b->e) {
+		return 0;
+	}
+	if (a->port_found != b->port_found || a->port != b->port) {
+		return 0;
+	}
+	if (a->e_code_found != b->e_code_found || a->e_code != b->e_code) {
+		return 0;
+	}
+	if (a->values_found != b->values_found ||
+	    a->values_size != b->values_size) {
+		return 0;
+	}
+
+	for (i = 0; i < a->values_size; i++) {
+		if (!krpc_bench_same_str(&a->values[i], &b->values[i])) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+int krpc_bench_same_str(const STR * a, const STR * b)
+{
+	if (a->s == NULL || b->s == NULL) {
+		return a->s == b->s;
+	}
+
+	return a->i == b->i && memcmp(a->s, b->s, a->i) == 0;
+}
@@ -0,0 +1,48 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KRPC_BENCH_H
+#define KRPC_BENCH_H
+
+#include "../p2p/krpc.h"
+#include "ben-tree.h"
+#include "bench.h"
+
+/* krpc_decode() against ben_validate() + ben_dec() + ben_dict_search_str()
+ * as p2p_parse() did it before. Both have to agree on every sample. */
+#define KRPC_BENCH_ROUNDS 200000
+
+struct obj_krpc_sample {
+	const char *name;
+	const char *bencode;
+};
+typedef struct obj_krpc_sample KRPC_SAMPLE;
+
+int krpc_bench_compare(const KRPC_SAMPLE * sample);
+void krpc_bench_decode(const KRPC_SAMPLE * sample);
+
+BEN *krpc_bench_tree(KRPC * msg, UCHAR * bencode, LONG bensize);
+void krpc_bench_arg(KRPC * msg, BEN * dict);
+void krpc_bench_error(KRPC * msg, BEN * list);
+void krpc_bench_str(STR * str, BEN * node);
+
+int krpc_bench_same(const KRPC * a, const KRPC * b);
+int krpc_bench_same_str(const STR * a, const STR * b);
+
+#endif
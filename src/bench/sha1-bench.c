@@ -0,0 +1,270 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sha1-bench.h"
+
+/* FIPS 180-2, appendix A */
+static const SHA1_VECTOR sha1_vector[] = {
+	{"", 1, "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+	{"abc", 1, "a9993e364706816aba3e25717850c26c9cd0d89d"},
+	{"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+	 "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+	{"a", 1000000, "34aa973cd4c4daa4f61eeb2bdbad27316534016f"},
+};
+
+/* RFC 2202, test cases 1 to 3 */
+static const HMAC_VECTOR hmac_vector[] = {
+	{0x0b, 20, NULL, 0, 8, "Hi There",
+	 "b617318655057264e28bc0b6fb378c8ef146be00"},
+	{0, 4, "Jefe", 0, 28, "what do ya want for nothing?",
+	 "effcdf6ae5eb2fa2d27416d5f184df9c259a7c79"},
+	{0xaa, 20, NULL, 0xdd, 50, NULL,
+	 "125d7342b9ac11cd91a39af48aa17b4f63f175d3"},
+};
+
+static char sha1_buf[SHA1_BENCH_BUF];
+
+int main(void)
+{
+	int bad = 0;
+	int i = 0;
+
+	srand(23);
+	for (i = 0; i < SHA1_BENCH_BUF; i++) {
+		sha1_buf[i] = rand();
+	}
+
+	sha1_init();
+	printf("SHA1: %s\n", sha1_backend());
+
+	bad += sha1_bench_vectors();
+	bad += sha1_bench_hmac();
+	bad += sha1_bench_compare();
+	if (bad > 0) {
+		printf("%i wrong digests\n", bad);
+		return 1;
+	}
+
+	sha1_bench_short();
+	sha1_bench_long();
+
+	return 0;
+}
+
+int sha1_bench_vectors(void)
+{
+	int n = sizeof(sha1_vector) / sizeof(SHA1_VECTOR);
+	const SHA1_VECTOR *v = NULL;
+	UCHAR a[SHA1_SIZE];
+	UCHAR b[SHA1_SIZE];
+	UCHAR *hash[2] = { a, b };
+	const char *buffer[2];
+	long int bytes[2];
+	char *msg = NULL;
+	long int len = 0;
+	long int size = 0;
+	int bad = 0;
+	int i = 0;
+	long int j = 0;
+
+	for (i = 0; i < n; i++) {
+		v = &sha1_vector[i];
+		len = strlen(v->msg);
+		size = len * v->repeat;
+		msg = malloc(size + 1);
+		for (j = 0; j < v->repeat; j++) {
+			memcpy(msg + j * len, v->msg, len);
+		}
+
+		sha1_hash(a, msg, size);
+		bad += sha1_bench_check("sha1_hash", a, v->digest);
+
+		sha1_digest_portable(a, NULL, msg, size);
+		bad += sha1_bench_check("portable", a, v->digest);
+
+		/* Next to a message of a different length */
+		buffer[0] = msg;
+		bytes[0] = size;
+		buffer[1] = sha1_vector[(i + 1) % n].msg;
+		bytes[1] = strlen(buffer[1]);
+		sha1_hash_many(hash, buffer, bytes, 2);
+		bad += sha1_bench_check("sha1_hash_many", a, v->digest);
+
+		free(msg);
+	}
+
+	return bad;
+}
+
+int sha1_bench_hmac(void)
+{
+	int n = sizeof(hmac_vector) / sizeof(HMAC_VECTOR);
+	const HMAC_VECTOR *v = NULL;
+	UCHAR key[SHA1_BLOCK_SIZE];
+	char msg[SHA1_BLOCK_SIZE];
+	UCHAR hash[SHA1_SIZE];
+	int bad = 0;
+	int i = 0;
+
+	for (i = 0; i < n; i++) {
+		v = &hmac_vector[i];
+
+		if (v->key != NULL) {
+			memcpy(key, v->key, v->key_size);
+		} else {
+			memset(key, v->key_byte, v->key_size);
+		}
+		if (v->msg != NULL) {
+			memcpy(msg, v->msg, v->msg_size);
+		} else {
+			memset(msg, v->msg_byte, v->msg_size);
+		}
+
+		sha1_hmac_hash(hash, key, v->key_size, msg, v->msg_size);
+		bad += sha1_bench_check("sha1_hmac_hash", hash, v->digest);
+	}
+
+	return bad;
+}
+
+/* Every length up to a few blocks, alone and in batches */
+int sha1_bench_compare(void)
+{
+	UCHAR out[7][SHA1_SIZE];
+	UCHAR *hash[7];
+	const char *buffer[7];
+	long int bytes[7];
+	UCHAR a[SHA1_SIZE];
+	int bad = 0;
+	int i = 0;
+	int j = 0;
+	int n = 0;
+
+	for (i = 0; i <= 300; i++) {
+		sha1_hash(out[0], sha1_buf + i, i);
+		sha1_digest_portable(a, NULL, sha1_buf + i, i);
+		if (memcmp(a, out[0], SHA1_SIZE) != 0) {
+			printf("sha1_hash: %i bytes differ\n", i);
+			bad++;
+		}
+	}
+
+	for (i = 0; i < 2000; i++) {
+		n = 1 + i % 7;
+		for (j = 0; j < n; j++) {
+			hash[j] = out[j];
+			buffer[j] = sha1_buf + rand() % 1000;
+			bytes[j] = rand() % 300;
+		}
+
+		sha1_hash_many(hash, buffer, bytes, n);
+
+		for (j = 0; j < n; j++) {
+			sha1_digest_portable(a, NULL, buffer[j], bytes[j]);
+			if (memcmp(a, out[j], SHA1_SIZE) != 0) {
+				printf("sha1_hash_many: %li bytes differ\n",
+				       bytes[j]);
+				bad++;
+			}
+		}
+	}
+
+	return bad;
+}
+
+/* A host name and the realm, as hashed per DNS query */
+void sha1_bench_short(void)
+{
+	const char *buffer[2] = { "some-host.example.p2p", "realm-secret" };
+	long int bytes[2] = { strlen(buffer[0]), strlen(buffer[1]) };
+	UCHAR a[SHA1_SIZE];
+	UCHAR b[SHA1_SIZE];
+	UCHAR *hash[2] = { a, b };
+	volatile UCHAR sink = 0;
+	double start = 0;
+	long int i = 0;
+
+	start = bench_now();
+	for (i = 0; i < SHA1_BENCH_SHORT; i++) {
+		sha1_digest_portable(a, NULL, buffer[0], bytes[0]);
+		sha1_digest_portable(b, NULL, buffer[1], bytes[1]);
+		sink ^= a[0] ^ b[0];
+	}
+	bench_print("portable, 2 names", bench_now() - start,
+		    SHA1_BENCH_SHORT);
+
+	start = bench_now();
+	for (i = 0; i < SHA1_BENCH_SHORT; i++) {
+		sha1_hash(a, buffer[0], bytes[0]);
+		sha1_hash(b, buffer[1], bytes[1]);
+		sink ^= a[0] ^ b[0];
+	}
+	bench_print("sha1_hash, 2 names", bench_now() - start,
+		    SHA1_BENCH_SHORT);
+
+	start = bench_now();
+	for (i = 0; i < SHA1_BENCH_SHORT; i++) {
+		sha1_hash_many(hash, buffer, bytes, 2);
+		sink ^= a[0] ^ b[0];
+	}
+	bench_print("sha1_hash_many, 2 names", bench_now() - start,
+		    SHA1_BENCH_SHORT);
+}
+
+void sha1_bench_long(void)
+{
+	UCHAR hash[SHA1_SIZE];
+	volatile UCHAR sink = 0;
+	double start = 0;
+	long int i = 0;
+
+	start = bench_now();
+	for (i = 0; i < SHA1_BENCH_LONG; i++) {
+		sha1_digest_portable(hash, NULL, sha1_buf, SHA1_BENCH_BUF);
+		sink ^= hash[0];
+	}
+	bench_print("portable, 4 KiB", bench_now() - start, SHA1_BENCH_LONG);
+
+	start = bench_now();
+	for (i = 0; i < SHA1_BENCH_LONG; i++) {
+		sha1_hash(hash, sha1_buf, SHA1_BENCH_BUF);
+		sink ^= hash[0];
+	}
+	bench_print("sha1_hash, 4 KiB", bench_now() - start, SHA1_BENCH_LONG);
+}
+
+int sha1_bench_check(const char *name, const UCHAR * hash, const char *hex)
+{
+	unsigned int byte = 0;
+	int i = 0;
+
+	for (i = 0; i < SHA1_SIZE; i++) {
+		sscanf(hex + 2 * i, "%2x", &byte);
+		if (hash[i] != byte) {
+			printf("%s: Expected %s\n", name, hex);
+			return 1;
+		}
+	}
+
+	return 0;
+}
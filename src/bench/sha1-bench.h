@@ -0,0 +1,58 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SHA1_BENCH_H
+#define SHA1_BENCH_H
+
+#include "../p2p/sha1.h"
+#include "bench.h"
+
+/* SHA1 of the CPU against the portable code. The FIPS 180 and RFC 2202
+ * vectors come first. */
+#define SHA1_BENCH_SHORT 5000000
+#define SHA1_BENCH_LONG 200000
+#define SHA1_BENCH_BUF 4096
+
+struct obj_sha1_vector {
+	const char *msg;
+	long int repeat;
+	const char *digest;
+};
+typedef struct obj_sha1_vector SHA1_VECTOR;
+
+struct obj_hmac_vector {
+	UCHAR key_byte;
+	long int key_size;
+	const char *key;
+	UCHAR msg_byte;
+	long int msg_size;
+	const char *msg;
+	const char *digest;
+};
+typedef struct obj_hmac_vector HMAC_VECTOR;
+
+int sha1_bench_vectors(void);
+int sha1_bench_hmac(void);
+int sha1_bench_compare(void);
+void sha1_bench_short(void);
+void sha1_bench_long(void);
+
+int sha1_bench_check(const char *name, const UCHAR * hash, const char *hex);
+
+#endif
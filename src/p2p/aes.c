@@ -18,99 +18,109 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <stdlib.h>
+#include <string.h>
+#include <polarssl/version.h>
 #include <polarssl/sha2.h>
-#include <polarssl/aes.h>
+#include <polarssl/gcm.h>
 
 #include "aes.h"
+#include "../shr/random.h"
 
-struct obj_str *aes_encrypt(UCHAR * plain, int plainlen, UCHAR * iv, char *key,
-			    int keylen)
+/* Derived once. Every thread keeps its own GCM context. */
+static UCHAR aes_key[AES_KEY_SIZE];
+static __thread gcm_context aes_gcm;
+static __thread int aes_gcm_ready;
+
+void aes_init(char *key, int keylen)
 {
-	UCHAR ciphertext[AES_MSG_SIZE];
-	UCHAR digest[AES_KEY_SIZE];
-	UCHAR plain_padded[AES_MSG_SIZE];
-	UCHAR iv_local[AES_IV_SIZE];
-	aes_context aes_ctx;
-	int plainlen_padded = 0;
-	int i = 0;
-	struct obj_str *cipher = NULL;
+	aes_key_setup(aes_key, key, keylen);
+}
 
-	/* Plaintext out of boundary */
-	if (plainlen <= 0 || plainlen > AES_MSG_SIZE) {
-		return NULL;
-	}
+/* The key schedule runs once per thread */
+int aes_ready(void)
+{
+	int result = 0;
 
-	/* Compute padded plaintext length */
-	i = plainlen % AES_BLOCK_SIZE;
-	plainlen_padded = (i == 0) ? plainlen : plainlen - i + AES_BLOCK_SIZE;
+	if (aes_gcm_ready) {
+		return TRUE;
+	}
 
-	/* Plaintext out of boundary */
-	if (plainlen_padded <= 0 || plainlen_padded > AES_MSG_SIZE) {
-		return NULL;
+#if POLARSSL_VERSION_NUMBER >= 0x01030000
+	result = gcm_init(&aes_gcm, POLARSSL_CIPHER_ID_AES, aes_key,
+			  AES_KEY_SIZE * 8);
+#else
+	result = gcm_init(&aes_gcm, aes_key, AES_KEY_SIZE * 8);
+#endif
+	if (result != 0) {
+		return FALSE;
 	}
 
-	/* Store padded message */
-	memset(plain_padded, '\0', AES_MSG_SIZE);
-	memcpy(plain_padded, plain, plainlen);
+	aes_gcm_ready = TRUE;
+	return TRUE;
+}
 
-	/* Store iv locally because it gets modified by aes_crypt_cbc() later */
-	memcpy(iv_local, iv, AES_IV_SIZE);
+/* Returns the packet size or -1 */
+int aes_encrypt(UCHAR * packet, UCHAR * plain, int plainlen)
+{
+	UCHAR *nonce = packet + 1;
+	UCHAR *cipher = packet + AES_HEAD_SIZE;
 
-	/* Setup AES context with the key and the IV */
-	aes_key_setup(digest, iv_local, key, keylen);
-	if (aes_setkey_enc(&aes_ctx, digest, 256) != 0) {
-		return NULL;
+	/* Plaintext out of boundary */
+	if (plainlen <= 0 || plainlen > AES_MSG_SIZE) {
+		return -1;
 	}
 
-	/* Encrypt message */
-	if (aes_crypt_cbc
-	    (&aes_ctx, AES_ENCRYPT, plainlen_padded, iv_local, plain_padded,
-	     ciphertext) != 0) {
-		return NULL;
+	if (!aes_ready()) {
+		return -1;
 	}
-	cipher = str_init(ciphertext, plainlen_padded);
 
-	return cipher;
+	/* A random nonce. The key is shared by every node of the cloud. */
+	packet[0] = AES_VERSION;
+	rand_urandom(nonce, AES_NONCE_SIZE);
+
+	if (gcm_crypt_and_tag(&aes_gcm, GCM_ENCRYPT, plainlen,
+			      nonce, AES_NONCE_SIZE, packet, 1, plain, cipher,
+			      AES_TAG_SIZE, cipher + plainlen) != 0) {
+		return -1;
+	}
+
+	return AES_HEAD_SIZE + plainlen + AES_TAG_SIZE;
 }
 
-struct obj_str *aes_decrypt(UCHAR * cipher, int cipherlen, UCHAR * iv,
-			    char *key, int keylen)
+/* Returns the plaintext size or -1 if the packet is broken or forged */
+int aes_decrypt(UCHAR * plain, UCHAR * packet, int packetlen)
 {
-	UCHAR plaintext[AES_MSG_SIZE];
-	UCHAR digest[AES_KEY_SIZE];
-	aes_context aes_ctx;
-	struct obj_str *plain = NULL;
+	UCHAR *nonce = packet + 1;
+	UCHAR *cipher = packet + AES_HEAD_SIZE;
+	int cipherlen = packetlen - AES_HEAD_SIZE - AES_TAG_SIZE;
+
+	if (cipherlen <= 0 || cipherlen > AES_MSG_SIZE) {
+		return -1;
+	}
 
-	if (cipherlen % AES_BLOCK_SIZE != 0) {
-		return NULL;
+	if (packet[0] != AES_VERSION) {
+		return -1;
 	}
 
-	/* Setup AES context with the key and the IV */
-	aes_key_setup(digest, iv, key, keylen);
-	if (aes_setkey_dec(&aes_ctx, digest, 256) != 0) {
-		return NULL;
+	if (!aes_ready()) {
+		return -1;
 	}
 
-	/* Decrypt message */
-	memset(plaintext, '\0', AES_MSG_SIZE);
-	if (aes_crypt_cbc
-	    (&aes_ctx, AES_DECRYPT, cipherlen, iv, cipher, plaintext) != 0) {
-		return NULL;
+	if (gcm_auth_decrypt(&aes_gcm, cipherlen, nonce, AES_NONCE_SIZE,
+			     packet, 1, cipher + cipherlen, AES_TAG_SIZE,
+			     cipher, plain) != 0) {
+		return -1;
 	}
-	plain = str_init(plaintext, cipherlen);
 
-	/* The decrypted message may be bigger than the original message, but
-	 * the bencode parser can handle that. */
-	return plain;
+	return cipherlen;
 }
 
-void aes_key_setup(UCHAR * digest, UCHAR * iv, char *key, int keylen)
+void aes_key_setup(UCHAR * digest, char *key, int keylen)
 {
 	sha2_context sha_ctx;
 	int i = 0;
 
 	memset(digest, '\0', AES_KEY_SIZE);
-	memcpy(digest, iv, AES_IV_SIZE);
 	for (i = 0; i < AES_KEY_ROUNDS; i++) {
 		sha2_starts(&sha_ctx, 0);
 		sha2_update(&sha_ctx, digest, AES_KEY_SIZE);
@@ -21,18 +21,29 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #define AES_H
 
 #include "../shr/config.h"
-#include "ben.h"
 
-#define AES_IV_SIZE 16
+/*
+ * Encrypted packet: Version, random nonce, ciphertext, tag.
+ *
+ * AES-256-GCM. The key gets derived from -k once. The version byte is
+ * authenticated as well. PolarSSL uses AES-NI and PCLMULQDQ if the CPU has
+ * them.
+ */
+#define AES_VERSION 0x01
+#define AES_NONCE_SIZE 12
+#define AES_TAG_SIZE 16
+#define AES_HEAD_SIZE (1 + AES_NONCE_SIZE)
+#define AES_PACKET_SIZE 1460
+#define AES_MSG_SIZE (AES_PACKET_SIZE - AES_HEAD_SIZE - AES_TAG_SIZE)
 #define AES_KEY_SIZE 32
-#define AES_MSG_SIZE 1456
-#define AES_BLOCK_SIZE 16
-#define AES_KEY_ROUNDS 8
-
-struct obj_str *aes_encrypt(UCHAR * plain, int plainlen, UCHAR * iv, char *key,
-			    int keylen);
-struct obj_str *aes_decrypt(UCHAR * cipher, int cipherlen, UCHAR * iv,
-			    char *key, int keylen);
-void aes_key_setup(UCHAR * digest, UCHAR * iv, char *key, int keylen);
+#define AES_KEY_ROUNDS 4096
+
+void aes_init(char *key, int keylen);
+int aes_ready(void);
+
+int aes_encrypt(UCHAR * packet, UCHAR * plain, int plainlen);
+int aes_decrypt(UCHAR * plain, UCHAR * packet, int packetlen);
+
+void aes_key_setup(UCHAR * digest, char *key, int keylen);
 
 #endif				/* AES_H */
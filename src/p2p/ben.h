@@ -21,135 +21,27 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #define BEN_H
 
 #include "../shr/config.h"
-#include "../shr/list.h"
-#include "../shr/fail.h"
-
-#define BEN_STR  0
-#define BEN_INT  1
-#define BEN_LIST 2
-#define BEN_DICT 3
 
+/*
+ * KRPC messages get decoded by krpc.c and written from the templates in
+ * send_udp.c. Both work on the datagram directly. No tree is built.
+ */
 #define BEN_STR_MAXLEN 4
 #define BEN_STR_MAXSIZE 1023
 #define BEN_INT_MAXLEN 10
 #define BEN_INT_MAXSIZE 2147483647
 
-#ifdef NSS
-#define ben_init _nss_tk_ben_init
-#define ben_free _nss_tk_ben_free
-#define ben_free_r _nss_tk_ben_free_r
-#define ben_free_item _nss_tk_ben_free_item
-#define raw_init _nss_tk_raw_init
-#define raw_free _nss_tk_raw_free
-#define ben_dict _nss_tk_ben_dict
-#define ben_list _nss_tk_ben_list
-#define ben_str _nss_tk_ben_str
-#define ben_int _nss_tk_ben_int
-#define tuple_init _nss_tk_tuple_init
-#define tuple_free _nss_tk_tuple_free
-#define ben_enc _nss_tk_ben_enc
-#define ben_enc_rec _nss_tk_ben_enc_rec
-#define ben_enc_size _nss_tk_ben_enc_size
-#define ben_validate _nss_tk_ben_validate
-#define ben_validate_r _nss_tk_ben_validate_r
-#define ben_validate_d _nss_tk_ben_validate_d
-#define ben_validate_l _nss_tk_ben_validate_l
-#define ben_validate_i _nss_tk_ben_validate_i
-#define ben_validate_s _nss_tk_ben_validate_s
-#define ben_dec _nss_tk_ben_dec
-#define ben_dec_r _nss_tk_ben_dec_r
-#define ben_dec_d _nss_tk_ben_dec_d
-#define ben_dec_l _nss_tk_ben_dec_l
-#define ben_dec_i _nss_tk_ben_dec_i
-#define ben_dec_s _nss_tk_ben_dec_s
-#define ben_is_dict _nss_tk_ben_is_dict
-#define ben_is_list _nss_tk_ben_is_list
-#define ben_is_str _nss_tk_ben_is_str
-#define ben_is_int _nss_tk_ben_is_int
-#define ben_dict_search_key _nss_tk_ben_dict_search_key
-#define ben_dict_search_str _nss_tk_ben_dict_search_str
-#define ben_compare _nss_tk_ben_compare
-#define ben_str_s _nss_tk_ben_str_s
-#define ben_str_i _nss_tk_ben_str_i
-#define str_init _nss_tk_str_init
-#define str_free _nss_tk_str_free
-#endif
-
+/* A slice of memory owned by someone else, usually the datagram. It is
+ * neither copied nor terminated. */
 typedef struct {
 	UCHAR *s;
 	LONG i;
 } STR;
 
-typedef struct {
-	int t;
-
-	union {
-		LONG i;
-		STR *s;
-		LIST *d;
-		LIST *l;
-	} v;
-} BEN;
-
-typedef struct {
-	BEN *key;
-	BEN *val;
-} TUPLE;
-
 typedef struct {
 	UCHAR *code;
 	LONG size;
 	UCHAR *p;
 } RAW;
 
-BEN *ben_init(int type);
-void ben_free(BEN * node);
-void ben_free_r(BEN * node);
-ITEM *ben_free_item(BEN * node, ITEM * item);
-
-RAW *raw_init(void);
-void raw_free(RAW * raw);
-
-void ben_dict(BEN * node, BEN * key, BEN * val);
-void ben_list(BEN * node, BEN * val);
-void ben_str(BEN * node, UCHAR * str, LONG len);
-void ben_int(BEN * node, LONG i);
-
-TUPLE *tuple_init(BEN * key, BEN * val);
-void tuple_free(TUPLE * tuple);
-
-RAW *ben_enc(BEN * node);
-UCHAR *ben_enc_rec(BEN * node, UCHAR * p);
-LONG ben_enc_size(BEN * node);
-
-int ben_validate(UCHAR * bencode, LONG bensize);
-int ben_validate_r(RAW * raw);
-int ben_validate_d(RAW * raw);
-int ben_validate_l(RAW * raw);
-int ben_validate_i(RAW * raw);
-int ben_validate_s(RAW * raw);
-
-BEN *ben_dec(UCHAR * bencode, LONG bensize);
-BEN *ben_dec_r(RAW * raw);
-BEN *ben_dec_d(RAW * raw);
-BEN *ben_dec_l(RAW * raw);
-BEN *ben_dec_i(RAW * raw);
-BEN *ben_dec_s(RAW * raw);
-
-int ben_is_dict(BEN * node);
-int ben_is_list(BEN * node);
-int ben_is_str(BEN * node);
-int ben_is_int(BEN * node);
-
-BEN *ben_dict_search_key(BEN * node, BEN * key);
-BEN *ben_dict_search_str(BEN * node, const char *buffer);
-
-int ben_compare(BEN * key1, BEN * key2);
-
-UCHAR *ben_str_s(BEN * node);
-LONG ben_str_i(BEN * node);
-
-STR *str_init(UCHAR * buf, LONG size);
-void str_free(STR * str);
-
 #endif
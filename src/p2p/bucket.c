@@ -18,244 +18,350 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <string.h>
+#include <stdint.h>
+#include <endian.h>
 #include <arpa/inet.h>
 #include <signal.h>
 
 #include "bucket.h"
 
-LIST *bckt_init(void)
+BCKT *bckt_init(const UCHAR * me)
 {
-	BUCK *b = (BUCK *) myalloc(sizeof(BUCK));
-	LIST *l = list_init();
+	BCKT *t = (BCKT *) myalloc(sizeof(BCKT));
+
+	memcpy(t->me, me, SHA1_SIZE);
 
 	/* First bucket */
-	memset(b->id, '\0', SHA1_SIZE);
-	b->nodes = list_init();
+	t->size = 1;
+	t->bucket[0] = (BUCK *) myalloc(sizeof(BUCK));
 
-	/* Connect bucket */
-	list_put(l, b);
+	t->hash = hash_init_fixed(4096, SHA1_SIZE);
+	t->wheel = wheel_init(time_now_sec());
 
-	return l;
+	return t;
 }
 
-void bckt_free(LIST * thislist)
+void bckt_free(BCKT * t)
 {
-	ITEM *i = NULL;
-	BUCK *b = NULL;
-
-	i = list_start(thislist);
-	while (i != NULL) {
-		b = list_value(i);
+	int i = 0;
 
-		list_clear(b->nodes);
-		list_free(b->nodes);
-
-		i = list_next(i);
+	for (i = 0; i < t->size; i++) {
+		myfree(t->bucket[i]);
 	}
-	list_clear(thislist);
-	list_free(thislist);
+	hash_free(t->hash);
+	wheel_free(t->wheel);
+	myfree(t);
 }
 
-int bckt_put(LIST * l, UDP_NODE * n)
+int bckt_put(BCKT * t, UCHAR * id, IP * sa)
 {
-	ITEM *i = NULL;
 	BUCK *b = NULL;
-
-	if (n == NULL) {
-		return FALSE;
-	}
+	BUCK *b_found = NULL;
 
 	/* Find best bucket */
-	if ((i = bckt_find_best_match(l, n->id)) == NULL) {
-		fail("Something is terribly broken: No appropriate bucket found for ID");
-		return FALSE;
-	}
-	b = list_value(i);
+	b = bckt_find_best_match(t, id);
 
 	/* Search the bucket */
-	if (bckt_find_node(l, n->id) != NULL) {
+	if (bckt_find_node(t, id, &b_found) >= 0) {
 		return FALSE;
 	}
 
 	/* Do not store more than 20 nodes per bucket. The first 8 nodes are the
-	 * most relevant. */
-	if (list_size(b->nodes) >= BCKT_SIZE_MAX) {
+	 * most relevant. Remember the node for later. */
+	if (b->nodes.size >= BCKT_SIZE_MAX) {
+		bckt_repl_put(&b->repl, id, sa);
 		return FALSE;
 	}
 
-	/* Add node to the bucket */
-	if (list_put(b->nodes, n) == NULL) {
-		return FALSE;
-	}
+	bckt_add(t, b, id, sa);
 
 	/* Success */
 	return TRUE;
 }
 
-void bckt_del(LIST * l, UDP_NODE * n)
+void bckt_add(BCKT * t, BUCK * b, UCHAR * id, IP * sa)
 {
-	ITEM *item_b = NULL;
-	ITEM *item_n = NULL;
-	BUCK *b = NULL;
+	int i = 0;
 
-	if (n == NULL) {
-		return;
-	}
+	/* Add node to the bucket */
+	i = b->nodes.size++;
+	node_init(&b->nodes, i, id, sa);
+	bckt_hash_put(t, b, i);
 
-	if ((item_b = bckt_find_best_match(l, n->id)) == NULL) {
-		fail("Something is terribly broken: No appropriate bucket found for ID");
-		return;
+	/* Ping it soon */
+	if (!wheel_pending(&b->timer) || b->nodes.time_ping[i] < b->timer.due) {
+		wheel_add(t->wheel, &b->timer, b->nodes.time_ping[i], 0);
 	}
-	b = list_value(item_b);
+}
 
-	if ((item_n = bckt_find_node(l, n->id)) == NULL) {
-		/* Node node found */
-		return;
+void bckt_del(BCKT * t, BUCK * b, int i)
+{
+	int j = 0;
+
+	/* Close the gap. The order of the nodes matters. */
+	bckt_hash_del(t, b, i);
+	for (j = i + 1; j < b->nodes.size; j++) {
+		node_copy(&b->nodes, j - 1, &b->nodes, j);
 	}
+	b->nodes.size--;
+	bckt_hash_put(t, b, i);
 
-	/* Delete reference to node */
-	list_del(b->nodes, item_n);
+	/* Refill the bucket right away */
+	bckt_repl_pop(t, b);
 }
 
-ITEM *bckt_find_best_match(LIST * thislist, const UCHAR * id)
+void bckt_repl_put(BCKT_REPL * r, UCHAR * id, IP * sa)
 {
-	ITEM *item = NULL;
-	BUCK *b = NULL;
+	int i = 0;
 
-	item = list_start(thislist);
-	while (item->next != NULL) {
-		b = list_value(list_next(item));
-
-		/* Does this bucket fits better than the next one? */
-		if (memcmp(id, b->id, SHA1_SIZE) < 0) {
-			return item;
+	/* Seen again: Move it to the end */
+	for (i = 0; i < r->size; i++) {
+		if (node_equal(r->id[i], id)) {
+			bckt_repl_del(r, i);
+			break;
 		}
+	}
 
-		item = list_next(item);
+	/* Forget the oldest candidate */
+	if (r->size >= BCKT_REPL_MAX) {
+		bckt_repl_del(r, 0);
 	}
 
-	/* No best bucket found, so return the last one */
-	return list_stop(thislist);
+	memcpy(r->id[r->size], id, SHA1_SIZE);
+	memcpy(&r->c_addr[r->size], sa, sizeof(IP));
+	r->size++;
 }
 
-ITEM *bckt_find_any_match(LIST * thislist, const UCHAR * id)
+void bckt_repl_del(BCKT_REPL * r, int i)
 {
-	ITEM *i = NULL;
-	BUCK *b = NULL;
+	int j = 0;
+
+	for (j = i + 1; j < r->size; j++) {
+		memcpy(r->id[j - 1], r->id[j], SHA1_SIZE);
+		memcpy(&r->c_addr[j - 1], &r->c_addr[j], sizeof(IP));
+	}
+	r->size--;
+}
 
-	i = bckt_find_best_match(thislist, id);
-	b = list_value(i);
+void bckt_repl_pop(BCKT * t, BUCK * b)
+{
+	BCKT_REPL *r = &b->repl;
 
-	/* Success, */
-	if (b->nodes->item != NULL) {
-		return i;
+	/* The most recently seen candidates first */
+	while (r->size > 0 && b->nodes.size < BCKT_SIZE_MAX) {
+		r->size--;
+		bckt_add(t, b, r->id[r->size], &r->c_addr[r->size]);
 	}
+}
 
-	/* This bucket is empty: Find another one. */
-	while (i != NULL) {
+void bckt_hash_put(BCKT * t, BUCK * b, int from)
+{
+	int i = 0;
 
-		b = list_value(i);
-		if (b->nodes->item != NULL) {
-			return i;
-		}
-		i = list_prev(i);
+	for (i = from; i < b->nodes.size; i++) {
+		hash_put(t->hash, b->nodes.id[i], SHA1_SIZE, b->nodes.id[i]);
 	}
+}
 
-	return NULL;
+void bckt_hash_del(BCKT * t, BUCK * b, int from)
+{
+	int i = 0;
+
+	for (i = from; i < b->nodes.size; i++) {
+		hash_del(t->hash, b->nodes.id[i], SHA1_SIZE);
+	}
 }
 
-ITEM *bckt_find_node(LIST * thislist, const UCHAR * id)
+/* Wake the bucket up at the earliest ping time. Ping times that moved into
+ * the future since then only cause an early wakeup. */
+void bckt_schedule(BCKT * t, BUCK * b)
 {
-	ITEM *item_b = NULL;
-	ITEM *item_n = NULL;
-	BUCK *b = NULL;
-	LIST *list_n = NULL;
-	UDP_NODE *n = NULL;
+	time_t due = 0;
+	int i = 0;
 
-	if ((item_b = bckt_find_best_match(thislist, id)) == NULL) {
-		return NULL;
+	if (b->nodes.size == 0) {
+		wheel_del(&b->timer);
+		return;
 	}
-	b = list_value(item_b);
 
-	list_n = b->nodes;
-	item_n = list_start(list_n);
-	while (item_n != NULL) {
-		n = list_value(item_n);
-		if (node_equal(n->id, id)) {
-			return item_n;
+	due = b->nodes.time_ping[0];
+	for (i = 1; i < b->nodes.size; i++) {
+		if (b->nodes.time_ping[i] < due) {
+			due = b->nodes.time_ping[i];
 		}
-		item_n = list_next(item_n);
 	}
 
-	return NULL;
+	wheel_add(t->wheel, &b->timer, due, 0);
 }
 
-int bckt_split(LIST * thislist, const UCHAR * target)
+int bckt_index(BCKT * t, const UCHAR * id)
 {
-	ITEM *item_b = NULL;
-	BUCK *b = NULL;
-	LIST *list_n = NULL;
-	ITEM *item_n = NULL;
-	UDP_NODE *n = NULL;
-	BUCK *b_new = NULL;
-	UCHAR id_new[SHA1_SIZE];
+	int prefix = bckt_prefix(t->me, id);
 
-	/* Search bucket we want to evolve */
-	if ((item_b = bckt_find_best_match(thislist, target)) == NULL) {
-		return FALSE;
+	/* Longer prefixes end up in the last bucket */
+	return (prefix < t->size - 1) ? prefix : t->size - 1;
+}
+
+/*
+ * The bucket before bucket i in address order. Bucket i lies below our own
+ * ID if our bit i is set, and above it otherwise. From low to high: the
+ * lower buckets by rising i, the last bucket, the upper buckets by falling i.
+ */
+int bckt_prev(BCKT * t, int i)
+{
+	int last = t->size - 1;
+	int j = 0;
+
+	if (i == last || bckt_bit(t->me, i)) {
+		for (j = i - 1; j >= 0; j--) {
+			if (bckt_bit(t->me, j)) {
+				return j;
+			}
+		}
+		return -1;
 	}
-	b = list_value(item_b);
 
-	/* Split whenever there are more than 8 nodes within a bucket */
-	if (list_size(b->nodes) <= 8) {
-		return FALSE;
+	for (j = i + 1; j < last; j++) {
+		if (!bckt_bit(t->me, j)) {
+			return j;
+		}
 	}
 
-	/* Compute id of the new bucket */
-	if (bckt_compute_id(thislist, item_b, id_new) < 0) {
-		return FALSE;
+	return last;
+}
+
+/* Number of leading bits a and b have in common */
+int bckt_prefix(const UCHAR * a, const UCHAR * b)
+{
+	uint64_t x = 0, y = 0;
+	uint32_t u = 0, v = 0;
+	int i = 0;
+
+	for (i = 0; i < 16; i += 8) {
+		memcpy(&x, a + i, 8);
+		memcpy(&y, b + i, 8);
+		if ((x ^= y) != 0) {
+			return 8 * i + __builtin_clzll(be64toh(x));
+		}
 	}
 
-	/* Create new bucket */
-	b_new = (BUCK *) myalloc(sizeof(BUCK));
-	memcpy(b_new->id, id_new, SHA1_SIZE);
-	b_new->nodes = list_init();
+	memcpy(&u, a + 16, 4);
+	memcpy(&v, b + 16, 4);
+	if ((u ^= v) != 0) {
+		return 128 + __builtin_clz(be32toh(u));
+	}
 
-	/* Add new bucket */
-	list_add(thislist, item_b, b_new);
+	return 8 * SHA1_SIZE;
+}
 
-	/* Remember nodes */
-	list_n = b->nodes;
+int bckt_bit(const UCHAR * id, int bit)
+{
+	return (id[bit / 8] & (0x80 >> (bit % 8))) != 0;
+}
 
-	/* Create new node list */
-	b->nodes = list_init();
+BUCK *bckt_find_best_match(BCKT * t, const UCHAR * id)
+{
+	return t->bucket[bckt_index(t, id)];
+}
 
-	/* Walk through the existing nodes and find an adequate bucket */
-	item_n = list_start(list_n);
-	while (item_n != NULL) {
-		n = list_value(item_n);
-		item_b = bckt_find_best_match(thislist, n->id);
+BUCK *bckt_find_any_match(BCKT * t, const UCHAR * id)
+{
+	int i = bckt_index(t, id);
 
-		b = list_value(item_b);
-		list_put(b->nodes, n);
+	/* This bucket may be empty: Find another one. */
+	while (i >= 0) {
+		if (t->bucket[i]->nodes.size > 0) {
+			return t->bucket[i];
+		}
+		i = bckt_prev(t, i);
+	}
+
+	return NULL;
+}
 
-		item_n = list_next(item_n);
+/* Slot of the node or -1 */
+int bckt_find_node(BCKT * t, const UCHAR * id, BUCK ** b)
+{
+	UCHAR *row = NULL;
+
+	if ((row = hash_get(t->hash, (UCHAR *) id, SHA1_SIZE)) == NULL) {
+		return -1;
 	}
+	*b = bckt_find_best_match(t, id);
 
-	/* Delete the old list but not its payload */
-	list_free(list_n);
+	return (row - (*b)->nodes.id[0]) / SHA1_SIZE;
+}
+
+int bckt_split(BCKT * t)
+{
+	BUCK *b = t->bucket[t->size - 1];
+	BUCK *b_new = NULL;
+	int last = t->size - 1;
+	int i = 0;
+	int j = 0;
+
+	/* Split whenever there are more than 8 nodes within our own bucket */
+	if (b->nodes.size <= 8) {
+		return FALSE;
+	}
+
+	/* Out of bits */
+	if (t->size >= BCKT_MAX) {
+		return FALSE;
+	}
+
+	/* Add new bucket */
+	b_new = (BUCK *) myalloc(sizeof(BUCK));
+	t->bucket[t->size] = b_new;
+	t->size++;
+
+	/* Move the nodes sharing a longer prefix with us */
+	bckt_hash_del(t, b, 0);
+	for (i = 0; i < b->nodes.size; i++) {
+		if (bckt_index(t, b->nodes.id[i]) == last) {
+			node_copy(&b->nodes, j, &b->nodes, i);
+			j++;
+		} else {
+			node_copy(&b_new->nodes, b_new->nodes.size, &b->nodes, i);
+			b_new->nodes.size++;
+		}
+	}
+	b->nodes.size = j;
+	bckt_hash_put(t, b, 0);
+	bckt_hash_put(t, b_new, 0);
+
+	/* Same for the candidates. The oldest ones first. */
+	j = 0;
+	for (i = 0; i < b->repl.size; i++) {
+		if (bckt_index(t, b->repl.id[i]) == last) {
+			memcpy(b->repl.id[j], b->repl.id[i], SHA1_SIZE);
+			memcpy(&b->repl.c_addr[j], &b->repl.c_addr[i],
+			       sizeof(IP));
+			j++;
+		} else {
+			bckt_repl_put(&b_new->repl, b->repl.id[i],
+				      &b->repl.c_addr[i]);
+		}
+	}
+	b->repl.size = j;
+
+	/* Both buckets may have room now */
+	bckt_repl_pop(t, b);
+	bckt_repl_pop(t, b_new);
+	bckt_schedule(t, b);
+	bckt_schedule(t, b_new);
 
 	/* Bucket successfully split */
 	return TRUE;
 }
 
-void bckt_split_loop(LIST * l, UCHAR * target, int verbose)
+void bckt_split_loop(BCKT * t, int verbose)
 {
 	int change = FALSE;
 
 	/* Do as many splits as neccessary */
 	for (;;) {
-		if (bckt_split(l, target)) {
+		if (bckt_split(t)) {
 			change = TRUE;
 		} else {
 			break;
@@ -263,17 +369,17 @@ void bckt_split_loop(LIST * l, UCHAR * target, int verbose)
 	}
 
 	if (change == TRUE && verbose == TRUE) {
-		bckt_split_print(l);
+		bckt_split_print(t);
 	}
 }
 
-void bckt_split_print(LIST * l)
+void bckt_split_print(BCKT * t)
 {
-	ITEM *item_b = NULL;
 	BUCK *b = NULL;
-	ITEM *item_n = NULL;
-	UDP_NODE *n = NULL;
+	UCHAR id[SHA1_SIZE];
 	char hex[HEX_LEN];
+	int i = 0;
+	int j = 0;
 #ifdef IPV6
 	char ip_buf[INET6_ADDRSTRLEN + 1];
 	memset(ip_buf, '\0', INET6_ADDRSTRLEN + 1);
@@ -285,147 +391,214 @@ void bckt_split_print(LIST * l)
 	info(_log, NULL, "Bucket split:");
 
 	/* Cycle through all the buckets */
-	item_b = list_start(l);
-	while (item_b != NULL) {
-		b = list_value(item_b);
+	for (i = 0; i < t->size; i++) {
+		b = t->bucket[i];
 
-		hex_hash_encode(hex, b->id);
+		bckt_compute_id(t, i, id);
+		hex_hash_encode(hex, id);
 		info(_log, NULL, " Bucket: %s", hex);
 
 		/* Cycle through all the nodes */
-		item_n = list_start(b->nodes);
-		while (item_n != NULL) {
-			n = list_value(item_n);
-
-			hex_hash_encode(hex, n->id);
+		for (j = 0; j < b->nodes.size; j++) {
+			hex_hash_encode(hex, b->nodes.id[j]);
 			info(_log, NULL, "  Node: %s %s", hex,
 #ifdef IPV6
-			     inet_ntop(AF_INET6, &n->c_addr.sin6_addr, ip_buf,
-				       INET6_ADDRSTRLEN)
+			     inet_ntop(AF_INET6, &b->nodes.c_addr[j].sin6_addr,
+				       ip_buf, INET6_ADDRSTRLEN)
 #elif IPV4
-			     inet_ntop(AF_INET, &n->c_addr.sin_addr, ip_buf,
-				       INET_ADDRSTRLEN)
+			     inet_ntop(AF_INET, &b->nodes.c_addr[j].sin_addr,
+				       ip_buf, INET_ADDRSTRLEN)
 #endif
 			    );
-
-			item_n = list_next(item_n);
 		}
-
-		item_b = list_next(item_b);
 	}
 }
 
-int bckt_is_empty(LIST * l)
+int bckt_is_empty(BCKT * t)
 {
-	ITEM *i = NULL;
-	BUCK *b = NULL;
+	int i = 0;
 
 	/* Cycle through all the buckets */
-	i = list_start(l);
-	while (i != NULL) {
-		b = list_value(i);
-
-		if (b->nodes->item != NULL) {
+	for (i = 0; i < t->size; i++) {
+		if (t->bucket[i]->nodes.size > 0) {
 			return FALSE;
 		}
-
-		i = list_next(i);
 	}
 
 	return TRUE;
 }
 
-int bckt_compute_id(LIST * thislist, ITEM * item_b, UCHAR * id)
+/* Lowest ID that falls into bucket i */
+void bckt_compute_id(BCKT * t, int i, UCHAR * id)
 {
-	BUCK *b = list_value(item_b);
-	ITEM *item_next = NULL;
-	BUCK *b_next = NULL;
-	int bit1 = 0;
-	int bit2 = 0;
-	int bit = 0;
+	int last = t->size - 1;
+	int bit = (i < last) ? i : last;
+
+	/* Keep our prefix and clear the rest */
+	memcpy(id, t->me, SHA1_SIZE);
+	id[bit / 8] &= (UCHAR) (0xFF00 >> (bit % 8));
+	memset(id + bit / 8 + 1, '\0', SHA1_SIZE - bit / 8 - 1);
 
-	/* Is there a container next to this one? */
-	if (item_b->next != NULL) {
-		item_next = list_next(item_b);
-		b_next = list_value(item_next);
+	/* The first differing bit */
+	if (i < last && !bckt_bit(t->me, i)) {
+		id[bit / 8] |= (0x80 >> (bit % 8));
 	}
+}
 
-	bit1 = bckt_significant_bit(b->id);
-	bit2 = (b_next != NULL) ? bckt_significant_bit(b_next->id) : -1;
-	bit = (bit1 >= bit2) ? bit1 : bit2;
-	bit++;
+void bckt_words(BCKT_WORDS * w, const UCHAR * id)
+{
+	memcpy(&w->hi, id, 8);
+	memcpy(&w->mid, id + 8, 8);
+	memcpy(&w->lo, id + 16, 4);
+}
 
-	if (bit >= 160) {
-		return -1;
+/* target holds the raw words of the target ID */
+void bckt_distance(BCKT_WORDS * d, const UCHAR * id, const BCKT_WORDS * target)
+{
+	bckt_words(d, id);
+	d->hi = be64toh(d->hi ^ target->hi);
+	d->mid = be64toh(d->mid ^ target->mid);
+	d->lo = be32toh(d->lo ^ target->lo);
+}
+
+int bckt_distance_cmp(const BCKT_WORDS * a, const BCKT_WORDS * b)
+{
+	if (a->hi != b->hi) {
+		return (a->hi < b->hi) ? -1 : 1;
+	}
+	if (a->mid != b->mid) {
+		return (a->mid < b->mid) ? -1 : 1;
 	}
+	if (a->lo != b->lo) {
+		return (a->lo < b->lo) ? -1 : 1;
+	}
+	return 0;
+}
 
-	memcpy(id, b->id, SHA1_SIZE);
-	id[bit / 8] |= (0x80 >> (bit % 8));
+/* Number of leading zero bits */
+int bckt_distance_prefix(const BCKT_WORDS * d)
+{
+	if (d->hi != 0) {
+		return __builtin_clzll(d->hi);
+	}
+	if (d->mid != 0) {
+		return 64 + __builtin_clzll(d->mid);
+	}
+	if (d->lo != 0) {
+		return 128 + __builtin_clz(d->lo);
+	}
+	return 160;
+}
 
-	return 1;
+/*
+ * Nodes sharing as many leading bits with the target are equally close in
+ * Kademlia terms. Among them the fast and reliable ones come first. The
+ * exact distance breaks ties.
+ */
+int bckt_cand_cmp(const BCKT_CAND * a, const BCKT_CAND * b)
+{
+	if (a->prefix != b->prefix) {
+		return (a->prefix > b->prefix) ? -1 : 1;
+	}
+	if (a->cost != b->cost) {
+		return (a->cost < b->cost) ? -1 : 1;
+	}
+	return bckt_distance_cmp(&a->d, &b->d);
 }
 
-int bckt_significant_bit(const UCHAR * id)
+/*
+ * The BCKT_K good nodes closest to the target in the order of
+ * bckt_cand_cmp(). The buckets are visited in groups. Every node of a group
+ * shares more leading bits with the target than any node of the following
+ * groups, so the search stops after the first group that fills the result.
+ */
+int bckt_closest(BCKT * t, const UCHAR * target, BCKT_CAND * c)
 {
-	int i = 0, j = 0;
+	BCKT_WORDS w;
+	int last = t->size - 1;
+	int p = bckt_index(t, target);
+	int size = 0;
+	int i = 0;
 
-	for (i = 19; i >= 0; i--) {
-		if (id[i] != 0) {
-			break;
+	bckt_words(&w, target);
+
+	/* The target's own bucket shares the longest prefix with it */
+	size = bckt_closest_scan(t->bucket[p], &w, c, size);
+
+	/* The deeper buckets all differ from the target at bit p */
+	if (size < BCKT_K) {
+		for (i = p + 1; i <= last; i++) {
+			size = bckt_closest_scan(t->bucket[i], &w, c, size);
 		}
 	}
 
-	if (i < 0) {
-		return -1;
+	/* The shallower buckets: The later they differ, the closer they are */
+	for (i = p - 1; i >= 0 && size < BCKT_K; i--) {
+		size = bckt_closest_scan(t->bucket[i], &w, c, size);
 	}
 
-	for (j = 7; j >= 0; j--) {
-		if ((id[i] & (0x80 >> j)) != 0) {
-			break;
+	return size;
+}
+
+int bckt_closest_scan(BUCK * b, const BCKT_WORDS * target, BCKT_CAND * c,
+		      int size)
+{
+	BCKT_CAND x;
+	int i = 0;
+	int j = 0;
+
+	for (i = 0; i < b->nodes.size; i++) {
+
+		/* Do not include nodes, that are questionable */
+		if (!node_ok(&b->nodes, i)) {
+			continue;
 		}
+
+		bckt_distance(&x.d, b->nodes.id[i], target);
+		x.prefix = bckt_distance_prefix(&x.d);
+		x.cost = node_cost(&b->nodes, i);
+		x.b = b;
+		x.i = i;
+
+		/* Not better than the worst one */
+		if (size == BCKT_K && bckt_cand_cmp(&x, &c[size - 1]) >= 0) {
+			continue;
+		}
+
+		/* Insertion sort */
+		j = (size < BCKT_K) ? size++ : BCKT_K - 1;
+		while (j > 0 && bckt_cand_cmp(&x, &c[j - 1]) < 0) {
+			c[j] = c[j - 1];
+			j--;
+		}
+		c[j] = x;
 	}
 
-	return 8 * i + j;
+	return size;
 }
 
-int bckt_compact_list(LIST * l, UCHAR * nodes_compact_list, UCHAR * target)
+int bckt_compact_list(BCKT * t, UCHAR * nodes_compact_list, UCHAR * target)
 {
 	UCHAR *p = nodes_compact_list;
-	ITEM *item = NULL;
+	BCKT_CAND c[BCKT_K];
 	BUCK *b = NULL;
-	UDP_NODE *n = NULL;
-	int j = 0;
+	int found = 0;
+	int i = 0;
 	int size = 0;
 
-	/* Find matching bucket */
-	if ((item = bckt_find_any_match(l, target)) == NULL) {
-		return 0;
-	} else {
-		b = list_value(item);
-	}
+	found = bckt_closest(t, target, c);
 
-	/* Walkthrough bucket */
-	item = list_start(b->nodes);
-	while (item != NULL && j < 8) {
-		n = list_value(item);
-
-		/* Do not include nodes, that are questionable */
-		if (!node_ok(n)) {
-			item = list_next(item);
-			continue;
-		}
+	for (i = 0; i < found; i++) {
+		b = c[i].b;
 
 		/* Copy Node ID */
-		memcpy(p, n->id, SHA1_SIZE);
+		memcpy(p, b->nodes.id[c[i].i], SHA1_SIZE);
 		p += SHA1_SIZE;
 
 		/* Copy IP + Port */
-		p = ip_sin_to_tuple(&n->c_addr, p);
+		p = ip_sin_to_tuple(&b->nodes.c_addr[c[i].i], p);
 
 		size += IP_SIZE_META_TRIPLE;
-
-		item = list_next(item);
-		j++;
 	}
 
 	return size;
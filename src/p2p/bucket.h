@@ -20,38 +20,126 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef BUCKET_H
 #define BUCKET_H
 
+#include <stdint.h>
+
 #include "../shr/ip.h"
+#include "../shr/hash.h"
+#include "../shr/wheel.h"
 #include "ben.h"
 #include "hex.h"
 #include "node_udp.h"
 #include "torrentkino.h"
 
-#define BCKT_SIZE_MAX 20
+#define BCKT_SIZE_MAX NODE_SLOTS
+
+/* One bucket per bit of the ID */
+#define BCKT_MAX (8 * SHA1_SIZE)
+
+/* Nodes per find_node or get_peers reply */
+#define BCKT_K 8
 
+/* Candidates per bucket */
+#define BCKT_REPL_MAX 8
+
+/*
+ * Recently seen nodes that did not fit into their full bucket. The most
+ * recently seen one is the last. They are not hashed. When the bucket
+ * loses a node, the newest candidate takes its place.
+ */
+struct obj_neighboorhood_replacement {
+	UCHAR id[BCKT_REPL_MAX][SHA1_SIZE];
+	IP c_addr[BCKT_REPL_MAX];
+	int size;
+};
+typedef struct obj_neighboorhood_replacement BCKT_REPL;
+
+/* The timer fires at the earliest ping time of the nodes */
 struct obj_neighboorhood_bucket {
-	UCHAR id[SHA1_SIZE];
-	LIST *nodes;
+	UDP_NODES nodes;
+	BCKT_REPL repl;
+	TIMER timer;
 };
 typedef struct obj_neighboorhood_bucket BUCK;
 
-LIST *bckt_init(void);
-void bckt_free(LIST * thislist);
-int bckt_put(LIST * l, UDP_NODE * n);
-void bckt_del(LIST * l, UDP_NODE * n);
+/*
+ * Bucket i holds the nodes whose ID first differs from ours at bit i. The
+ * last bucket also holds every node sharing a longer prefix. It is the only
+ * one that ever gets split. Buckets are allocated by the split.
+ *
+ * The hash maps an ID to its row in the packed IDs of a bucket. The row is
+ * the key as well. Whenever a node changes its slot, it gets rehashed.
+ */
+struct obj_neighboorhood_table {
+	UCHAR me[SHA1_SIZE];
+	int size;
+	BUCK *bucket[BCKT_MAX];
+	HASH *hash;
+	WHEEL *wheel;
+};
+typedef struct obj_neighboorhood_table BCKT;
+
+/*
+ * A 160 bit ID or XOR distance as three machine words. Distances are stored
+ * in host order and compare like the 160 bit number.
+ */
+struct obj_neighboorhood_words {
+	uint64_t hi;
+	uint64_t mid;
+	uint32_t lo;
+};
+typedef struct obj_neighboorhood_words BCKT_WORDS;
+
+struct obj_neighboorhood_candidate {
+	BCKT_WORDS d;
+	int prefix;
+	LONG cost;
+	BUCK *b;
+	int i;
+};
+typedef struct obj_neighboorhood_candidate BCKT_CAND;
+
+BCKT *bckt_init(const UCHAR * me);
+void bckt_free(BCKT * t);
+int bckt_put(BCKT * t, UCHAR * id, IP * sa);
+void bckt_add(BCKT * t, BUCK * b, UCHAR * id, IP * sa);
+void bckt_del(BCKT * t, BUCK * b, int i);
+
+void bckt_repl_put(BCKT_REPL * r, UCHAR * id, IP * sa);
+void bckt_repl_del(BCKT_REPL * r, int i);
+void bckt_repl_pop(BCKT * t, BUCK * b);
+
+void bckt_hash_put(BCKT * t, BUCK * b, int from);
+void bckt_hash_del(BCKT * t, BUCK * b, int from);
+
+void bckt_schedule(BCKT * t, BUCK * b);
+
+int bckt_index(BCKT * t, const UCHAR * id);
+int bckt_prev(BCKT * t, int i);
+int bckt_prefix(const UCHAR * a, const UCHAR * b);
+int bckt_bit(const UCHAR * id, int bit);
+
+BUCK *bckt_find_best_match(BCKT * t, const UCHAR * id);
+BUCK *bckt_find_any_match(BCKT * t, const UCHAR * id);
+int bckt_find_node(BCKT * t, const UCHAR * id, BUCK ** b);
+
+int bckt_split(BCKT * t);
+void bckt_split_loop(BCKT * t, int verbose);
+void bckt_split_print(BCKT * t);
 
-ITEM *bckt_find_best_match(LIST * thislist, const UCHAR * id);
-ITEM *bckt_find_any_match(LIST * thislist, const UCHAR * id);
-ITEM *bckt_find_node(LIST * thislist, const UCHAR * id);
+int bckt_is_empty(BCKT * t);
 
-int bckt_split(LIST * thislist, const UCHAR * target);
-void bckt_split_loop(LIST * l, UCHAR * target, int verbose);
-void bckt_split_print(LIST * l);
+void bckt_compute_id(BCKT * t, int i, UCHAR * id);
 
-int bckt_is_empty(LIST * l);
+void bckt_words(BCKT_WORDS * w, const UCHAR * id);
+void bckt_distance(BCKT_WORDS * d, const UCHAR * id, const BCKT_WORDS * target);
+int bckt_distance_cmp(const BCKT_WORDS * a, const BCKT_WORDS * b);
+int bckt_distance_prefix(const BCKT_WORDS * d);
+int bckt_cand_cmp(const BCKT_CAND * a, const BCKT_CAND * b);
 
-int bckt_compute_id(LIST * thislist, ITEM * item_b, UCHAR * id_return);
-int bckt_significant_bit(const UCHAR * id);
+int bckt_closest(BCKT * t, const UCHAR * target, BCKT_CAND * c);
+int bckt_closest_scan(BUCK * b, const BCKT_WORDS * target, BCKT_CAND * c,
+		      int size);
 
-int bckt_compact_list(LIST * l, UCHAR * nodes_compact_list, UCHAR * target);
+int bckt_compact_list(BCKT * t, UCHAR * nodes_compact_list, UCHAR * target);
 
 #endif
@@ -27,8 +27,11 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 CACHE *cache_init(void)
 {
 	CACHE *cache = (CACHE *) myalloc(sizeof(CACHE));
+	cache->mutex = mutex_init();
 	cache->list = list_init();
-	cache->hash = hash_init(CACHE_SIZE_MAX + 1);
+	cache->hash = hash_init_fixed(CACHE_SIZE_MAX + 1, SHA1_SIZE);
+	cache->expire = wheel_init(time_now_sec());
+	cache->renew = wheel_init(time_now_sec());
 	return cache;
 }
 
@@ -38,6 +41,9 @@ void cache_free(void)
 	list_clear(_main->cache->list);
 	list_free(_main->cache->list);
 	hash_free(_main->cache->hash);
+	wheel_free(_main->cache->expire);
+	wheel_free(_main->cache->renew);
+	mutex_destroy(_main->cache->mutex);
 	myfree(_main->cache);
 }
 
@@ -51,12 +57,15 @@ void cache_clean(void)
 void cache_put(UCHAR * target_id, UCHAR * nodes_compact_list,
 	       int nodes_compact_size)
 {
-	TARGET_C *target = cache_prepare(target_id);
+	TARGET_C *target = NULL;
 	UCHAR *pair = NULL;
 	int j = 0;
 
+	mutex_block(_main->cache->mutex);
+
 	/* Overflow */
-	if (target == NULL) {
+	if ((target = cache_prepare(target_id)) == NULL) {
+		mutex_unblock(_main->cache->mutex);
 		return;
 	}
 
@@ -81,6 +90,35 @@ void cache_put(UCHAR * target_id, UCHAR * nodes_compact_list,
 	if (list_size(_main->cache->list) > CACHE_SIZE_MAX) {
 		cache_del(list_stop(_main->cache->list));
 	}
+
+	mutex_unblock(_main->cache->mutex);
+}
+
+void cache_restore(UCHAR * target_id, UCHAR * pair, time_t eol)
+{
+	TARGET_C *target = NULL;
+	NODE_C *node = NULL;
+
+	mutex_block(_main->cache->mutex);
+
+	if ((target = cache_prepare(target_id)) == NULL) {
+		mutex_unblock(_main->cache->mutex);
+		return;
+	}
+
+	tgt_c_update(target, pair);
+
+	/* Keep the lifetime the node had left */
+	node = list_value(tgt_c_find(target, pair));
+	node->eol = eol;
+	wheel_add(_main->cache->expire, &node->timer, node->eol,
+		  CACHE_TIMER_NODE);
+
+	if (list_size(_main->cache->list) > CACHE_SIZE_MAX) {
+		cache_del(list_stop(_main->cache->list));
+	}
+
+	mutex_unblock(_main->cache->mutex);
 }
 
 void cache_del(ITEM * i)
@@ -111,6 +149,12 @@ TARGET_C *cache_prepare(UCHAR * target_id)
 		tgt_c_free(target);
 		return NULL;
 	}
+	target->item = i;
+
+	/* Both are due right away until the first node arrives */
+	wheel_add(_main->cache->expire, &target->t_lifetime, target->lifetime,
+		  CACHE_TIMER_TARGET);
+	wheel_add(_main->cache->renew, &target->t_refresh, target->refresh, 0);
 
 	hash_put(_main->cache->hash, target->target, SHA1_SIZE, target);
 
@@ -119,51 +163,67 @@ TARGET_C *cache_prepare(UCHAR * target_id)
 
 void cache_expire(time_t now)
 {
-	ITEM *i = NULL, *n = NULL;
+	ILIST due;
+	TIMER *timer = NULL;
 	TARGET_C *target = NULL;
-	int index = 0;
-
-	i = list_start(_main->cache->list);
-	while (i != NULL) {
-		n = list_next(i);
-		target = list_value(i);
-
-		/* Look at the nodes within the target */
-		tgt_c_expire(target, now);
+	NODE_C *node = NULL;
 
-		/* 30 minutes without activity. Kill it. */
-		if (now > target->lifetime) {
-			cache_del(i);
+	mutex_block(_main->cache->mutex);
+
+	ilist_init(&due);
+	wheel_expire(_main->cache->expire, now, &due);
+	while ((timer = wheel_next(&due)) != NULL) {
+		switch (timer->type) {
+		case CACHE_TIMER_TARGET:
+			/* 30 minutes without activity. Kill it. */
+			target = wheel_value(timer, TARGET_C, t_lifetime);
+			cache_del(target->item);
+			break;
+		case CACHE_TIMER_NODE:
+			/* Delete info_hash after 30 minutes without announcement. */
+			node = wheel_value(timer, NODE_C, timer);
+			target = node->target;
+			tgt_c_del(target, tgt_c_find(target, node->pair));
+			break;
 		}
-
-		i = n;
-		index++;
 	}
+
+	mutex_unblock(_main->cache->mutex);
 }
 
 void cache_renew(time_t now)
 {
-	ITEM *i = NULL;
+	UCHAR targets[CACHE_SIZE_MAX][SHA1_SIZE];
+	ILIST due;
+	TIMER *timer = NULL;
 	TARGET_C *t = NULL;
-	int changes = FALSE;
+	int size = 0;
+	int j = 0;
 
-	i = list_start(_main->cache->list);
-	while (i != NULL) {
+	mutex_block(_main->cache->mutex);
 
-		/* Lookup target on my own every 5 minutes */
-		t = list_value(i);
-		if (now > t->refresh) {
-			p2p_cron_lookup(t->target, P2P_GET_PEERS);
-			time_add_5_min_approx(&t->refresh);
-			changes = TRUE;
+	/* Lookup target on my own every 5 minutes */
+	ilist_init(&due);
+	wheel_expire(_main->cache->renew, now, &due);
+	while ((timer = wheel_next(&due)) != NULL) {
+		t = wheel_value(timer, TARGET_C, t_refresh);
+		if (size < CACHE_SIZE_MAX) {
+			memcpy(targets[size++], t->target, SHA1_SIZE);
 		}
-
-		i = list_next(i);
+		time_add_5_min_approx(&t->refresh);
+		wheel_add(_main->cache->renew, &t->t_refresh, t->refresh, 0);
 	}
 
-	if (changes) {
+	if (size > 0) {
 		cache_print();
 	}
+
+	mutex_unblock(_main->cache->mutex);
+
+	/* The lookups lock the transactions and the routing table */
+	for (j = 0; j < size; j++) {
+		p2p_cron_lookup(targets[j], P2P_GET_PEERS);
+	}
 }
 
 void cache_print(void)
@@ -199,8 +259,11 @@ int cache_compact_list(UCHAR * nodes_compact_list, UCHAR * target_id)
 	int j = 0;
 	int size = 0;
 
+	mutex_block(_main->cache->mutex);
+
 	/* Look into the local database */
 	if ((target = cache_find(target_id)) == NULL) {
+		mutex_unblock(_main->cache->mutex);
 		return 0;
 	}
 
@@ -222,6 +285,10 @@ int cache_compact_list(UCHAR * nodes_compact_list, UCHAR * target_id)
 	/* Request for existing cache entry.
 	   Extend its valid lifetime to keep in warm. */
 	time_add_30_min(&target->lifetime);
+	wheel_add(_main->cache->expire, &target->t_lifetime, target->lifetime,
+		  CACHE_TIMER_TARGET);
+
+	mutex_unblock(_main->cache->mutex);
 
 	return size;
 }
@@ -244,9 +311,17 @@ TARGET_C *tgt_c_init(UCHAR * target_id)
 
 void tgt_c_free(TARGET_C * target)
 {
-	list_clear(target->list);
+	ITEM *i = NULL;
+
+	i = list_start(target->list);
+	while (i != NULL) {
+		node_c_free(list_value(i));
+		i = list_next(i);
+	}
 	list_free(target->list);
 	hash_free(target->hash);
+	wheel_del(&target->t_lifetime);
+	wheel_del(&target->t_refresh);
 	myfree(target);
 }
 
@@ -256,7 +331,7 @@ void tgt_c_put(TARGET_C * target, UCHAR * pair)
 	ITEM *i = NULL;
 	ITEM *s = NULL;
 
-	node = node_c_init(pair);
+	node = node_c_init(target, pair);
 	s = list_start(target->list);
 	i = list_ins(target->list, s, node);
 	hash_put(target->hash, node->pair, IP_SIZE_META_PAIR, i);
@@ -264,6 +339,9 @@ void tgt_c_put(TARGET_C * target, UCHAR * pair)
 	/* Lifetime + Refresh timer */
 	time_add_30_min(&target->lifetime);
 	time_add_5_min_approx(&target->refresh);
+	wheel_add(_main->cache->expire, &target->t_lifetime, target->lifetime,
+		  CACHE_TIMER_TARGET);
+	wheel_add(_main->cache->renew, &target->t_refresh, target->refresh, 0);
 
 	/* Limit reached. Delete last node */
 	if (list_size(target->list) > TGT_C_SIZE_MAX) {
@@ -280,26 +358,6 @@ void tgt_c_del(TARGET_C * target, ITEM * i)
 	node_c_free(node_c);
 }
 
-void tgt_c_expire(TARGET_C * target, time_t now)
-{
-	ITEM *i = NULL;
-	ITEM *n = NULL;
-	NODE_C *node = NULL;
-
-	i = list_start(target->list);
-	while (i != NULL) {
-		n = list_next(i);
-		node = list_value(i);
-
-		/* Delete info_hash after 30 minutes without announcement. */
-		if (now > node->eol) {
-			tgt_c_del(target, i);
-		}
-
-		i = n;
-	}
-}
-
 void tgt_c_print(TARGET_C * target)
 {
 	ITEM *i = NULL;
@@ -345,22 +403,27 @@ void tgt_c_update(TARGET_C * target, UCHAR * pair)
 	}
 }
 
-NODE_C *node_c_init(UCHAR * pair)
+NODE_C *node_c_init(TARGET_C * target, UCHAR * pair)
 {
-	NODE_C *node_c = (NODE_C *) myalloc(sizeof(NODE_C));
+	NODE_C *node_c =
+	    (NODE_C *) pool_alloc(POOL_NODE_C, sizeof(NODE_C));
+	node_c->target = target;
 	node_c_update(node_c, pair);
 	return node_c;
 }
 
 void node_c_free(NODE_C * node_c)
 {
-	myfree(node_c);
+	wheel_del(&node_c->timer);
+	pool_put(POOL_NODE_C, node_c);
 }
 
 void node_c_update(NODE_C * node_c, UCHAR * pair)
 {
 	memcpy(node_c->pair, pair, IP_SIZE_META_PAIR);
 	time_add_30_min(&node_c->eol);
+	wheel_add(_main->cache->expire, &node_c->timer, node_c->eol,
+		  CACHE_TIMER_NODE);
 }
 
 #if 0
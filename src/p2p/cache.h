@@ -22,6 +22,7 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../shr/list.h"
 #include "../shr/hash.h"
+#include "../shr/wheel.h"
 #include "hex.h"
 #include "../shr/log.h"
 #include "time.h"
@@ -33,21 +34,35 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #define CACHE_SIZE_MAX 50
 #define TGT_C_SIZE_MAX 10
 
+/* Timers in the expire wheel */
+#define CACHE_TIMER_TARGET 0
+#define CACHE_TIMER_NODE 1
+
+/* The expire wheel holds the lifetimes of targets and nodes. The renew wheel
+ * holds the refresh times of targets. */
 struct obj_cache {
+	pthread_mutex_t *mutex;
 	LIST *list;
 	HASH *hash;
+	WHEEL *expire;
+	WHEEL *renew;
 };
 typedef struct obj_cache CACHE;
 
 typedef struct {
 	UCHAR target[SHA1_SIZE];
+	ITEM *item;
 	LIST *list;
 	HASH *hash;
 	time_t lifetime;
 	time_t refresh;
+	TIMER t_lifetime;
+	TIMER t_refresh;
 } TARGET_C;
 
 typedef struct {
+	TIMER timer;
+	TARGET_C *target;
 	UCHAR pair[IP_SIZE_META_PAIR];
 	time_t eol;
 } NODE_C;
@@ -57,6 +72,7 @@ void cache_free(void);
 void cache_clean(void);
 void cache_put(UCHAR * target_id, UCHAR * nodes_compact_list,
 	       int nodes_compact_size);
+void cache_restore(UCHAR * target_id, UCHAR * pair, time_t eol);
 void cache_del(ITEM * i);
 TARGET_C *cache_prepare(UCHAR * target_id);
 void cache_expire(time_t now);
@@ -69,12 +85,11 @@ TARGET_C *tgt_c_init(UCHAR * target_id);
 void tgt_c_free(TARGET_C * target);
 void tgt_c_put(TARGET_C * target, UCHAR * pair);
 void tgt_c_del(TARGET_C * target, ITEM * i);
-void tgt_c_expire(TARGET_C * target, time_t now);
 void tgt_c_print(TARGET_C * target);
 ITEM *tgt_c_find(TARGET_C * target, UCHAR * pair);
 void tgt_c_update(TARGET_C * target, UCHAR * pair);
 
-NODE_C *node_c_init(UCHAR * pair);
+NODE_C *node_c_init(TARGET_C * target, UCHAR * pair);
 void node_c_free(NODE_C * node_c);
 void node_c_update(NODE_C * node_c, UCHAR * pair);
 
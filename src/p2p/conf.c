@@ -42,7 +42,10 @@ struct obj_conf *conf_init(int argc, char **argv)
 	conf->bootstrap_port = PORT_DHT_DEFAULT;
 	conf->announce_port = PORT_WWW_USER;
 	conf->cores = unix_cpus();
+	conf->workers = 1;
 	conf->bool_realm = FALSE;
+	conf->bool_snapshot = FALSE;
+	conf->bool_node_id = FALSE;
 #ifdef POLARSSL
 	conf->bool_encryption = FALSE;
 	memset(conf->key, '\0', BUF_SIZE);
@@ -59,7 +62,7 @@ struct obj_conf *conf_init(int argc, char **argv)
 	rand_urandom(conf->node_id, SHA1_SIZE);
 
 	/* Arguments */
-	while ((opt = getopt(argc, argv, "a:dhk:ln:p:P:qr:x:y:")) != -1) {
+	while ((opt = getopt(argc, argv, "a:df:hk:ln:p:P:qr:w:x:y:")) != -1) {
 		switch (opt) {
 		case 'a':
 			conf->announce_port = str_safe_port(optarg);
@@ -67,6 +70,10 @@ struct obj_conf *conf_init(int argc, char **argv)
 		case 'd':
 			log_set_mode(_log, CONF_DAEMON);
 			break;
+		case 'f':
+			snprintf(conf->snapshot, BUF_SIZE, "%s", optarg);
+			conf->bool_snapshot = TRUE;
+			break;
 		case 'h':
 			conf_usage(argv[0]);
 			break;
@@ -81,6 +88,7 @@ struct obj_conf *conf_init(int argc, char **argv)
 			break;
 		case 'n':
 			sha1_hash(conf->node_id, optarg, strlen(optarg));
+			conf->bool_node_id = TRUE;
 			break;
 		case 'p':
 			conf->p2p_port = str_safe_port(optarg);
@@ -95,6 +103,9 @@ struct obj_conf *conf_init(int argc, char **argv)
 			snprintf(conf->realm, BUF_SIZE, "%s", optarg);
 			conf->bool_realm = TRUE;
 			break;
+		case 'w':
+			conf->workers = atoi(optarg);
+			break;
 		case 'x':
 			snprintf(conf->bootstrap_node, BUF_SIZE, "%s", optarg);
 			conf->bootstrap_mode = BOOTSTRAP_HOST;
@@ -140,6 +151,10 @@ struct obj_conf *conf_init(int argc, char **argv)
 		fail("Invalid number of CPU cores");
 	}
 
+	if (conf->workers < 1 || conf->workers > 128) {
+		fail("Invalid number of P2P workers (-w)");
+	}
+
 	return conf;
 }
 
@@ -151,7 +166,9 @@ void conf_free(void)
 void conf_usage(char *command)
 {
 	fail("Usage: %s [-p port] [-r realm] [-P port] [-a port] "
-	     "[-x server] [-y port] [-n string] [-q] [-l] [-d] hostname1 hostname2",
+	     "[-x server] [-y port] [-n string] [-w workers] [-f file] "
+	     "[-q] [-l] [-d] "
+	     "hostname1 hostname2",
 	     command);
 }
 
@@ -216,4 +233,12 @@ void conf_print(void)
 	}
 
 	info(_log, NULL, "Cores: %i", _main->conf->cores);
+	info(_log, NULL, "P2P workers: %i (-w)", _main->conf->workers);
+	info(_log, NULL, "SHA1: %s", sha1_backend());
+
+	if (_main->conf->bool_snapshot == TRUE) {
+		info(_log, NULL, "Snapshot: %s (-f)", _main->conf->snapshot);
+	} else {
+		info(_log, NULL, "Snapshot: None (-f)");
+	}
 }
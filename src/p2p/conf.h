@@ -47,9 +47,14 @@ struct obj_conf {
 	int bootstrap_mode;
 	char bootstrap_lazy[BOOTSTRAP_SIZE][BUF_SIZE];
 
+	char snapshot[BUF_SIZE];
+	int bool_snapshot;
+
 	UCHAR node_id[SHA1_SIZE];
 	UCHAR null_id[SHA1_SIZE];
+	int bool_node_id;
 	int cores;
+	int workers;
 	int bool_realm;
 	unsigned int p2p_port;
 	unsigned int dns_port;
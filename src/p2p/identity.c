@@ -63,12 +63,16 @@ void id_hostid(UCHAR * host_id, char *hostname, char *realm, int bool)
 {
 	UCHAR sha1_buf1[SHA1_SIZE];
 	UCHAR sha1_buf2[SHA1_SIZE];
+	UCHAR *hash[2] = { sha1_buf1, sha1_buf2 };
+	const char *buffer[2] = { hostname, realm };
+	long int bytes[2];
 	int j = 0;
 
 	/* The realm influences the way, the lookup hash gets computed */
 	if (bool == TRUE) {
-		sha1_hash(sha1_buf1, hostname, strlen(hostname));
-		sha1_hash(sha1_buf2, realm, strlen(realm));
+		bytes[0] = strlen(hostname);
+		bytes[1] = strlen(realm);
+		sha1_hash_many(hash, buffer, bytes, 2);
 
 		for (j = 0; j < SHA1_SIZE; j++) {
 			host_id[j] = sha1_buf1[j] ^ sha1_buf2[j];
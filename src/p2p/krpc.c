@@ -0,0 +1,334 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "krpc.h"
+
+/*
+ * Validate the datagram and pick the known keys in one forward pass.
+ * The limits are BEN_STR_MAXLEN and friends. Anything else is walked and
+ * skipped.
+ */
+int krpc_decode(KRPC * msg, UCHAR * bencode, LONG bensize)
+{
+	RAW raw;
+
+	memset(msg, '\0', sizeof(KRPC));
+
+	raw.code = bencode;
+	raw.size = bensize;
+	raw.p = bencode;
+
+	return krpc_top(msg, &raw);
+}
+
+int krpc_top(KRPC * msg, RAW * raw)
+{
+	STR key;
+	int ok = 0;
+
+	if (!krpc_more(raw) || *raw->p != 'd') {
+		return 0;
+	}
+	raw->p++;
+
+	while (krpc_more(raw) && *raw->p != 'e') {
+		if (!krpc_str(raw, &key) || !krpc_more(raw)) {
+			return 0;
+		}
+
+		if (krpc_key(&key, "y", 1)) {
+			ok = krpc_str_or_skip(raw, &msg->y, 1);
+		} else if (krpc_key(&key, "t", 1)) {
+			ok = krpc_str_or_skip(raw, &msg->t, 1);
+		} else if (krpc_key(&key, "q", 1)) {
+			ok = krpc_str_or_skip(raw, &msg->q, 1);
+		} else if (krpc_key(&key, "a", 1) && *raw->p == 'd') {
+			msg->a = 1;
+			ok = krpc_arg(msg, raw);
+		} else if (krpc_key(&key, "r", 1) && *raw->p == 'd') {
+			msg->r = 1;
+			ok = krpc_arg(msg, raw);
+		} else if (krpc_key(&key, "e", 1) && *raw->p == 'l') {
+			msg->e = 1;
+			ok = krpc_error(msg, raw);
+		} else {
+			ok = krpc_skip(raw, 1);
+		}
+
+		if (!ok) {
+			return 0;
+		}
+	}
+
+	if (!krpc_more(raw)) {
+		return 0;
+	}
+	raw->p++;
+
+	return 1;
+}
+
+int krpc_arg(KRPC * msg, RAW * raw)
+{
+	STR key;
+	int ok = 0;
+
+	raw->p++;
+
+	while (krpc_more(raw) && *raw->p != 'e') {
+		if (!krpc_str(raw, &key) || !krpc_more(raw)) {
+			return 0;
+		}
+
+		if (krpc_key(&key, "id", 2)) {
+			ok = krpc_str_or_skip(raw, &msg->id, 2);
+		} else if (krpc_key(&key, "target", 6)) {
+			ok = krpc_str_or_skip(raw, &msg->target, 2);
+		} else if (krpc_key(&key, "info_hash", 9)) {
+			ok = krpc_str_or_skip(raw, &msg->info_hash, 2);
+		} else if (krpc_key(&key, "token", 5)) {
+			ok = krpc_str_or_skip(raw, &msg->token, 2);
+#ifdef IPV6
+		} else if (krpc_key(&key, "nodes6", 6)) {
+#elif IPV4
+		} else if (krpc_key(&key, "nodes", 5)) {
+#endif
+			ok = krpc_str_or_skip(raw, &msg->nodes, 2);
+		} else if (krpc_key(&key, "port", 4) && *raw->p == 'i') {
+			msg->port_found = 1;
+			ok = krpc_int(raw, &msg->port);
+		} else if (krpc_key(&key, "values", 6) && *raw->p == 'l') {
+			msg->values_found = 1;
+			ok = krpc_values(msg, raw);
+		} else {
+			ok = krpc_skip(raw, 2);
+		}
+
+		if (!ok) {
+			return 0;
+		}
+	}
+
+	if (!krpc_more(raw)) {
+		return 0;
+	}
+	raw->p++;
+
+	return 1;
+}
+
+int krpc_values(KRPC * msg, RAW * raw)
+{
+	int ok = 0;
+
+	raw->p++;
+
+	while (krpc_more(raw) && *raw->p != 'e') {
+		if (msg->values_size < KRPC_VALUES_MAX) {
+			ok = krpc_str_or_skip(raw,
+					      &msg->values[msg->values_size],
+					      3);
+			msg->values_size++;
+		} else {
+			ok = krpc_skip(raw, 3);
+		}
+
+		if (!ok) {
+			return 0;
+		}
+	}
+
+	if (!krpc_more(raw)) {
+		return 0;
+	}
+	raw->p++;
+
+	return 1;
+}
+
+int krpc_error(KRPC * msg, RAW * raw)
+{
+	int first = 1;
+	int ok = 0;
+
+	raw->p++;
+
+	/* The code comes first and the message last */
+	while (krpc_more(raw) && *raw->p != 'e') {
+		if (first && *raw->p == 'i') {
+			msg->e_code_found = 1;
+			ok = krpc_int(raw, &msg->e_code);
+		} else {
+			ok = krpc_str_or_skip(raw, &msg->e_msg, 2);
+		}
+		first = 0;
+
+		if (!ok) {
+			return 0;
+		}
+	}
+
+	if (!krpc_more(raw)) {
+		return 0;
+	}
+	raw->p++;
+
+	return 1;
+}
+
+int krpc_key(STR * key, const char *name, LONG size)
+{
+	return key->i == size && memcmp(key->s, name, size) == 0;
+}
+
+int krpc_str(RAW * raw, STR * str)
+{
+	LONG size = 0;
+	int digits = 0;
+
+	while (krpc_more(raw) && *raw->p >= '0' && *raw->p <= '9') {
+		if (++digits > BEN_STR_MAXLEN) {
+			return 0;
+		}
+		size = size * 10 + (*raw->p - '0');
+		raw->p++;
+	}
+
+	if (digits == 0 || !krpc_more(raw) || *raw->p != ':') {
+		return 0;
+	}
+	raw->p++;
+
+	if (size > BEN_STR_MAXSIZE) {
+		return 0;
+	}
+	if (size > (LONG) (raw->code + raw->size - raw->p)) {
+		return 0;
+	}
+
+	str->s = raw->p;
+	str->i = size;
+	raw->p += size;
+
+	return 1;
+}
+
+int krpc_str_or_skip(RAW * raw, STR * str, int depth)
+{
+	if (*raw->p >= '0' && *raw->p <= '9') {
+		return krpc_str(raw, str);
+	}
+
+	/* Wrong type: Treat it like a missing key */
+	str->s = NULL;
+	str->i = 0;
+
+	return krpc_skip(raw, depth);
+}
+
+int krpc_int(RAW * raw, LONG * result)
+{
+	LONG sign = 1;
+	LONG value = 0;
+	int digits = 0;
+
+	raw->p++;
+
+	if (krpc_more(raw) && *raw->p == '-') {
+		sign = -1;
+		raw->p++;
+	}
+
+	while (krpc_more(raw) && *raw->p >= '0' && *raw->p <= '9') {
+		if (++digits > BEN_INT_MAXLEN) {
+			return 0;
+		}
+		value = value * 10 + (*raw->p - '0');
+		raw->p++;
+	}
+
+	if (digits == 0 || !krpc_more(raw) || *raw->p != 'e') {
+		return 0;
+	}
+	raw->p++;
+
+	if (value > BEN_INT_MAXSIZE) {
+		return 0;
+	}
+
+	*result = sign * value;
+
+	return 1;
+}
+
+int krpc_skip(RAW * raw, int depth)
+{
+	STR str;
+	LONG i = 0;
+
+	if (depth > KRPC_DEPTH_MAX || !krpc_more(raw)) {
+		return 0;
+	}
+
+	switch (*raw->p) {
+	case 'd':
+		raw->p++;
+		while (krpc_more(raw) && *raw->p != 'e') {
+			if (!krpc_str(raw, &str)) {
+				return 0;
+			}
+			if (!krpc_skip(raw, depth + 1)) {
+				return 0;
+			}
+		}
+		break;
+
+	case 'l':
+		raw->p++;
+		while (krpc_more(raw) && *raw->p != 'e') {
+			if (!krpc_skip(raw, depth + 1)) {
+				return 0;
+			}
+		}
+		break;
+
+	case 'i':
+		return krpc_int(raw, &i);
+
+	default:
+		return krpc_str(raw, &str);
+	}
+
+	/* Closing 'e' of a dictionary or a list */
+	if (!krpc_more(raw)) {
+		return 0;
+	}
+	raw->p++;
+
+	return 1;
+}
+
+int krpc_more(RAW * raw)
+{
+	return raw->p < raw->code + raw->size;
+}
@@ -0,0 +1,80 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef KRPC_H
+#define KRPC_H
+
+#include "../shr/config.h"
+#include "ben.h"
+
+/* Unknown keys may hide nested data. Do not follow it forever. */
+#define KRPC_DEPTH_MAX 16
+
+/* p2p_get_peers_get_values() never looks at more than 8 peers */
+#define KRPC_VALUES_MAX 8
+
+/*
+ * One KRPC message decoded in a single pass. Every string is a borrowed
+ * slice of the datagram. A string with s == NULL was missing or had the
+ * wrong type. Fields of the "a" (query) and "r" (reply) dictionaries end up
+ * in the same place.
+ */
+struct obj_krpc {
+	/* Top level */
+	STR y;
+	STR t;
+	STR q;
+	int a;
+	int r;
+	int e;
+
+	/* Query arguments or reply values */
+	STR id;
+	STR target;
+	STR info_hash;
+	STR token;
+	STR nodes;
+	int port_found;
+	LONG port;
+	int values_found;
+	int values_size;
+	STR values[KRPC_VALUES_MAX];
+
+	/* Error: [code, "message"] */
+	int e_code_found;
+	LONG e_code;
+	STR e_msg;
+};
+typedef struct obj_krpc KRPC;
+
+int krpc_decode(KRPC * msg, UCHAR * bencode, LONG bensize);
+
+int krpc_top(KRPC * msg, RAW * raw);
+int krpc_arg(KRPC * msg, RAW * raw);
+int krpc_values(KRPC * msg, RAW * raw);
+int krpc_error(KRPC * msg, RAW * raw);
+
+int krpc_key(STR * key, const char *name, LONG size);
+int krpc_str(RAW * raw, STR * str);
+int krpc_str_or_skip(RAW * raw, STR * str, int depth);
+int krpc_int(RAW * raw, LONG * result);
+int krpc_skip(RAW * raw, int depth);
+int krpc_more(RAW * raw);
+
+#endif
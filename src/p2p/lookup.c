@@ -43,6 +43,8 @@ LOOKUP *ldb_init(UCHAR * target, IP * from, DNS_MSG * msg)
 	memcpy(l->target, target, SHA1_SIZE);
 	l->send_response_to_initiator = FALSE;
 	l->number_of_dns_responses = 0;
+	l->size = 0;
+	l->inflight = 0;
 	memset(&l->c_addr, '\0', sizeof(IP));
 
 	if (from != NULL) {
@@ -51,82 +53,102 @@ LOOKUP *ldb_init(UCHAR * target, IP * from, DNS_MSG * msg)
 		memcpy(&l->msg, msg, sizeof(DNS_MSG));
 	}
 
-	l->hash = hash_init(1000);
-	l->list = list_init();
-
 	return l;
 }
 
 void ldb_free(LOOKUP * l)
 {
-	if (l == NULL) {
-		return;
-	}
-	hash_free(l->hash);
-	list_clear(l->list);
-	list_free(l->list);
 	myfree(l);
 }
 
-LONG ldb_put(LOOKUP * l, UCHAR * node_id, IP * from)
+/*
+ * Keep the LOOKUP_SIZE closest nodes. Returns the index of the new node or
+ * -1 if the node is known already or too far away.
+ */
+int ldb_put(LOOKUP * l, UCHAR * node_id, IP * from)
 {
-	ITEM *i = NULL;
-	NODE_L *new = NULL;
 	NODE_L *n = NULL;
-	LONG index = 0;
+	int index = 0;
 
-	/* Wow. Something is broken or this Kademlia cloud is huge. */
-	if (list_size(l->list) >= 32767) {
-		info(_log, from,
-		     "ldb_put(): Too many nodes without end in sight.");
-		return 32767;
+	/* Too far away. Nodes that were dropped once never come back. */
+	index = ldb_search(l, node_id);
+	if (index >= LOOKUP_SIZE) {
+		return -1;
 	}
 
-	new = (NODE_L *) myalloc(sizeof(NODE_L));
-	memcpy(new->id, node_id, SHA1_SIZE);
-	memcpy(&new->c_addr, from, sizeof(IP));
-	memset(new->token, '\0', TOKEN_SIZE_MAX);
-	new->token_size = 0;
-
-	/* Create a sorted list. The first nodes are the best fitting. */
-	i = list_start(l->list);
-	while (i != NULL) {
-		n = list_value(i);
-
-		/* Look, whose node_id fits better to the target */
-		if (str_sha1_compare(node_id, n->id, l->target) < 0) {
-			list_ins(l->list, i, new);
-			hash_put(l->hash, new->id, SHA1_SIZE, new);
-			return index;
-		}
+	/* Never add a node twice. A match sits right before index. */
+	if (index > 0
+	    && memcmp(l->node[index - 1].id, node_id, SHA1_SIZE) == 0) {
+		return -1;
+	}
 
-		i = list_next(i);
-		index++;
+	/* Full. Drop the farthest node. */
+	if (l->size == LOOKUP_SIZE) {
+		if (l->node[l->size - 1].state == NODE_L_SENT) {
+			l->inflight--;
+		}
+		l->size--;
 	}
 
-	/* Last resort. Append the node, so that it does not get a query again. */
-	list_put(l->list, new);
-	hash_put(l->hash, new->id, SHA1_SIZE, new);
+	memmove(&l->node[index + 1], &l->node[index],
+		(l->size - index) * sizeof(NODE_L));
+	l->size++;
+
+	n = &l->node[index];
+	memset(n, '\0', sizeof(NODE_L));
+	memcpy(n->id, node_id, SHA1_SIZE);
+	memcpy(&n->c_addr, from, sizeof(IP));
+	n->state = NODE_L_NEW;
 
 	return index;
 }
 
+/* Binary search: The first node that is farther away than node_id */
+int ldb_search(LOOKUP * l, UCHAR * node_id)
+{
+	int lo = 0;
+	int hi = l->size;
+	int mid = 0;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (str_sha1_compare(l->node[mid].id, node_id, l->target) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
 NODE_L *ldb_find(LOOKUP * l, UCHAR * node_id)
 {
-	return hash_get(l->hash, node_id, SHA1_SIZE);
+	int index = ldb_search(l, node_id);
+
+	/* The XOR distance is unique. A match sits right before index. */
+	if (index == 0) {
+		return NULL;
+	}
+	if (memcmp(l->node[index - 1].id, node_id, SHA1_SIZE) != 0) {
+		return NULL;
+	}
+
+	return &l->node[index - 1];
 }
 
-void ldb_update(LOOKUP * l, UCHAR * node_id, BEN * token, IP * from)
+void ldb_update(LOOKUP * l, UCHAR * node_id, UCHAR * token, int token_size,
+		IP * from)
 {
 	NODE_L *n = NULL;
 
-	if ((n = hash_get(l->hash, node_id, SHA1_SIZE)) == NULL) {
+	if ((n = ldb_find(l, node_id)) == NULL) {
 		return;
 	}
 
 	memcpy(&n->c_addr, from, sizeof(IP));
-	memcpy(&n->token, ben_str_s(token), ben_str_i(token));
-	n->token_size = ben_str_i(token);
+	memcpy(&n->token, token, token_size);
+	n->token_size = token_size;
 }
 
 int ldb_number_of_dns_responses(LOOKUP * l)
@@ -140,3 +162,126 @@ int ldb_number_of_dns_responses(LOOKUP * l)
 
 	return current_number;
 }
+
+/*
+ * The closest node that has not been queried yet. Only the LOOKUP_K closest
+ * nodes that did not time out are considered. NULL if there is none or if
+ * enough queries are in flight.
+ */
+NODE_L *ldb_next(LOOKUP * l)
+{
+	NODE_L *n = NULL;
+	int i = 0;
+	int j = 0;
+
+	if (l->inflight >= LOOKUP_ALPHA) {
+		return NULL;
+	}
+
+	for (i = 0; i < l->size && j < LOOKUP_K; i++) {
+		n = &l->node[i];
+
+		switch (n->state) {
+		case NODE_L_NEW:
+			return n;
+		case NODE_L_FAILED:
+			break;
+		default:
+			j++;
+		}
+	}
+
+	return NULL;
+}
+
+void ldb_sent(LOOKUP * l, NODE_L * n, LONG now, LONG timeout)
+{
+	/* The lookup shares one TID. The send time is per node. */
+	n->state = NODE_L_SENT;
+	n->time_sent = now;
+	n->deadline = now + timeout;
+	l->inflight++;
+}
+
+void ldb_answer(LOOKUP * l, UCHAR * node_id)
+{
+	NODE_L *n = NULL;
+
+	if ((n = ldb_find(l, node_id)) == NULL) {
+		return;
+	}
+
+	/* A late answer is still an answer */
+	switch (n->state) {
+	case NODE_L_SENT:
+		l->inflight--;
+		n->state = NODE_L_DONE;
+		break;
+	case NODE_L_FAILED:
+		n->state = NODE_L_DONE;
+		break;
+	}
+}
+
+void ldb_expire(LOOKUP * l, LONG now)
+{
+	NODE_L *n = NULL;
+	int i = 0;
+
+	for (i = 0; i < l->size && l->inflight > 0; i++) {
+		n = &l->node[i];
+
+		if (ldb_expired(n, now)) {
+			n->state = NODE_L_FAILED;
+			l->inflight--;
+		}
+	}
+}
+
+int ldb_expired(NODE_L * n, LONG now)
+{
+	return (n->state == NODE_L_SENT && now >= n->deadline) ? TRUE : FALSE;
+}
+
+/* Done if the LOOKUP_K closest nodes that did not time out have answered */
+int ldb_done(LOOKUP * l)
+{
+	NODE_L *n = NULL;
+	int i = 0;
+	int j = 0;
+
+	for (i = 0; i < l->size && j < LOOKUP_K; i++) {
+		n = &l->node[i];
+
+		switch (n->state) {
+		case NODE_L_DONE:
+			j++;
+			break;
+		case NODE_L_FAILED:
+			break;
+		default:
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* The next per hop timeout in ms. 0 if nothing is in flight. */
+LONG ldb_deadline(LOOKUP * l)
+{
+	NODE_L *n = NULL;
+	LONG deadline = 0;
+	int i = 0;
+
+	for (i = 0; i < l->size; i++) {
+		n = &l->node[i];
+
+		if (n->state == NODE_L_SENT &&
+		    (deadline == 0 || n->deadline < deadline)) {
+			deadline = n->deadline;
+		}
+	}
+
+	return deadline;
+}
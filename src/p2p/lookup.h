@@ -21,17 +21,49 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #define LOOKUP_H
 
 #include "../shr/malloc.h"
-#include "../shr/list.h"
 #include "../shr/str.h"
 #include "../dns/dns.h"
 #include "token.h"
 
+/* Queries in flight per lookup */
+#define LOOKUP_ALPHA 3
+
+/* The lookup is over once the K closest nodes have answered */
+#define LOOKUP_K 8
+
+/* Per hop timeout in ms. 3 times the round trip time if known. */
+#define LOOKUP_TIMEOUT_MIN 250
+#define LOOKUP_TIMEOUT_MAX 2000
+
+/* Candidates per lookup. Room for some timeouts among the K closest. */
+#define LOOKUP_SIZE (4 * LOOKUP_K)
+
+/* State of a node within a lookup */
+#define NODE_L_NEW 0
+#define NODE_L_SENT 1
+#define NODE_L_DONE 2
+#define NODE_L_FAILED 3
+
+typedef struct {
+	UCHAR id[SHA1_SIZE];
+	IP c_addr;
+	UCHAR token[TOKEN_SIZE_MAX];
+	int token_size;
+	int state;
+	LONG time_sent;
+	LONG deadline;
+} NODE_L;
+
 typedef struct {
 	/* What are we looking for */
 	UCHAR target[SHA1_SIZE];
 
-	LIST *list;
-	HASH *hash;
+	/* The closest nodes so far. Sorted, the best fitting first. */
+	NODE_L node[LOOKUP_SIZE];
+	int size;
+
+	/* Nodes in state NODE_L_SENT */
+	int inflight;
 
 	/* Caller */
 	IP c_addr;
@@ -41,21 +73,24 @@ typedef struct {
 
 } LOOKUP;
 
-typedef struct {
-	UCHAR id[SHA1_SIZE];
-	IP c_addr;
-	UCHAR token[TOKEN_SIZE_MAX];
-	int token_size;
-} NODE_L;
-
 LOOKUP *ldb_init(UCHAR * target, IP * from, DNS_MSG * msg);
 void ldb_free(LOOKUP * l);
 
-LONG ldb_put(LOOKUP * l, UCHAR * node_id, IP * from);
+int ldb_put(LOOKUP * l, UCHAR * node_id, IP * from);
+int ldb_search(LOOKUP * l, UCHAR * node_id);
 
 NODE_L *ldb_find(LOOKUP * l, UCHAR * node_id);
-void ldb_update(LOOKUP * l, UCHAR * node_id, BEN * token, IP * from);
+void ldb_update(LOOKUP * l, UCHAR * node_id, UCHAR * token, int token_size,
+		IP * from);
 
 int ldb_number_of_dns_responses(LOOKUP * l);
 
+NODE_L *ldb_next(LOOKUP * l);
+void ldb_sent(LOOKUP * l, NODE_L * n, LONG now, LONG timeout);
+void ldb_answer(LOOKUP * l, UCHAR * node_id);
+void ldb_expire(LOOKUP * l, LONG now);
+int ldb_expired(NODE_L * n, LONG now);
+int ldb_done(LOOKUP * l);
+LONG ldb_deadline(LOOKUP * l);
+
 #endif
@@ -39,21 +39,39 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 NBHD *nbhd_init(void)
 {
 	NBHD *nbhd = (NBHD *) myalloc(sizeof(NBHD));
-	nbhd->bucket = bckt_init();
-	nbhd->hash = hash_init(4096);
+	if (pthread_rwlock_init(&nbhd->lock, NULL) != 0) {
+		fail("pthread_rwlock_init() failed.");
+	}
+	nbhd->bucket = bckt_init(_main->conf->node_id);
 	return nbhd;
 }
 
 void nbhd_free(void)
 {
 	bckt_free(_main->nbhd->bucket);
-	hash_free(_main->nbhd->hash);
+	pthread_rwlock_destroy(&_main->nbhd->lock);
 	myfree(_main->nbhd);
 }
 
+void nbhd_rdlock(void)
+{
+	pthread_rwlock_rdlock(&_main->nbhd->lock);
+}
+
+void nbhd_wrlock(void)
+{
+	pthread_rwlock_wrlock(&_main->nbhd->lock);
+}
+
+void nbhd_unlock(void)
+{
+	pthread_rwlock_unlock(&_main->nbhd->lock);
+}
+
 void nbhd_put(UCHAR * id, IP * sa)
 {
-	UDP_NODE *n = NULL;
+	BUCK *b = NULL;
+	int i = 0;
 
 	/* It's me */
 	if (node_me(id)) {
@@ -65,88 +83,128 @@ void nbhd_put(UCHAR * id, IP * sa)
 		return;
 	}
 
-	/* Find the node or create a new one */
-	if ((n = hash_get(_main->nbhd->hash, id, SHA1_SIZE)) != NULL) {
-		node_update(n, sa);
+	/* Known node at the same address: Nothing to change */
+	nbhd_rdlock();
+	i = bckt_find_node(_main->nbhd->bucket, id, &b);
+	if (i >= 0 && memcmp(&b->nodes.c_addr[i], sa, sizeof(IP)) == 0) {
+		nbhd_unlock();
 		return;
 	}
+	nbhd_unlock();
 
-	/* New node */
-	n = node_init(id, sa);
+	nbhd_wrlock();
 
-	/* Remember node */
-	if (!bckt_put(_main->nbhd->bucket, n)) {
-		node_free(n);
+	/* Find the node or create a new one */
+	if ((i = bckt_find_node(_main->nbhd->bucket, id, &b)) >= 0) {
+		node_update(&b->nodes, i, sa);
+		nbhd_unlock();
 		return;
 	}
 
-	/* Fast access */
-	hash_put(_main->nbhd->hash, n->id, SHA1_SIZE, n);
+	/* Remember node */
+	bckt_put(_main->nbhd->bucket, id, sa);
+
+	nbhd_unlock();
 }
 
-void nbhd_del(UDP_NODE * n)
+void nbhd_del(BUCK * b, int i)
 {
-	bckt_del(_main->nbhd->bucket, n);
-	hash_del(_main->nbhd->hash, n->id, SHA1_SIZE);
-	node_free(n);
+	bckt_del(_main->nbhd->bucket, b, i);
 }
 
 void nbhd_pinged(UCHAR * id)
 {
-	UDP_NODE *n = hash_get(_main->nbhd->hash, id, SHA1_SIZE);
+	BUCK *b = NULL;
+	int i = 0;
 
-	if (n != NULL) {
-		node_pinged(n);
+	nbhd_wrlock();
+	if ((i = bckt_find_node(_main->nbhd->bucket, id, &b)) >= 0) {
+		node_pinged(&b->nodes, i, TRUE);
 	}
+	nbhd_unlock();
 }
 
 void nbhd_ponged(UCHAR * id, IP * from)
 {
-	UDP_NODE *n = hash_get(_main->nbhd->hash, id, SHA1_SIZE);
+	BUCK *b = NULL;
+	int i = 0;
 
-	if (n != NULL) {
-		node_ponged(n, from);
+	nbhd_wrlock();
+	if ((i = bckt_find_node(_main->nbhd->bucket, id, &b)) >= 0) {
+		node_ponged(&b->nodes, i, from);
 	}
+	nbhd_unlock();
 }
 
-void nbhd_expire(time_t now)
+/* The slot does not move under the read lock. The statistics get stored
+ * atomically. Two workers updating the same node at once lose a sample at
+ * worst. */
+void nbhd_rtt(UCHAR * id, LONG ms)
 {
-	ITEM *item_b = NULL;
 	BUCK *b = NULL;
-	ITEM *item_n = NULL;
-	ITEM *item_n_next = NULL;
-	UDP_NODE *n = NULL;
+	int i = 0;
 
-	/* Cycle through all the buckets */
-	item_b = list_start(_main->nbhd->bucket);
-	while (item_b != NULL) {
-		b = list_value(item_b);
-
-		/* Cycle through all the nodes */
-		item_n = list_start(b->nodes);
-		while (item_n != NULL) {
-			n = list_value(item_n);
+	nbhd_rdlock();
+	if ((i = bckt_find_node(_main->nbhd->bucket, id, &b)) >= 0) {
+		node_rtt(&b->nodes, i, ms);
+	}
+	nbhd_unlock();
+}
 
-			item_n_next = list_next(item_n);
+void nbhd_lost(UCHAR * id)
+{
+	BUCK *b = NULL;
+	int i = 0;
 
-			/* Bad node */
-			if (node_bad(n)) {
-				nbhd_del(n);
-			}
+	nbhd_rdlock();
+	if ((i = bckt_find_node(_main->nbhd->bucket, id, &b)) >= 0) {
+		node_lost(&b->nodes, i);
+	}
+	nbhd_unlock();
+}
 
-			item_n = item_n_next;
-		}
+/* 0 if unknown */
+LONG nbhd_rtt_get(UCHAR * id)
+{
+	BUCK *b = NULL;
+	LONG rtt = 0;
+	int i = 0;
 
-		item_b = list_next(item_b);
+	nbhd_rdlock();
+	if ((i = bckt_find_node(_main->nbhd->bucket, id, &b)) >= 0) {
+		rtt = __atomic_load_n(&b->nodes.rtt[i], __ATOMIC_RELAXED);
 	}
+	nbhd_unlock();
+
+	return rtt;
 }
 
-void nbhd_split(UCHAR * target, int verbose)
+void nbhd_split(int verbose)
 {
-	bckt_split_loop(_main->nbhd->bucket, target, verbose);
+	nbhd_wrlock();
+	bckt_split_loop(_main->nbhd->bucket, verbose);
+	nbhd_unlock();
 }
 
 int nbhd_is_empty(void)
 {
-	return bckt_is_empty(_main->nbhd->bucket);
+	int result = FALSE;
+
+	nbhd_rdlock();
+	result = bckt_is_empty(_main->nbhd->bucket);
+	nbhd_unlock();
+
+	return result;
+}
+
+int nbhd_compact_list(UCHAR * nodes_compact_list, UCHAR * target)
+{
+	int size = 0;
+
+	nbhd_rdlock();
+	size = bckt_compact_list(_main->nbhd->bucket, nodes_compact_list,
+				 target);
+	nbhd_unlock();
+
+	return size;
 }
@@ -25,24 +25,35 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include "node_udp.h"
 #include "bucket.h"
 
+/*
+ * The routing table is read by every worker and changed rarely. Readers
+ * share the lock. Callers that walk the buckets themselves take it too.
+ */
 struct obj_nbhd {
-	LIST *bucket;
-	HASH *hash;
+	pthread_rwlock_t lock;
+	BCKT *bucket;
 };
 typedef struct obj_nbhd NBHD;
 
 NBHD *nbhd_init(void);
 void nbhd_free(void);
 
+void nbhd_rdlock(void);
+void nbhd_wrlock(void);
+void nbhd_unlock(void);
+
 void nbhd_put(UCHAR * id, IP * sa);
-void nbhd_del(UDP_NODE * n);
+void nbhd_del(BUCK * b, int i);
 
 void nbhd_pinged(UCHAR * id);
 void nbhd_ponged(UCHAR * id, IP * from);
+void nbhd_rtt(UCHAR * id, LONG ms);
+void nbhd_lost(UCHAR * id);
+LONG nbhd_rtt_get(UCHAR * id);
 
-void nbhd_expire(time_t now);
-void nbhd_split(UCHAR * target, int verbose);
+void nbhd_split(int verbose);
 
 int nbhd_is_empty(void);
+int nbhd_compact_list(UCHAR * nodes_compact_list, UCHAR * target);
 
 #endif
@@ -36,38 +36,40 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "node_udp.h"
 
-UDP_NODE *node_init(UCHAR * node_id, IP * sa)
+void node_init(UDP_NODES * n, int i, UCHAR * node_id, IP * sa)
 {
-	UDP_NODE *n = (UDP_NODE *) myalloc(sizeof(UDP_NODE));
-
 	/* ID */
-	memcpy(n->id, node_id, SHA1_SIZE);
+	memcpy(n->id[i], node_id, SHA1_SIZE);
 
 	/* Timings */
-	n->time_ping = 0;
-	n->time_find = 0;
-	n->pinged = 0;
-
-	/* Update IP address */
-	node_update(n, sa);
-
-	return n;
+	n->time_ping[i] = 0;
+	n->time_find[i] = 0;
+	n->pinged[i] = 0;
+	n->probed[i] = 0;
+	n->rtt[i] = 0;
+	n->loss[i] = 0;
+
+	/* Address */
+	memcpy(&n->c_addr[i], sa, sizeof(IP));
 }
 
-void node_free(UDP_NODE * n)
+void node_copy(UDP_NODES * to, int j, UDP_NODES * from, int i)
 {
-	myfree(n);
+	memcpy(to->id[j], from->id[i], SHA1_SIZE);
+	memcpy(&to->c_addr[j], &from->c_addr[i], sizeof(IP));
+	to->time_ping[j] = from->time_ping[i];
+	to->time_find[j] = from->time_find[i];
+	to->pinged[j] = from->pinged[i];
+	to->probed[j] = from->probed[i];
+	to->rtt[j] = from->rtt[i];
+	to->loss[j] = from->loss[i];
 }
 
-void node_update(UDP_NODE * n, IP * sa)
+void node_update(UDP_NODES * n, int i, IP * sa)
 {
-	if (n == NULL) {
-		return;
-	}
-
 	/* Update address */
-	if (memcmp(&n->c_addr, sa, sizeof(IP)) != 0) {
-		memcpy(&n->c_addr, sa, sizeof(IP));
+	if (memcmp(&n->c_addr[i], sa, sizeof(IP)) != 0) {
+		memcpy(&n->c_addr[i], sa, sizeof(IP));
 	}
 }
 
@@ -87,33 +89,83 @@ int node_equal(const UCHAR * node_a, const UCHAR * node_b)
 	return 0;
 }
 
-int node_ok(UDP_NODE * n)
+int node_ok(UDP_NODES * n, int i)
 {
-	return (n->pinged <= 1) ? TRUE : FALSE;
+	return (n->pinged[i] <= 1) ? TRUE : FALSE;
 }
 
-int node_bad(UDP_NODE * n)
+int node_bad(UDP_NODES * n, int i)
 {
-	return (n->pinged >= 4) ? TRUE : FALSE;
+	return (n->pinged[i] >= 4) ? TRUE : FALSE;
 }
 
-void node_pinged(UDP_NODE * n)
+void node_pinged(UDP_NODES * n, int i, int sent)
 {
+	/* The last ping went out and got no answer */
+	if (n->probed[i]) {
+		node_lost(n, i);
+	}
+	n->probed[i] = sent;
+
 	/* Remember no of pings */
-	n->pinged++;
+	n->pinged[i]++;
 
 	/* Try again in ~5 minutes */
-	time_add_5_min_approx(&n->time_ping);
+	time_add_5_min_approx(&n->time_ping[i]);
 }
 
-void node_ponged(UDP_NODE * n, IP * from)
+void node_ponged(UDP_NODES * n, int i, IP * from)
 {
 	/* Reset no of pings */
-	n->pinged = 0;
+	n->pinged[i] = 0;
+	n->probed[i] = 0;
 
 	/* Try again in ~5 minutes */
-	time_add_5_min_approx(&n->time_ping);
+	time_add_5_min_approx(&n->time_ping[i]);
 
 	/* Update IP */
-	node_update(n, from);
+	node_update(n, i, from);
+}
+
+void node_rtt(UDP_NODES * n, int i, LONG ms)
+{
+	LONG rtt = __atomic_load_n(&n->rtt[i], __ATOMIC_RELAXED);
+	UCHAR loss = __atomic_load_n(&n->loss[i], __ATOMIC_RELAXED);
+
+	if (ms < 1) {
+		ms = 1;
+	} else if (ms > NODE_RTT_MAX) {
+		ms = NODE_RTT_MAX;
+	}
+
+	/* Smooth it like TCP does: 7/8 old + 1/8 new */
+	rtt = (rtt == 0) ? ms : (7 * rtt + ms) / 8;
+	__atomic_store_n(&n->rtt[i], rtt, __ATOMIC_RELAXED);
+
+	/* An answer */
+	loss -= (loss + 7) / 8;
+	__atomic_store_n(&n->loss[i], loss, __ATOMIC_RELAXED);
+}
+
+/* A query timed out */
+void node_lost(UDP_NODES * n, int i)
+{
+	UCHAR loss = __atomic_load_n(&n->loss[i], __ATOMIC_RELAXED);
+
+	loss += (255 - loss) / 8;
+	__atomic_store_n(&n->loss[i], loss, __ATOMIC_RELAXED);
+}
+
+/* Lost answers cost another timeout. Losing all of them costs 5 times the
+ * round trip time. */
+LONG node_cost(UDP_NODES * n, int i)
+{
+	LONG rtt = __atomic_load_n(&n->rtt[i], __ATOMIC_RELAXED);
+	LONG loss = __atomic_load_n(&n->loss[i], __ATOMIC_RELAXED);
+
+	if (rtt == 0) {
+		rtt = NODE_RTT_DEFAULT;
+	}
+
+	return rtt + rtt * loss / 64;
 }
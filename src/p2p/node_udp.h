@@ -23,26 +23,53 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include "conf.h"
 #include "token.h"
 
+/* Do not store more than 20 nodes per bucket */
+#define NODE_SLOTS 20
+
+/* Round trip times in ms. A node without answers yet counts as slow. */
+#define NODE_RTT_DEFAULT 1000
+#define NODE_RTT_MAX 65535
+
+/*
+ * The nodes of one bucket, stored inline. The IDs are packed for distance
+ * scans. Addresses and timers are kept apart from them. Slots are filled in
+ * the order the nodes arrive.
+ *
+ * rtt is the smoothed round trip time in ms, 0 until the first answer. loss
+ * estimates the share of lost answers from 0 to 255. It only grows for
+ * queries that went out and timed out. probed is set while a ping is out.
+ *
+ * rtt and loss are statistics. They get updated under the read lock with
+ * atomic loads and stores of whole values.
+ */
 typedef struct {
-	UCHAR id[SHA1_SIZE];
-	IP c_addr;
-	time_t time_ping;
-	time_t time_find;
-	int pinged;
-} UDP_NODE;
+	UCHAR id[NODE_SLOTS][SHA1_SIZE];
+	IP c_addr[NODE_SLOTS];
+	time_t time_ping[NODE_SLOTS];
+	time_t time_find[NODE_SLOTS];
+	UCHAR pinged[NODE_SLOTS];
+	UCHAR probed[NODE_SLOTS];
+	USHORT rtt[NODE_SLOTS];
+	UCHAR loss[NODE_SLOTS];
+	int size;
+} UDP_NODES;
 
-UDP_NODE *node_init(UCHAR * node_id, IP * sa);
-void node_free(UDP_NODE * n);
+void node_init(UDP_NODES * n, int i, UCHAR * node_id, IP * sa);
+void node_copy(UDP_NODES * to, int j, UDP_NODES * from, int i);
 
-void node_update(UDP_NODE * n, IP * sa);
+void node_update(UDP_NODES * n, int i, IP * sa);
 
 int node_me(UCHAR * node_id);
 int node_equal(const UCHAR * node_a, const UCHAR * node_b);
 
-int node_ok(UDP_NODE * n);
-int node_bad(UDP_NODE * n);
+int node_ok(UDP_NODES * n, int i);
+int node_bad(UDP_NODES * n, int i);
+
+void node_pinged(UDP_NODES * n, int i, int sent);
+void node_ponged(UDP_NODES * n, int i, IP * from);
 
-void node_pinged(UDP_NODE * n);
-void node_ponged(UDP_NODE * n, IP * from);
+void node_rtt(UDP_NODES * n, int i, LONG ms);
+void node_lost(UDP_NODES * n, int i);
+LONG node_cost(UDP_NODES * n, int i);
 
 #endif				/* NODE_UDP_H */
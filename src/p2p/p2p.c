@@ -36,6 +36,7 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include <limits.h>
 
 #include "p2p.h"
+#include "snapshot.h"
 
 P2P *p2p_init(void)
 {
@@ -46,13 +47,15 @@ P2P *p2p_init(void)
 	p2p->time_announce_host = 0;
 	p2p->time_restart = 0;
 	p2p->time_expire = 0;
+	p2p->time_transaction = 0;
 	p2p->time_cache = 0;
 	p2p->time_split = 0;
 	p2p->time_token = 0;
 	p2p->time_find = 0;
 	p2p->time_ping = 0;
 
-	gettimeofday(&p2p->time_now, NULL);
+	/* Give the routing table some time to grow before the first snapshot */
+	p2p->time_snapshot = time_now_sec() + 300;
 
 	return p2p;
 }
@@ -69,6 +72,11 @@ void p2p_bootstrap(void)
 		return;
 	}
 
+	/* Warm restart: Try the nodes of the last run first */
+	if (snap_bootstrap() > 0) {
+		return;
+	}
+
 	switch (_main->conf->bootstrap_mode) {
 	case BOOTSTRAP_LOCAL:
 	case BOOTSTRAP_HOST:
@@ -93,7 +101,7 @@ void p2p_bootstrap_this(const char *bootstrap_node, int bootstrap_port)
 	struct addrinfo *p = NULL;
 	int rc = 0;
 	int i = 0;
-	ITEM *ti = NULL;
+	TID *ti = NULL;
 	char port[6];
 
 	snprintf(port, 6, "%i", bootstrap_port);
@@ -113,15 +121,18 @@ void p2p_bootstrap_this(const char *bootstrap_node, int bootstrap_port)
 		return;
 	}
 
+	tdb_lock(tdb_self());
+
 	p = addrinfo;
 	while (p != NULL && i < P2P_MAX_BOOTSTRAP_NODES) {
 
 		/* Send PING to a bootstrap node */
 		if (strcmp(_main->conf->bootstrap_node, BOOTSTRAP_MCAST) == 0) {
 			ti = tdb_put(P2P_PING_MULTICAST);
-			send_ping((IP *) p->ai_addr, tdb_tid(ti));
 		} else {
 			ti = tdb_put(P2P_PING);
+		}
+		if (ti != NULL) {
 			send_ping((IP *) p->ai_addr, tdb_tid(ti));
 		}
 
@@ -129,83 +140,91 @@ void p2p_bootstrap_this(const char *bootstrap_node, int bootstrap_port)
 		i++;
 	}
 
+	tdb_unlock();
+
 	freeaddrinfo(addrinfo);
 }
 
 void p2p_cron(void)
 {
-	/* Tick Tock */
-	gettimeofday(&_main->p2p->time_now, NULL);
+	/* Expire the transaction rings. Once a second at most. */
+	if (time_now_sec() > _main->p2p->time_transaction) {
+		tdb_expire(time_now_sec());
+		_main->p2p->time_transaction = time_now_sec();
+	}
 
 	if (nbhd_is_empty()) {
 
 		/* Bootstrap PING */
-		if (_main->p2p->time_now.tv_sec > _main->p2p->time_restart) {
+		if (time_now_sec() > _main->p2p->time_restart) {
 			p2p_bootstrap();
 			time_add_1_min_approx(&_main->p2p->time_restart);
 		}
 
 	} else {
 
-		/* Create a new token every ~5 minutes */
-		if (_main->p2p->time_now.tv_sec > _main->p2p->time_token) {
-			tkn_put();
+		/* Change the token secret every ~5 minutes */
+		if (time_now_sec() > _main->p2p->time_token) {
+			tkn_rotate();
 			time_add_5_min_approx(&_main->p2p->time_token);
 		}
 
 		/* Expire objects. Run once a minute. */
-		if (_main->p2p->time_now.tv_sec > _main->p2p->time_expire) {
-			tdb_expire(_main->p2p->time_now.tv_sec);
-			nbhd_expire(_main->p2p->time_now.tv_sec);
-			val_expire(_main->p2p->time_now.tv_sec);
-			tkn_expire(_main->p2p->time_now.tv_sec);
-			cache_expire(_main->p2p->time_now.tv_sec);
+		if (time_now_sec() > _main->p2p->time_expire) {
+			val_expire(time_now_sec());
+			cache_expire(time_now_sec());
 			time_add_1_min_approx(&_main->p2p->time_expire);
 		}
 
 		/* Split buckets. Evolve neighbourhood. Run often to evolve
 		 * neighbourhood fast. */
-		if (_main->p2p->time_now.tv_sec > _main->p2p->time_split) {
-			nbhd_split(_main->conf->node_id, TRUE);
+		if (time_now_sec() > _main->p2p->time_split) {
+			nbhd_split(TRUE);
 			time_add_5_sec_approx(&_main->p2p->time_split);
 		}
 
 		/* Find nodes every ~5 minutes. */
-		if (_main->p2p->time_now.tv_sec > _main->p2p->time_find) {
+		if (time_now_sec() > _main->p2p->time_find) {
 			p2p_cron_find_myself();
 			time_add_5_sec_approx(&_main->p2p->time_find);
 		}
 
 		/* Find random node every ~5 minutes for maintainance reasons. */
-		if (_main->p2p->time_now.tv_sec > _main->p2p->time_maintainance) {
+		if (time_now_sec() > _main->p2p->time_maintainance) {
 			p2p_cron_find_random();
 			time_add_5_sec_approx(&_main->p2p->time_maintainance);
 		}
 
 		/* Announce my hostname every ~5 minutes. This includes a full search
 		 * to get the needed tokens first. */
-		if (_main->p2p->time_now.tv_sec >
+		if (time_now_sec() >
 		    _main->p2p->time_announce_host) {
 			p2p_cron_lookup_all();
 			time_add_5_sec_approx(&_main->p2p->time_announce_host);
 		}
 
 		/* Ping all nodes every ~5 minutes. */
-		if (_main->p2p->time_now.tv_sec > _main->p2p->time_ping) {
+		if (time_now_sec() > _main->p2p->time_ping) {
 			p2p_cron_ping();
 			time_add_5_sec_approx(&_main->p2p->time_ping);
 		}
 
 		/* Renew cached requests */
-		if (_main->p2p->time_now.tv_sec > _main->p2p->time_cache) {
-			cache_renew(_main->p2p->time_now.tv_sec);
+		if (time_now_sec() > _main->p2p->time_cache) {
+			cache_renew(time_now_sec());
 			time_add_5_sec_approx(&_main->p2p->time_cache);
 		}
+
+		/* Save the routing table every ~5 minutes */
+		if (time_now_sec() > _main->p2p->time_snapshot) {
+			snap_write();
+			time_add_5_min_approx(&_main->p2p->time_snapshot);
+		}
 	}
 
 	/* Try to register multicast address until it works. */
 	if (_main->udp->multicast == FALSE) {
-		if (_main->p2p->time_now.tv_sec > _main->p2p->time_multicast) {
+		if (time_now_sec() > _main->p2p->time_multicast) {
 			udp_multicast(_main->udp, multicast_enabled,
 				      multicast_start);
 			time_add_5_min_approx(&_main->p2p->time_multicast);
@@ -215,42 +234,62 @@ void p2p_cron(void)
 
 void p2p_cron_ping(void)
 {
-	ITEM *item_b = NULL;
+	ILIST due;
+	TIMER *timer = NULL;
 	BUCK *b = NULL;
-	ITEM *item_n = NULL;
-	UDP_NODE *n = NULL;
-	ITEM *ti = NULL;
-	unsigned long int j = 0;
-
-	/* Cycle through all the buckets */
-	item_b = list_start(_main->nbhd->bucket);
-	while (item_b != NULL) {
-		b = list_value(item_b);
-
-		/* Cycle through all the nodes */
-		j = 0;
-		item_n = list_start(b->nodes);
-		while (item_n != NULL) {
-			n = list_value(item_n);
-
-			/* It's time for pinging */
-			if (_main->p2p->time_now.tv_sec > n->time_ping) {
-
-				/* Ping the first 8 nodes. Ignore the rest. */
-				if (j < 8) {
-					ti = tdb_put(P2P_PING);
-					send_ping(&n->c_addr, tdb_tid(ti));
-					nbhd_pinged(n->id);
-				} else {
-					nbhd_pinged(n->id);
-				}
-			}
 
-			item_n = list_next(item_n);
+	tdb_lock(tdb_self());
+	nbhd_wrlock();
+
+	/* Only the buckets with nodes that are due */
+	ilist_init(&due);
+	wheel_expire(_main->nbhd->bucket->wheel, time_now_sec(),
+		     &due);
+	while ((timer = wheel_next(&due)) != NULL) {
+		b = wheel_value(timer, BUCK, timer);
+		p2p_cron_ping_bucket(b);
+		bckt_schedule(_main->nbhd->bucket, b);
+	}
+
+	nbhd_unlock();
+	tdb_unlock();
+}
+
+void p2p_cron_ping_bucket(BUCK * b)
+{
+	TID *ti = NULL;
+	int sent = FALSE;
+	int j = 0;
+
+	/* Cycle through all the nodes */
+	while (j < b->nodes.size) {
+
+		/* Not yet */
+		if (time_now_sec() <= b->nodes.time_ping[j]) {
 			j++;
+			continue;
 		}
 
-		item_b = list_next(item_b);
+		/* Bad node: No answer to the last 4 pings */
+		if (node_bad(&b->nodes, j)) {
+			nbhd_del(b, j);
+			continue;
+		}
+
+		/* Ping the first 8 nodes. Ignore the rest. */
+		sent = FALSE;
+		if (j < 8 && (ti = tdb_put(P2P_PING)) != NULL) {
+			send_ping(&b->nodes.c_addr[j], tdb_tid(ti));
+			sent = TRUE;
+		}
+		node_pinged(&b->nodes, j, sent);
+
+		/* Give a bad node a minute to answer before dropping it */
+		if (node_bad(&b->nodes, j)) {
+			time_add_1_min_approx(&b->nodes.time_ping[j]);
+		}
+
+		j++;
 	}
 }
 
@@ -268,71 +307,64 @@ void p2p_cron_find_random(void)
 
 void p2p_cron_find(UCHAR * target)
 {
-	ITEM *item_b = NULL;
 	BUCK *b = NULL;
-	ITEM *item_n = NULL;
-	UDP_NODE *n = NULL;
-	unsigned long int j = 0;
-	ITEM *ti = NULL;
+	int j = 0;
+	TID *ti = NULL;
+
+	tdb_lock(tdb_self());
+	nbhd_wrlock();
 
-	if ((item_b = bckt_find_any_match(_main->nbhd->bucket, target)) == NULL) {
+	if ((b = bckt_find_any_match(_main->nbhd->bucket, target)) == NULL) {
+		nbhd_unlock();
+		tdb_unlock();
 		return;
-	} else {
-		b = list_value(item_b);
 	}
 
-	j = 0;
-	item_n = list_start(b->nodes);
-	while (item_n != NULL && j < 8) {
-		n = list_value(item_n);
+	for (j = 0; j < b->nodes.size && j < 8; j++) {
 
-		if (_main->p2p->time_now.tv_sec > n->time_find) {
+		if (time_now_sec() > b->nodes.time_find[j]) {
 
-			ti = tdb_put(P2P_FIND_NODE);
-			send_find_node_request(&n->c_addr, target, tdb_tid(ti));
-			time_add_5_min_approx(&n->time_find);
+			if ((ti = tdb_put(P2P_FIND_NODE)) != NULL) {
+				send_find_node_request(&b->nodes.c_addr[j],
+						       target, tdb_tid(ti));
+			}
+			time_add_5_min_approx(&b->nodes.time_find[j]);
 		}
-
-		item_n = list_next(item_n);
-		j++;
 	}
+
+	nbhd_unlock();
+	tdb_unlock();
 }
 
-void p2p_cron_announce(ITEM * ti)
+void p2p_cron_announce(TID * ti)
 {
-	ITEM *item = NULL;
-	ITEM *t_new = NULL;
+	TID *t_new = NULL;
+	int i = 0;
 	int j = 0;
-	TID *tid = list_value(ti);
-	LOOKUP *l = tid->lookup;
+	LOOKUP *l = ti->lookup;
 	NODE_L *n = NULL;
 
-	info(_log, NULL, "Start announcing after querying %lu nodes",
-	     list_size(l->list));
+	info(_log, NULL, "Start announcing after a lookup of %i nodes",
+	     l->size);
 
-	item = list_start(l->list);
-	while (item != NULL && j < 8) {
-		n = list_value(item);
+	for (i = 0; i < l->size && j < 8; i++) {
+		n = &l->node[i];
 
-		if (n->token_size != 0) {
-			t_new = tdb_put(P2P_ANNOUNCE_ENGAGE);
-			send_announce_request(&n->c_addr, tdb_tid(t_new),
-					      l->target, n->token,
-					      n->token_size);
-			j++;
+		if (n->token_size == 0) {
+			continue;
 		}
 
-		item = list_next(item);
+		if ((t_new = tdb_put(P2P_ANNOUNCE_ENGAGE)) == NULL) {
+			return;
+		}
+		send_announce_request(&n->c_addr, tdb_tid(t_new), l->target,
+				      n->token, n->token_size);
+		j++;
 	}
 }
 
 void p2p_parse(UCHAR * bencode, size_t bensize, IP * from)
 {
-	/* Tick Tock */
-	mutex_block(_main->work->mutex);
-	gettimeofday(&_main->p2p->time_now, NULL);
-	mutex_unblock(_main->work->mutex);
-
 	/* UDP packet too small */
 	if (bensize < 1) {
 		info(_log, from, "Zero size packet from");
@@ -345,12 +377,6 @@ void p2p_parse(UCHAR * bencode, size_t bensize, IP * from)
 		return;
 	}
 
-	/* Validate bencode */
-	if (!ben_validate(bencode, bensize)) {
-		info(_log, from, "Received broken bencode from");
-		return;
-	}
-
 	/* Encrypted message or plaintext message */
 #ifdef POLARSSL
 	if (_main->conf->bool_encryption && !ip_is_localhost(from)) {
@@ -364,193 +390,129 @@ void p2p_parse(UCHAR * bencode, size_t bensize, IP * from)
 }
 
 #ifdef POLARSSL
-void p2p_decrypt(UCHAR * bencode, size_t bensize, IP * from)
+void p2p_decrypt(UCHAR * packet, size_t packetlen, IP * from)
 {
-	BEN *packet = NULL;
-	BEN *salt = NULL;
-	BEN *aes = NULL;
-	struct obj_str *plain = NULL;
-
-	/* Parse request */
-	packet = ben_dec(bencode, bensize);
-	if (!ben_is_dict(packet)) {
-		info(_log, from, "Decoding AES packet failed:");
-		ben_free(packet);
-		return;
-	}
+	UCHAR plain[AES_MSG_SIZE + 1];
+	int plainlen = 0;
 
-	/* Salt */
-	salt = ben_dict_search_str(packet, "s");
-	if (!ben_is_str(salt) || ben_str_i(salt) != AES_IV_SIZE) {
-		info(_log, from, "Salt missing or broken:");
-		ben_free(packet);
-		return;
-	}
-
-	/* Encrypted AES message */
-	aes = ben_dict_search_str(packet, "a");
-	if (!ben_is_str(aes) || ben_str_i(aes) <= 2) {
-		info(_log, from, "AES message missing or broken:");
-		ben_free(packet);
-		return;
-	}
-
-	/* Decrypt message */
-	plain = aes_decrypt(ben_str_s(aes), ben_str_i(aes),
-			    ben_str_s(salt),
-			    _main->conf->key, strlen(_main->conf->key));
-	if (plain == NULL) {
+	/* Decrypt and authenticate message */
+	plainlen = aes_decrypt(plain, packet, packetlen);
+	if (plainlen < 0) {
 		info(_log, from, "Decoding AES message failed:");
-		ben_free(packet);
 		return;
 	}
 
 	/* AES packet too small */
-	if (plain->i < SHA1_SIZE) {
-		ben_free(packet);
-		str_free(plain);
+	if (plainlen < SHA1_SIZE) {
 		info(_log, from, "AES packet contains less than 20 bytes:");
 		return;
 	}
-
-	/* Validate bencode */
-	if (!ben_validate(plain->s, plain->i)) {
-		ben_free(packet);
-		str_free(plain);
-		info(_log, from, "AES packet contains broken bencode:");
-		return;
-	}
+	plain[plainlen] = '\0';
 
 	/* Parse message */
-	p2p_decode(plain->s, plain->i, from);
-
-	/* Free */
-	ben_free(packet);
-	str_free(plain);
+	p2p_decode(plain, plainlen, from);
 }
 #endif
 
 void p2p_decode(UCHAR * bencode, size_t bensize, IP * from)
 {
-	BEN *packet = NULL;
-	BEN *y = NULL;
+	KRPC msg;
 
-	/* Parse request */
-	packet = ben_dec(bencode, bensize);
-	if (packet == NULL) {
-		info(_log, from, "Decoding UDP packet failed:");
-		return;
-	} else if (packet->t != BEN_DICT) {
-		info(_log, from, "UDP packet is not a dictionary:");
-		ben_free(packet);
+	/* Validate and parse the message in one pass */
+	if (!krpc_decode(&msg, bencode, bensize)) {
+		info(_log, from, "Received broken bencode from");
 		return;
 	}
 
 	/* Type of message */
-	y = ben_dict_search_str(packet, "y");
-	if (!ben_is_str(y) || ben_str_i(y) != 1) {
+	if (msg.y.s == NULL || msg.y.i != 1) {
 		info(_log, from, "Message type missing or broken:");
-		ben_free(packet);
 		return;
 	}
 
-	mutex_block(_main->work->mutex);
-
-	switch (*y->v.s->s) {
+	switch (*msg.y.s) {
 
 	case 'q':
-		p2p_request(packet, from);
+		p2p_request(&msg, from);
 		break;
 	case 'r':
-		p2p_reply(packet, from);
+		p2p_reply(&msg, from);
 		break;
 	case 'e':
-		p2p_error(packet, from);
+		p2p_error(&msg, from);
 		break;
 	default:
 		info(_log, from, "Drop invalid message type '%c' from",
-		     *y->v.s->s);
+		     *msg.y.s);
 	}
-
-	mutex_unblock(_main->work->mutex);
-
-	ben_free(packet);
 }
 
-void p2p_request(BEN * packet, IP * from)
+void p2p_request(KRPC * msg, IP * from)
 {
-	BEN *q = NULL;
-	BEN *a = NULL;
-	BEN *t = NULL;
-	BEN *id = NULL;
+	STR *q = &msg->q;
 
 	/* Query Type */
-	q = ben_dict_search_str(packet, "q");
-	if (!ben_is_str(q)) {
+	if (q->s == NULL) {
 		info(_log, from, "Query type missing or broken:");
 		return;
 	}
 
 	/* Argument */
-	a = ben_dict_search_str(packet, "a");
-	if (!ben_is_dict(a)) {
+	if (!msg->a) {
 		info(_log, from, "Argument missing or broken:");
 		return;
 	}
 
 	/* Node ID */
-	id = ben_dict_search_str(a, "id");
-	if (!p2p_is_hash(id)) {
+	if (!p2p_is_hash(&msg->id)) {
 		info(_log, from, "Node ID missing or broken:");
 		return;
 	}
 
 	/* Do not talk to myself */
-	if (p2p_packet_from_myself(ben_str_s(id))) {
+	if (p2p_packet_from_myself(msg->id.s)) {
 		return;
 	}
 
 	/* Transaction ID */
-	t = ben_dict_search_str(packet, "t");
-	if (!ben_is_str(t)) {
+	if (msg->t.s == NULL) {
 		info(_log, from, "Transaction ID missing or broken:");
 		return;
 	}
-	if (ben_str_i(t) > TID_SIZE_MAX) {
+	if (msg->t.i > TID_SIZE_MAX) {
 		info(_log, from, "Transaction ID too big:");
 		return;
 	}
 
 	/* Remember node. This does not update the IP address. */
-	nbhd_put(ben_str_s(id), from);
+	nbhd_put(msg->id.s, from);
 
 	/* PING */
-	if (ben_str_i(q) == 4 && memcmp(ben_str_s(q), "ping", 4) == 0) {
-		p2p_ping(t, from);
+	if (q->i == 4 && memcmp(q->s, "ping", 4) == 0) {
+		p2p_ping(&msg->t, from);
 		return;
 	}
 
 	/* FIND_NODE */
-	if (ben_str_i(q) == 9 && memcmp(ben_str_s(q), "find_node", 9) == 0) {
-		p2p_find_node_get_request(a, t, from);
+	if (q->i == 9 && memcmp(q->s, "find_node", 9) == 0) {
+		p2p_find_node_get_request(msg, from);
 		return;
 	}
 
 	/* GET_PEERS */
-	if (ben_str_i(q) == 9 && memcmp(ben_str_s(q), "get_peers", 9) == 0) {
-		p2p_get_peers_get_request(a, t, from);
+	if (q->i == 9 && memcmp(q->s, "get_peers", 9) == 0) {
+		p2p_get_peers_get_request(msg, from);
 		return;
 	}
 
 	/* ANNOUNCE */
-	if (ben_str_i(q) == 13
-	    && memcmp(ben_str_s(q), "announce_peer", 13) == 0) {
-		p2p_announce_get_request(a, ben_str_s(id), t, from);
+	if (q->i == 13 && memcmp(q->s, "announce_peer", 13) == 0) {
+		p2p_announce_get_request(msg, from);
 		return;
 	}
 
 	/* VOTE (utorrent?) */
-	if (ben_str_i(q) == 4 && memcmp(ben_str_s(q), "vote", 4) == 0) {
+	if (q->i == 4 && memcmp(q->s, "vote", 4) == 0) {
 		info(_log, from, "Drop RPC VOTE message from");
 		return;
 	}
@@ -558,66 +520,68 @@ void p2p_request(BEN * packet, IP * from)
 	info(_log, from, "Drop invalid query type from");
 }
 
-void p2p_reply(BEN * packet, IP * from)
+void p2p_reply(KRPC * msg, IP * from)
 {
-	BEN *r = NULL;
-	BEN *t = NULL;
-	BEN *id = NULL;
-	ITEM *ti = NULL;
+	UCHAR *id = msg->id.s;
+	TID *ti = NULL;
 
 	/* Argument */
-	r = ben_dict_search_str(packet, "r");
-	if (!ben_is_dict(r)) {
+	if (!msg->r) {
 		info(_log, from, "Argument missing or broken:");
 		return;
 	}
 
 	/* Node ID */
-	id = ben_dict_search_str(r, "id");
-	if (!p2p_is_hash(id)) {
+	if (!p2p_is_hash(&msg->id)) {
 		info(_log, from, "Node ID missing or broken:");
 		return;
 	}
 
 	/* Do not talk to myself */
-	if (p2p_packet_from_myself(ben_str_s(id))) {
+	if (p2p_packet_from_myself(id)) {
 		return;
 	}
 
 	/* Transaction ID */
-	t = ben_dict_search_str(packet, "t");
-	if (!ben_is_str(t)) {
+	if (msg->t.s == NULL) {
 		info(_log, from, "Missing transaction ID from");
 		return;
 	}
-	if (ben_str_i(t) != TID_SIZE) {
+	if (msg->t.i != TID_SIZE) {
 		info(_log, from, "Broken transaction ID from");
 		return;
 	}
 
 	/* Remember node. */
-	nbhd_put(ben_str_s(id), (IP *) from);
+	nbhd_put(id, (IP *) from);
 
-	ti = tdb_item(ben_str_s(t));
+	/* The TID tells which worker sent the query */
+	tdb_lock(tdb_shard(msg->t.s));
+
+	ti = tdb_item(msg->t.s);
+
+	/* Round trip time */
+	p2p_rtt(ti, id);
 
 	/* Get Query type by looking at the TDB */
 	switch (tdb_type(ti)) {
 	case P2P_PING:
 	case P2P_PING_MULTICAST:
-		p2p_pong(ben_str_s(id), from);
+		p2p_pong(id, from);
 		break;
 	case P2P_FIND_NODE:
-		p2p_find_node_get_reply(r, ben_str_s(id), from);
+		p2p_find_node_get_reply(msg, from);
 		break;
 	case P2P_GET_PEERS:
 	case P2P_ANNOUNCE_START:
-		p2p_get_peers_get_reply(r, ben_str_s(id), ti, from);
+		p2p_get_peers_get_reply(msg, ti, from);
 		break;
 	case P2P_ANNOUNCE_ENGAGE:
-		p2p_announce_get_reply(r, ben_str_s(id), ti, from);
+		p2p_announce_get_reply(msg, ti, from);
 		break;
 	default:
 		info(_log, from, "Invalid Transaction ID from");
+		tdb_unlock();
 		return;
 	}
 
@@ -630,59 +594,82 @@ void p2p_reply(BEN * packet, IP * from)
 	case P2P_ANNOUNCE_ENGAGE:
 		tdb_del(ti);
 		break;
+	case P2P_GET_PEERS:
+	case P2P_ANNOUNCE_START:
+		ldb_answer(tdb_ldb(ti), id);
+		p2p_lookup_step(ti);
+		break;
 	}
+
+	tdb_unlock();
 }
 
-void p2p_error(BEN * packet, IP * from)
+void p2p_rtt(TID * ti, UCHAR * id)
 {
-	BEN *e = NULL;
-	BEN *code = NULL;
-	BEN *msg = NULL;
-	ITEM *i = NULL;
+	LOOKUP *l = NULL;
+	NODE_L *n = NULL;
+	LONG sent = 0;
+	LONG ms = 0;
 
-#if 0
-	BEN *t = NULL;
-	/* Transaction ID */
-	t = ben_dict_search_str(packet, "t");
-	if (!ben_is_str(t)) {
-		info(_log, from, "Missing transaction ID from");
+	switch (tdb_type(ti)) {
+	case P2P_PING:
+	case P2P_FIND_NODE:
+	case P2P_ANNOUNCE_ENGAGE:
+		sent = ti->time_sent;
+		break;
+	case P2P_GET_PEERS:
+	case P2P_ANNOUNCE_START:
+		if ((l = tdb_ldb(ti)) == NULL) {
+			return;
+		}
+		if ((n = ldb_find(l, id)) == NULL) {
+			return;
+		}
+
+		/* Only the first answer counts */
+		sent = n->time_sent;
+		n->time_sent = 0;
+		break;
+	default:
+		/* A multicast PING gets many answers */
 		return;
 	}
-	if (ben_str_i(t) != TID_SIZE) {
-		info(_log, from, "Broken transaction ID from");
+
+	ms = time_now_ms() - sent;
+	if (sent == 0 || ms < 0) {
 		return;
 	}
-#endif
 
+	nbhd_rtt(id, ms);
+}
+
+void p2p_error(KRPC * msg, IP * from)
+{
 	/* The error */
-	e = ben_dict_search_str(packet, "e");
-	if (!ben_is_list(e)) {
+	if (!msg->e) {
 		info(_log, from, "Missing or broken error message from");
 		return;
 	}
 
 	/* Error code */
-	i = list_start(e->v.l);
-	code = list_value(i);
-	if (!ben_is_int(code)) {
+	if (!msg->e_code_found) {
 		info(_log, from, "Broken error code from");
 		return;
 	}
 
 	/* Error message */
-	i = list_stop(e->v.l);
-	msg = list_value(i);
-	if (!ben_is_str(msg)) {
+	if (msg->e_msg.s == NULL) {
 		info(_log, from, "Broken error message from");
 		return;
 	}
-	if (ben_str_i(msg) > 100) {
+	if (msg->e_msg.i > 100) {
 		info(_log, from, "Error message too big from");
 		return;
 	}
 
 	/* Notification */
-	info(_log, from, "ERROR %li: \"%s\" from", code->v.i, ben_str_s(msg));
+	info(_log, from, "ERROR %li: \"%.*s\" from", msg->e_code,
+	     (int)msg->e_msg.i, msg->e_msg.s);
 }
 
 int p2p_packet_from_myself(UCHAR * node_id)
@@ -705,9 +692,9 @@ int p2p_packet_from_myself(UCHAR * node_id)
 	return FALSE;
 }
 
-void p2p_ping(BEN * tid, IP * from)
+void p2p_ping(STR * tid, IP * from)
 {
-	send_pong(from, ben_str_s(tid), ben_str_i(tid));
+	send_pong(from, tid->s, tid->i);
 }
 
 void p2p_pong(UCHAR * node_id, IP * from)
@@ -715,57 +702,48 @@ void p2p_pong(UCHAR * node_id, IP * from)
 	nbhd_ponged(node_id, from);
 }
 
-void p2p_find_node_get_request(BEN * arg, BEN * tid, IP * from)
+void p2p_find_node_get_request(KRPC * msg, IP * from)
 {
-	BEN *target = NULL;
 	UCHAR nodes_compact_list[IP_SIZE_META_TRIPLE8];
 	int nodes_compact_size = 0;
 
 	/* Target */
-	target = ben_dict_search_str(arg, "target");
-	if (!p2p_is_hash(target)) {
+	if (!p2p_is_hash(&msg->target)) {
 		info(_log, NULL, "Missing or broken target");
 		return;
 	}
 
 	/* Create compact node list */
-	nodes_compact_size = bckt_compact_list(_main->nbhd->bucket,
-					       nodes_compact_list,
-					       ben_str_s(target));
+	nodes_compact_size = nbhd_compact_list(nodes_compact_list,
+					       msg->target.s);
 
 	/* Send reply */
 	if (nodes_compact_size > 0) {
 		send_find_node_reply(from, nodes_compact_list,
-				     nodes_compact_size, ben_str_s(tid),
-				     ben_str_i(tid));
+				     nodes_compact_size, msg->t.s, msg->t.i);
 	}
 }
 
-void p2p_find_node_get_reply(BEN * arg, UCHAR * node_id, IP * from)
+void p2p_find_node_get_reply(KRPC * msg, IP * from)
 {
-	BEN *nodes = NULL;
+	STR *nodes = &msg->nodes;
 	UCHAR *id = NULL;
 	UCHAR *p = NULL;
 	long int i = 0;
 	IP sin;
 
-#ifdef IPV6
-	nodes = ben_dict_search_str(arg, "nodes6");
-#elif IPV4
-	nodes = ben_dict_search_str(arg, "nodes");
-#endif
-	if (!ben_is_str(nodes)) {
+	if (nodes->s == NULL) {
 		info(_log, NULL, "nodes key missing");
 		return;
 	}
 
-	if (ben_str_i(nodes) % IP_SIZE_META_TRIPLE != 0) {
+	if (nodes->i % IP_SIZE_META_TRIPLE != 0) {
 		info(_log, NULL, "nodes key broken");
 		return;
 	}
 
-	p = ben_str_s(nodes);
-	for (i = 0; i < ben_str_i(nodes); i += IP_SIZE_META_TRIPLE) {
+	p = nodes->s;
+	for (i = 0; i < nodes->i; i += IP_SIZE_META_TRIPLE) {
 
 		/* ID */
 		id = p;
@@ -801,90 +779,63 @@ void p2p_find_node_get_reply(BEN * arg, UCHAR * node_id, IP * from)
 	}
 */
 
-void p2p_get_peers_get_request(BEN * arg, BEN * tid, IP * from)
+void p2p_get_peers_get_request(KRPC * msg, IP * from)
 {
-	BEN *info_hash = NULL;
 	UCHAR nodes_compact_list[IP_SIZE_META_TRIPLE8];
 	int nodes_compact_size = 0;
 
 	/* info_hash */
-	info_hash = ben_dict_search_str(arg, "info_hash");
-	if (!p2p_is_hash(info_hash)) {
+	if (!p2p_is_hash(&msg->info_hash)) {
 		info(_log, NULL, "Missing or broken info_hash");
 		return;
 	}
 
 	/* Look at the database */
 	nodes_compact_size = val_compact_list(nodes_compact_list,
-					      ben_str_s(info_hash));
+					      msg->info_hash.s);
 
 	/* Send values */
 	if (nodes_compact_size > 0) {
 		send_get_peers_values(from, nodes_compact_list,
-				      nodes_compact_size, ben_str_s(tid),
-				      ben_str_i(tid));
+				      nodes_compact_size, msg->t.s, msg->t.i);
 		return;
 	}
 
 	/* Look at the routing table */
-	nodes_compact_size = bckt_compact_list(_main->nbhd->bucket,
-					       nodes_compact_list,
-					       ben_str_s(info_hash));
+	nodes_compact_size = nbhd_compact_list(nodes_compact_list,
+					       msg->info_hash.s);
 
 	/* Send nodes */
 	if (nodes_compact_size > 0) {
 		send_get_peers_nodes(from, nodes_compact_list,
-				     nodes_compact_size, ben_str_s(tid),
-				     ben_str_i(tid));
+				     nodes_compact_size, msg->t.s, msg->t.i);
 	}
 }
 
-void p2p_get_peers_get_reply(BEN * arg, UCHAR * node_id, ITEM * ti, IP * from)
+void p2p_get_peers_get_reply(KRPC * msg, TID * ti, IP * from)
 {
-	BEN *token = NULL;
-	BEN *nodes = NULL;
-	BEN *values = NULL;
-
-	token = ben_dict_search_str(arg, "token");
-	if (!ben_is_str(token)) {
+	if (msg->token.s == NULL) {
 		info(_log, from, "Missing or broken token from");
 		return;
-	} else if (ben_str_i(token) > TOKEN_SIZE_MAX) {
+	} else if (msg->token.i > TOKEN_SIZE_MAX) {
 		info(_log, from, "Token key too big from");
 		return;
-	} else if (ben_str_i(token) <= 0) {
+	} else if (msg->token.i <= 0) {
 		info(_log, from, "Invalid token from");
 		return;
 	}
 
-	values = ben_dict_search_str(arg, "values");
-#ifdef IPV6
-	nodes = ben_dict_search_str(arg, "nodes6");
-#elif IPV4
-	nodes = ben_dict_search_str(arg, "nodes");
-#endif
-
-	if (values != NULL) {
-		if (!ben_is_list(values)) {
-			info(_log, NULL, "values key missing or broken");
-			return;
-		} else {
-			p2p_get_peers_get_values(values, node_id, ti, token,
-						 from);
-			return;
-		}
+	if (msg->values_found) {
+		p2p_get_peers_get_values(msg, ti, from);
+		return;
 	}
 
-	if (nodes != NULL) {
-		if (!ben_is_str(nodes)) {
-			info(_log, NULL, "nodes key missing");
-			return;
-		} else if (ben_str_i(nodes) % IP_SIZE_META_TRIPLE != 0) {
+	if (msg->nodes.s != NULL) {
+		if (msg->nodes.i % IP_SIZE_META_TRIPLE != 0) {
 			info(_log, NULL, "nodes key broken");
 			return;
 		} else {
-			p2p_get_peers_get_nodes(nodes, node_id, ti, token,
-						from);
+			p2p_get_peers_get_nodes(msg, ti, from);
 			return;
 		}
 	}
@@ -902,12 +853,10 @@ void p2p_get_peers_get_reply(BEN * arg, UCHAR * node_id, ITEM * ti, IP * from)
 	}
 */
 
-void p2p_get_peers_get_nodes(BEN * nodes, UCHAR * node_id, ITEM * ti,
-			     BEN * token, IP * from)
+void p2p_get_peers_get_nodes(KRPC * msg, TID * ti, IP * from)
 {
-
+	STR *nodes = &msg->nodes;
 	LOOKUP *l = tdb_ldb(ti);
-	UCHAR *target = NULL;
 	UCHAR *id = NULL;
 	UCHAR *p = NULL;
 	long int i = 0;
@@ -915,14 +864,12 @@ void p2p_get_peers_get_nodes(BEN * nodes, UCHAR * node_id, ITEM * ti,
 
 	if (l == NULL) {
 		return;
-	} else {
-		target = l->target;
 	}
 
-	ldb_update(l, node_id, token, from);
+	ldb_update(l, msg->id.s, msg->token.s, msg->token.i, from);
 
-	p = ben_str_s(nodes);
-	for (i = 0; i < ben_str_i(nodes); i += IP_SIZE_META_TRIPLE) {
+	p = nodes->s;
+	for (i = 0; i < nodes->i; i += IP_SIZE_META_TRIPLE) {
 
 		/* ID */
 		id = p;
@@ -943,19 +890,9 @@ void p2p_get_peers_get_nodes(BEN * nodes, UCHAR * node_id, ITEM * ti,
 
 		nbhd_put(id, &sin);
 
-		/* Node known. Do not send requests twice. Stop here. */
-		if (ldb_find(l, id) != NULL) {
-			continue;
-		}
-
-		/* Add this node to a sorted list. And only send a new lookup request
-		 * to this node if it gets inserted on top of the sorted list. */
-		if (ldb_put(l, id, (IP *) & sin) >= 8) {
-			continue;
-		}
-
-		/* Send a new lookup request. */
-		send_get_peers_request((IP *) & sin, target, tdb_tid(ti));
+		/* Add this node to the closest nodes unless it is known already.
+		 * p2p_lookup_step() queries the best fitting ones. */
+		ldb_put(l, id, (IP *) & sin);
 	}
 }
 
@@ -971,16 +908,13 @@ void p2p_get_peers_get_nodes(BEN * nodes, UCHAR * node_id, ITEM * ti,
 	}
 */
 
-void p2p_get_peers_get_values(BEN * values, UCHAR * node_id, ITEM * ti,
-			      BEN * token, IP * from)
+void p2p_get_peers_get_values(KRPC * msg, TID * ti, IP * from)
 {
-
 	UCHAR nodes_compact_list[IP_SIZE_META_PAIR8];
 	UCHAR *p = nodes_compact_list;
 	LOOKUP *l = tdb_ldb(ti);
 	int nodes_compact_size = 0;
-	BEN *val = NULL;
-	ITEM *item = NULL;
+	STR *val = NULL;
 	long int j = 0;
 	char hex[HEX_LEN];
 
@@ -988,24 +922,20 @@ void p2p_get_peers_get_values(BEN * values, UCHAR * node_id, ITEM * ti,
 		return;
 	}
 
-	ldb_update(l, node_id, token, from);
+	ldb_update(l, msg->id.s, msg->token.s, msg->token.i, from);
 
 	/* Extract values and create a nodes_compact_list */
-	item = list_start(values->v.l);
-	while (item != NULL && j < 8) {
-		val = list_value(item);
+	for (j = 0; j < msg->values_size; j++) {
+		val = &msg->values[j];
 
-		if (!ben_is_str(val) || ben_str_i(val) != IP_SIZE_META_PAIR) {
+		if (val->s == NULL || val->i != IP_SIZE_META_PAIR) {
 			info(_log, from, "Values list broken from ");
 			return;
 		}
 
-		memcpy(p, ben_str_s(val), ben_str_i(val));
+		memcpy(p, val->s, val->i);
 		nodes_compact_size += IP_SIZE_META_PAIR;
 		p += IP_SIZE_META_PAIR;
-
-		item = list_next(item);
-		j++;
 	}
 
 	if (nodes_compact_size <= 0) {
@@ -1058,48 +988,41 @@ void p2p_get_peers_get_values(BEN * values, UCHAR * node_id, ITEM * ti,
 }
 */
 
-void p2p_announce_get_request(BEN * arg, UCHAR * node_id, BEN * tid, IP * from)
+void p2p_announce_get_request(KRPC * msg, IP * from)
 {
-	BEN *info_hash = NULL;
-	BEN *token = NULL;
-	BEN *port = NULL;
-
 	/* info_hash */
-	info_hash = ben_dict_search_str(arg, "info_hash");
-	if (!p2p_is_hash(info_hash)) {
+	if (!p2p_is_hash(&msg->info_hash)) {
 		info(_log, from, "Missing or broken info_hash from");
 		return;
 	}
 
 	/* Token */
-	token = ben_dict_search_str(arg, "token");
-	if (!ben_is_str(token) || ben_str_i(token) > TOKEN_SIZE_MAX) {
+	if (msg->token.s == NULL || msg->token.i > TOKEN_SIZE_MAX) {
 		info(_log, from, "Missing or broken token from");
 		return;
 	}
 
-	if (!tkn_validate(ben_str_s(token))) {
+	if (msg->token.i != TOKEN_SIZE || !tkn_validate(msg->token.s, from)) {
 		info(_log, from, "Invalid token from");
 		return;
 	}
 
 	/* Port */
-	port = ben_dict_search_str(arg, "port");
-	if (!ben_is_int(port)) {
+	if (!msg->port_found) {
 		info(_log, from, "Missing or broken port from");
 		return;
 	}
 
-	if (port->v.i < 1 || port->v.i > 65535) {
+	if (msg->port < 1 || msg->port > 65535) {
 		info(_log, from, "Invalid port number from");
 		return;
 	}
 
 	/* Store info_hash */
-	val_put(ben_str_s(info_hash), node_id, port->v.i, from);
+	val_put(msg->info_hash.s, msg->id.s, msg->port, from);
 
 	/* Send success message */
-	send_announce_reply(from, ben_str_s(tid), ben_str_i(tid));
+	send_announce_reply(from, msg->t.s, msg->t.i);
 }
 
 /*
@@ -1112,7 +1035,7 @@ void p2p_announce_get_request(BEN * arg, UCHAR * node_id, BEN * tid, IP * from)
 	}
 */
 
-void p2p_announce_get_reply(BEN * arg, UCHAR * node_id, ITEM * ti, IP * from)
+void p2p_announce_get_reply(KRPC * msg, TID * ti, IP * from)
 {
 	/* Nothing to do */
 }
@@ -1125,7 +1048,7 @@ void p2p_cron_lookup_all(void)
 	while (i != NULL) {
 		identity = list_value(i);
 
-		if (_main->p2p->time_now.tv_sec > identity->time_announce_host) {
+		if (time_now_sec() > identity->time_announce_host) {
 			p2p_cron_lookup(identity->host_id, P2P_ANNOUNCE_START);
 			time_add_5_min_approx(&identity->time_announce_host);
 		}
@@ -1141,16 +1064,20 @@ void p2p_cron_lookup(UCHAR * target, int type)
 	LOOKUP *l = NULL;
 	UCHAR *p = NULL;
 	UCHAR *id = NULL;
-	ITEM *ti = NULL;
+	TID *ti = NULL;
 	int j = 0;
 	IP sin;
 
 	/* Start the incremental remote search program */
-	nodes_compact_size = bckt_compact_list(_main->nbhd->bucket,
-					       nodes_compact_list, target);
+	nodes_compact_size = nbhd_compact_list(nodes_compact_list, target);
+
+	tdb_lock(tdb_self());
 
 	/* Create tid and get the lookup table */
-	ti = tdb_put(type);
+	if ((ti = tdb_put(type)) == NULL) {
+		tdb_unlock();
+		return;
+	}
 	l = ldb_init(target, NULL, NULL);
 	tdb_link_ldb(ti, l);
 
@@ -1164,51 +1091,111 @@ void p2p_cron_lookup(UCHAR * target, int type)
 		/* IP + Port */
 		p = ip_tuple_to_sin(&sin, p);
 
-		/* Remember queried node */
+		/* Remember node */
 		ldb_put(l, id, &sin);
+	}
+
+	/* Query the closest nodes */
+	p2p_lookup_step(ti);
+
+	tdb_unlock();
+}
 
-		/* Query node */
-		send_get_peers_request(&sin, target, tdb_tid(ti));
+/*
+ * Iterative lookup: Keep LOOKUP_ALPHA queries in flight to the closest nodes
+ * not queried yet. Stop when the LOOKUP_K closest nodes have answered or
+ * timed out. The TID is gone afterwards.
+ */
+void p2p_lookup_step(TID * ti)
+{
+	LOOKUP *l = tdb_ldb(ti);
+	NODE_L *n = NULL;
+
+	while ((n = ldb_next(l)) != NULL) {
+		ldb_sent(l, n, time_now_ms(), p2p_lookup_timeout(n->id));
+		send_get_peers_request(&n->c_addr, l->target, tdb_tid(ti));
 	}
+
+	if (ldb_done(l)) {
+		p2p_lookup_finish(ti);
+		return;
+	}
+
+	/* Wake up at the next per hop timeout. The ring ends it after a
+	 * minute. */
+	tdb_arm(ti, ldb_deadline(l));
 }
 
-int p2p_is_hash(BEN * node)
+void p2p_lookup_expire(TID * ti)
 {
-	if (node == NULL) {
-		return 0;
+	LOOKUP *l = tdb_ldb(ti);
+	int i = 0;
+
+	if (status == GAMEOVER ||
+	    time_now_sec() > ti->time) {
+		p2p_lookup_finish(ti);
+		return;
 	}
-	if (!ben_is_str(node)) {
-		return 0;
+
+	/* A hop that timed out counts as a lost answer */
+	for (i = 0; i < l->size; i++) {
+		if (ldb_expired(&l->node[i], time_now_ms())) {
+			nbhd_lost(l->node[i].id);
+		}
 	}
-	if (ben_str_i(node) != SHA1_SIZE) {
-		return 0;
+	ldb_expire(l, time_now_ms());
+	p2p_lookup_step(ti);
+}
+
+void p2p_lookup_finish(TID * ti)
+{
+	LOOKUP *l = tdb_ldb(ti);
+	char hex[HEX_LEN];
+
+	switch (tdb_type(ti)) {
+	case P2P_ANNOUNCE_START:
+		p2p_cron_announce(ti);
+		break;
+	case P2P_GET_PEERS:
+		/* Tell the DNS client that there is nothing to be found */
+		if (l->send_response_to_initiator &&
+		    l->number_of_dns_responses == 0) {
+			hex_hash_encode(hex, l->target);
+			info(_log, NULL, "Nothing found for %s", hex);
+			r_failure(&l->c_addr, &l->msg);
+		}
+		break;
 	}
-	return 1;
+
+	tdb_del(ti);
 }
 
-int p2p_is_ip(BEN * node)
+/* 3 times the round trip time. Unknown nodes get the maximum. */
+LONG p2p_lookup_timeout(UCHAR * id)
 {
-	if (node == NULL) {
-		return 0;
+	LONG rtt = nbhd_rtt_get(id);
+
+	if (rtt == 0) {
+		return LOOKUP_TIMEOUT_MAX;
 	}
-	if (!ben_is_str(node)) {
-		return 0;
+
+	if (3 * rtt < LOOKUP_TIMEOUT_MIN) {
+		return LOOKUP_TIMEOUT_MIN;
 	}
-	if (ben_str_i(node) != IP_SIZE) {
-		return 0;
+
+	if (3 * rtt > LOOKUP_TIMEOUT_MAX) {
+		return LOOKUP_TIMEOUT_MAX;
 	}
-	return 1;
+
+	return 3 * rtt;
 }
 
-int p2p_is_port(BEN * node)
+int p2p_is_hash(STR * str)
 {
-	if (node == NULL) {
-		return 0;
-	}
-	if (!ben_is_str(node)) {
+	if (str->s == NULL) {
 		return 0;
 	}
-	if (ben_str_i(node) != 2) {
+	if (str->i != SHA1_SIZE) {
 		return 0;
 	}
 	return 1;
@@ -22,6 +22,7 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../shr/ip.h"
 #include "ben.h"
+#include "krpc.h"
 #include "token.h"
 #include "cache.h"
 #include "send_udp.h"
@@ -36,6 +37,9 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #define P2P_MAX_BOOTSTRAP_NODES 20
 
+struct obj_tid;
+struct obj_neighboorhood_bucket;
+
 #define P2P_TYPE_UNKNOWN 0
 #define P2P_PING 1
 #define P2P_PING_MULTICAST 2
@@ -45,17 +49,18 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #define P2P_ANNOUNCE_ENGAGE 6
 
 struct obj_p2p {
-	struct timeval time_now;
 	time_t time_maintainance;
 	time_t time_multicast;
 	time_t time_announce_host;
 	time_t time_restart;
 	time_t time_expire;
+	time_t time_transaction;
 	time_t time_cache;
 	time_t time_split;
 	time_t time_token;
 	time_t time_ping;
 	time_t time_find;
+	time_t time_snapshot;
 };
 typedef struct obj_p2p P2P;
 
@@ -67,43 +72,46 @@ void p2p_bootstrap_this(const char *bootstrap_node, int bootstrap_port);
 
 void p2p_cron(void);
 void p2p_cron_ping(void);
+void p2p_cron_ping_bucket(struct obj_neighboorhood_bucket *b);
 void p2p_cron_find_myself(void);
 void p2p_cron_find_random(void);
 void p2p_cron_find(UCHAR * target);
-void p2p_cron_announce(ITEM * ti);
+void p2p_cron_announce(struct obj_tid *ti);
 void p2p_cron_lookup_all(void);
 void p2p_cron_lookup(UCHAR * target, int type);
 
+void p2p_lookup_step(struct obj_tid *ti);
+void p2p_lookup_expire(struct obj_tid *ti);
+void p2p_lookup_finish(struct obj_tid *ti);
+LONG p2p_lookup_timeout(UCHAR * id);
+
 void p2p_parse(UCHAR * bencode, size_t bensize, IP * from);
 #ifdef POLARSSL
-void p2p_decrypt(UCHAR * bencode, size_t bensize, IP * from);
+void p2p_decrypt(UCHAR * packet, size_t packetlen, IP * from);
 #endif
 void p2p_decode(UCHAR * bencode, size_t bensize, IP * from);
 
-void p2p_request(BEN * packet, IP * from);
-void p2p_reply(BEN * packet, IP * from);
-void p2p_error(BEN * packet, IP * from);
+void p2p_request(KRPC * msg, IP * from);
+void p2p_reply(KRPC * msg, IP * from);
+void p2p_error(KRPC * msg, IP * from);
+void p2p_rtt(struct obj_tid *ti, UCHAR * id);
 
-void p2p_ping(BEN * tid, IP * from);
+void p2p_ping(STR * tid, IP * from);
 void p2p_pong(UCHAR * node_id, IP * from);
 
-void p2p_find_node_get_request(BEN * arg, BEN * tid, IP * from);
-void p2p_find_node_get_reply(BEN * arg, UCHAR * node_id, IP * from);
+void p2p_find_node_get_request(KRPC * msg, IP * from);
+void p2p_find_node_get_reply(KRPC * msg, IP * from);
 
-void p2p_get_peers_get_request(BEN * arg, BEN * tid, IP * from);
-void p2p_get_peers_get_reply(BEN * arg, UCHAR * node_id, ITEM * ti, IP * from);
-void p2p_get_peers_get_nodes(BEN * nodes, UCHAR * node_id, ITEM * ti,
-			     BEN * token, IP * from);
-void p2p_get_peers_get_values(BEN * values, UCHAR * node_id, ITEM * ti,
-			      BEN * token, IP * from);
+void p2p_get_peers_get_request(KRPC * msg, IP * from);
+void p2p_get_peers_get_reply(KRPC * msg, struct obj_tid *ti, IP * from);
+void p2p_get_peers_get_nodes(KRPC * msg, struct obj_tid *ti, IP * from);
+void p2p_get_peers_get_values(KRPC * msg, struct obj_tid *ti, IP * from);
 
-void p2p_announce_get_request(BEN * arg, UCHAR * node_id, BEN * tid, IP * from);
-void p2p_announce_get_reply(BEN * arg, UCHAR * node_id, ITEM * ti, IP * from);
+void p2p_announce_get_request(KRPC * msg, IP * from);
+void p2p_announce_get_reply(KRPC * msg, struct obj_tid *ti, IP * from);
 
 int p2p_packet_from_myself(UCHAR * node_id);
 
-int p2p_is_hash(BEN * node);
-int p2p_is_ip(BEN * node);
-int p2p_is_port(BEN * node);
+int p2p_is_hash(STR * str);
 
 #endif
@@ -196,16 +196,20 @@ void r_lookup_remote(UCHAR * target, int type, IP * from, DNS_MSG * msg)
 	LOOKUP *l = NULL;
 	UCHAR *p = NULL;
 	UCHAR *id = NULL;
-	ITEM *ti = NULL;
+	TID *ti = NULL;
 	int j = 0;
 	IP sin;
 
 	/* Start the incremental remote search program */
-	nodes_compact_size = bckt_compact_list(_main->nbhd->bucket,
-					       nodes_compact_list, target);
+	nodes_compact_size = nbhd_compact_list(nodes_compact_list, target);
+
+	tdb_lock(tdb_self());
 
 	/* Create tid and get the lookup table */
-	ti = tdb_put(type);
+	if ((ti = tdb_put(type)) == NULL) {
+		tdb_unlock();
+		return;
+	}
 	l = ldb_init(target, from, msg);
 	tdb_link_ldb(ti, l);
 
@@ -219,12 +223,14 @@ void r_lookup_remote(UCHAR * target, int type, IP * from, DNS_MSG * msg)
 		/* IP + Port */
 		p = ip_tuple_to_sin(&sin, p);
 
-		/* Remember queried node */
+		/* Remember node */
 		ldb_put(l, id, &sin);
-
-		/* Query node */
-		send_get_peers_request(&sin, target, tdb_tid(ti));
 	}
+
+	/* Query the closest nodes */
+	p2p_lookup_step(ti);
+
+	tdb_unlock();
 }
 
 void r_success(IP * from, DNS_MSG * msg, UCHAR * nodes_compact_list,
@@ -32,6 +32,30 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "send_udp.h"
 
+/*
+ * The leading "d1:ad2:id20:<node id>" of every query and the leading
+ * "d1:rd2:id20:<node id>" of every reply never change. Lay them out once.
+ * Keys are written in sorted order as bencode demands.
+ */
+struct obj_send *send_init(void)
+{
+	struct obj_send *send =
+	    (struct obj_send *)myalloc(sizeof(struct obj_send));
+
+	memcpy(send->query, "d1:ad2:id20:", 12);
+	memcpy(send->query + 12, _main->conf->node_id, SHA1_SIZE);
+
+	memcpy(send->reply, "d1:rd2:id20:", 12);
+	memcpy(send->reply + 12, _main->conf->node_id, SHA1_SIZE);
+
+	return send;
+}
+
+void send_free(void)
+{
+	myfree(_main->send);
+}
+
 /*
 	{
 	"t": "aa",
@@ -45,57 +69,15 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 void send_ping(IP * sa, UCHAR * tid)
 {
-	BEN *dict = ben_init(BEN_DICT);
-	BEN *key = NULL;
-	BEN *val = NULL;
-	RAW *raw = NULL;
-	BEN *arg = ben_init(BEN_DICT);
-
-	/* Node ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "id", 2);
-	ben_str(val, _main->conf->node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Argument */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "a", 1);
-	ben_dict(dict, key, arg);
-
-	/* Query type */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "q", 1);
-	ben_str(val, (UCHAR *) "ping", 4);
-	ben_dict(dict, key, val);
-
-	/* Transaction ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "t", 1);
-	ben_str(val, tid, TID_SIZE);
-	ben_dict(dict, key, val);
-
-	/* Type of message */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "y", 1);
-	ben_str(val, (UCHAR *) "q", 1);
-	ben_dict(dict, key, val);
-
-	raw = ben_enc(dict);
-#ifdef POLARSSL
-	if (_main->conf->bool_encryption) {
-		send_aes(sa, raw);
-	} else {
-		send_udp(sa, raw);
-	}
-#else
-	send_udp(sa, raw);
-#endif
-	raw_free(raw);
-	ben_free(dict);
+	UCHAR buf[BUF_SIZE];
+	UCHAR *p = buf;
+
+	p = send_put(p, _main->send->query, SEND_HEAD_SIZE);
+	p = send_put_lit(p, "e1:q4:ping1:t");
+	p = send_put_str(p, tid, TID_SIZE);
+	p = send_put_lit(p, "1:y1:qe");
+
+	send_krpc(sa, buf, p - buf);
 
 	info(_log, sa, "PING");
 }
@@ -112,50 +94,15 @@ void send_ping(IP * sa, UCHAR * tid)
 
 void send_pong(IP * sa, UCHAR * tid, int tid_size)
 {
-	BEN *dict = ben_init(BEN_DICT);
-	BEN *key = NULL;
-	BEN *val = NULL;
-	RAW *raw = NULL;
-	BEN *arg = ben_init(BEN_DICT);
-
-	/* Node ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "id", 2);
-	ben_str(val, _main->conf->node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Argument */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "r", 1);
-	ben_dict(dict, key, arg);
-
-	/* Transaction ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "t", 1);
-	ben_str(val, tid, tid_size);
-	ben_dict(dict, key, val);
-
-	/* Type of message */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "y", 1);
-	ben_str(val, (UCHAR *) "r", 1);
-	ben_dict(dict, key, val);
-
-	raw = ben_enc(dict);
-#ifdef POLARSSL
-	if (_main->conf->bool_encryption) {
-		send_aes(sa, raw);
-	} else {
-		send_udp(sa, raw);
-	}
-#else
-	send_udp(sa, raw);
-#endif
-	raw_free(raw);
-	ben_free(dict);
+	UCHAR buf[BUF_SIZE];
+	UCHAR *p = buf;
+
+	p = send_put(p, _main->send->reply, SEND_HEAD_SIZE);
+	p = send_put_lit(p, "e1:t");
+	p = send_put_str(p, tid, tid_size);
+	p = send_put_lit(p, "1:y1:re");
+
+	send_krpc(sa, buf, p - buf);
 
 	info(_log, sa, "PONG");
 }
@@ -174,65 +121,18 @@ void send_pong(IP * sa, UCHAR * tid, int tid_size)
 
 void send_find_node_request(IP * sa, UCHAR * node_id, UCHAR * tid)
 {
-	BEN *dict = ben_init(BEN_DICT);
-	BEN *key = NULL;
-	BEN *val = NULL;
-	RAW *raw = NULL;
-	BEN *arg = ben_init(BEN_DICT);
+	UCHAR buf[BUF_SIZE];
+	UCHAR *p = buf;
 	char hexbuf[HEX_LEN];
 
-	/* Node ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "id", 2);
-	ben_str(val, _main->conf->node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Target */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "target", 6);
-	ben_str(val, node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Argument */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "a", 1);
-	ben_dict(dict, key, arg);
-
-	/* Query type */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "q", 1);
-	ben_str(val, (UCHAR *) "find_node", 9);
-	ben_dict(dict, key, val);
-
-	/* Transaction ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "t", 1);
-	ben_str(val, tid, TID_SIZE);
-	ben_dict(dict, key, val);
-
-	/* Type of message */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "y", 1);
-	ben_str(val, (UCHAR *) "q", 1);
-	ben_dict(dict, key, val);
-
-	raw = ben_enc(dict);
-#ifdef POLARSSL
-	if (_main->conf->bool_encryption) {
-		send_aes(sa, raw);
-	} else {
-		send_udp(sa, raw);
-	}
-#else
-	send_udp(sa, raw);
-#endif
-	raw_free(raw);
-	ben_free(dict);
+	p = send_put(p, _main->send->query, SEND_HEAD_SIZE);
+	p = send_put_lit(p, "6:target20:");
+	p = send_put(p, node_id, SHA1_SIZE);
+	p = send_put_lit(p, "e1:q9:find_node1:t");
+	p = send_put_str(p, tid, TID_SIZE);
+	p = send_put_lit(p, "1:y1:qe");
+
+	send_krpc(sa, buf, p - buf);
 
 	hex_hash_encode(hexbuf, node_id);
 	info(_log, sa, "FIND_NODE %s at", hexbuf);
@@ -252,62 +152,17 @@ void send_find_node_request(IP * sa, UCHAR * node_id, UCHAR * tid)
 void send_find_node_reply(IP * sa, UCHAR * nodes_compact_list,
 			  int nodes_compact_size, UCHAR * tid, int tid_size)
 {
+	UCHAR buf[BUF_SIZE];
+	UCHAR *p = buf;
 
-	BEN *dict = ben_init(BEN_DICT);
-	BEN *key = NULL;
-	BEN *val = NULL;
-	RAW *raw = NULL;
-	BEN *arg = ben_init(BEN_DICT);
-
-	/* Node ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "id", 2);
-	ben_str(val, _main->conf->node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Nodes */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-#ifdef IPV6
-	ben_str(key, (UCHAR *) "nodes6", 6);
-#elif IPV4
-	ben_str(key, (UCHAR *) "nodes", 5);
-#endif
-	ben_str(val, nodes_compact_list, nodes_compact_size);
-	ben_dict(arg, key, val);
-
-	/* Argument */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "r", 1);
-	ben_dict(dict, key, arg);
-
-	/* Transaction ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "t", 1);
-	ben_str(val, tid, tid_size);
-	ben_dict(dict, key, val);
-
-	/* Type of message */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "y", 1);
-	ben_str(val, (UCHAR *) "r", 1);
-	ben_dict(dict, key, val);
-
-	raw = ben_enc(dict);
-#ifdef POLARSSL
-	if (_main->conf->bool_encryption) {
-		send_aes(sa, raw);
-	} else {
-		send_udp(sa, raw);
-	}
-#else
-	send_udp(sa, raw);
-#endif
-	raw_free(raw);
-	ben_free(dict);
+	p = send_put(p, _main->send->reply, SEND_HEAD_SIZE);
+	p = send_put_lit(p, SEND_NODES);
+	p = send_put_str(p, nodes_compact_list, nodes_compact_size);
+	p = send_put_lit(p, "e1:t");
+	p = send_put_str(p, tid, tid_size);
+	p = send_put_lit(p, "1:y1:re");
+
+	send_krpc(sa, buf, p - buf);
 
 	info(_log, sa, "NODES_FN to");
 }
@@ -326,65 +181,18 @@ void send_find_node_reply(IP * sa, UCHAR * nodes_compact_list,
 
 void send_get_peers_request(IP * sa, UCHAR * node_id, UCHAR * tid)
 {
-	BEN *dict = ben_init(BEN_DICT);
-	BEN *key = NULL;
-	BEN *val = NULL;
-	RAW *raw = NULL;
-	BEN *arg = ben_init(BEN_DICT);
+	UCHAR buf[BUF_SIZE];
+	UCHAR *p = buf;
 	char hexbuf[HEX_LEN];
 
-	/* Node ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "id", 2);
-	ben_str(val, _main->conf->node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* info_hash */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "info_hash", 9);
-	ben_str(val, node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Argument */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "a", 1);
-	ben_dict(dict, key, arg);
-
-	/* Query type */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "q", 1);
-	ben_str(val, (UCHAR *) "get_peers", 9);
-	ben_dict(dict, key, val);
-
-	/* Transaction ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "t", 1);
-	ben_str(val, tid, TID_SIZE);
-	ben_dict(dict, key, val);
-
-	/* Type of message */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "y", 1);
-	ben_str(val, (UCHAR *) "q", 1);
-	ben_dict(dict, key, val);
-
-	raw = ben_enc(dict);
-#ifdef POLARSSL
-	if (_main->conf->bool_encryption) {
-		send_aes(sa, raw);
-	} else {
-		send_udp(sa, raw);
-	}
-#else
-	send_udp(sa, raw);
-#endif
-	raw_free(raw);
-	ben_free(dict);
+	p = send_put(p, _main->send->query, SEND_HEAD_SIZE);
+	p = send_put_lit(p, "9:info_hash20:");
+	p = send_put(p, node_id, SHA1_SIZE);
+	p = send_put_lit(p, "e1:q9:get_peers1:t");
+	p = send_put_str(p, tid, TID_SIZE);
+	p = send_put_lit(p, "1:y1:qe");
+
+	send_krpc(sa, buf, p - buf);
 
 	hex_hash_encode(hexbuf, node_id);
 	info(_log, sa, "GET_PEERS %s at", hexbuf);
@@ -405,72 +213,22 @@ void send_get_peers_request(IP * sa, UCHAR * node_id, UCHAR * tid)
 void send_get_peers_nodes(IP * sa, UCHAR * nodes_compact_list,
 			  int nodes_compact_size, UCHAR * tid, int tid_size)
 {
+	UCHAR token[TOKEN_SIZE];
+	UCHAR buf[BUF_SIZE];
+	UCHAR *p = buf;
 
-	BEN *dict = NULL;
-	BEN *key = NULL;
-	BEN *val = NULL;
-	RAW *raw = NULL;
-	BEN *arg = NULL;
-
-	dict = ben_init(BEN_DICT);
-	arg = ben_init(BEN_DICT);
-
-	/* Node ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "id", 2);
-	ben_str(val, _main->conf->node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Nodes */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-#ifdef IPV6
-	ben_str(key, (UCHAR *) "nodes6", 6);
-#elif IPV4
-	ben_str(key, (UCHAR *) "nodes", 5);
-#endif
-	ben_str(val, nodes_compact_list, nodes_compact_size);
-	ben_dict(arg, key, val);
-
-	/* Token */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "token", 5);
-	ben_str(val, tkn_read(), TOKEN_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Argument */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "r", 1);
-	ben_dict(dict, key, arg);
-
-	/* Transaction ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "t", 1);
-	ben_str(val, tid, tid_size);
-	ben_dict(dict, key, val);
-
-	/* Type of message */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "y", 1);
-	ben_str(val, (UCHAR *) "r", 1);
-	ben_dict(dict, key, val);
-
-	raw = ben_enc(dict);
-#ifdef POLARSSL
-	if (_main->conf->bool_encryption) {
-		send_aes(sa, raw);
-	} else {
-		send_udp(sa, raw);
-	}
-#else
-	send_udp(sa, raw);
-#endif
-	raw_free(raw);
-	ben_free(dict);
+	tkn_read(token, sa);
+
+	p = send_put(p, _main->send->reply, SEND_HEAD_SIZE);
+	p = send_put_lit(p, SEND_NODES);
+	p = send_put_str(p, nodes_compact_list, nodes_compact_size);
+	p = send_put_lit(p, "5:token");
+	p = send_put_str(p, token, TOKEN_SIZE);
+	p = send_put_lit(p, "e1:t");
+	p = send_put_str(p, tid, tid_size);
+	p = send_put_lit(p, "1:y1:re");
+
+	send_krpc(sa, buf, p - buf);
 
 	info(_log, sa, "NODES_GP to");
 }
@@ -490,77 +248,29 @@ void send_get_peers_nodes(IP * sa, UCHAR * nodes_compact_list,
 void send_get_peers_values(IP * sa, UCHAR * nodes_compact_list,
 			   int nodes_compact_size, UCHAR * tid, int tid_size)
 {
-	BEN *dict = NULL;
-	BEN *list = NULL;
-	BEN *arg = NULL;
-	BEN *key = NULL;
-	BEN *val = NULL;
-	RAW *raw = NULL;
-	UCHAR *p = nodes_compact_list;
+	UCHAR token[TOKEN_SIZE];
+	UCHAR buf[BUF_SIZE];
+	UCHAR *p = buf;
+	UCHAR *v = nodes_compact_list;
 	int j = 0;
 
-	dict = ben_init(BEN_DICT);
-	list = ben_init(BEN_LIST);
-	arg = ben_init(BEN_DICT);
+	tkn_read(token, sa);
+
+	p = send_put(p, _main->send->reply, SEND_HEAD_SIZE);
+	p = send_put_lit(p, "5:token");
+	p = send_put_str(p, token, TOKEN_SIZE);
 
 	/* Values list */
+	p = send_put_lit(p, "6:valuesl");
 	for (j = 0; j < nodes_compact_size; j += IP_SIZE_META_PAIR) {
-		val = ben_init(BEN_STR);
-		ben_str(val, p, IP_SIZE_META_PAIR);
-		ben_list(list, val);
-		p += IP_SIZE_META_PAIR;
+		p = send_put_str(p, v, IP_SIZE_META_PAIR);
+		v += IP_SIZE_META_PAIR;
 	}
+	p = send_put_lit(p, "ee1:t");
+	p = send_put_str(p, tid, tid_size);
+	p = send_put_lit(p, "1:y1:re");
 
-	/* Node ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "id", 2);
-	ben_str(val, _main->conf->node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Token */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "token", 5);
-	ben_str(val, tkn_read(), TOKEN_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Values */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "values", 6);
-	ben_dict(arg, key, list);
-
-	/* Argument */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "r", 1);
-	ben_dict(dict, key, arg);
-
-	/* Transaction ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "t", 1);
-	ben_str(val, tid, tid_size);
-	ben_dict(dict, key, val);
-
-	/* Type of message */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "y", 1);
-	ben_str(val, (UCHAR *) "r", 1);
-	ben_dict(dict, key, val);
-
-	raw = ben_enc(dict);
-#ifdef POLARSSL
-	if (_main->conf->bool_encryption) {
-		send_aes(sa, raw);
-	} else {
-		send_udp(sa, raw);
-	}
-#else
-	send_udp(sa, raw);
-#endif
-	raw_free(raw);
-	ben_free(dict);
+	send_krpc(sa, buf, p - buf);
 
 	info(_log, sa, "VALUES_GP to");
 }
@@ -582,79 +292,21 @@ void send_get_peers_values(IP * sa, UCHAR * nodes_compact_list,
 void send_announce_request(IP * sa, UCHAR * tid, UCHAR * target,
 			   UCHAR * token, int token_size)
 {
-
-	BEN *dict = ben_init(BEN_DICT);
-	BEN *key = NULL;
-	BEN *val = NULL;
-	RAW *raw = NULL;
-	BEN *arg = ben_init(BEN_DICT);
-
-	/* Node ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "id", 2);
-	ben_str(val, _main->conf->node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* My host ID ot my group ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "info_hash", 9);
-	ben_str(val, target, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Port */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_INT);
-	ben_str(key, (UCHAR *) "port", 4);
-	ben_int(val, _main->conf->announce_port);
-	ben_dict(arg, key, val);
-
-	/* Token */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "token", 5);
-	ben_str(val, token, token_size);
-	ben_dict(arg, key, val);
-
-	/* Argument */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "a", 1);
-	ben_dict(dict, key, arg);
-
-	/* Query type */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "q", 1);
-	ben_str(val, (UCHAR *) "announce_peer", 13);
-	ben_dict(dict, key, val);
-
-	/* Transaction ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "t", 1);
-	ben_str(val, tid, TID_SIZE);
-	ben_dict(dict, key, val);
-
-	/* Type of message */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "y", 1);
-	ben_str(val, (UCHAR *) "q", 1);
-	ben_dict(dict, key, val);
-
-	raw = ben_enc(dict);
-#ifdef POLARSSL
-	if (_main->conf->bool_encryption) {
-		send_aes(sa, raw);
-	} else {
-		send_udp(sa, raw);
-	}
-#else
-	send_udp(sa, raw);
-#endif
-	raw_free(raw);
-	ben_free(dict);
+	UCHAR buf[BUF_SIZE];
+	UCHAR *p = buf;
+
+	p = send_put(p, _main->send->query, SEND_HEAD_SIZE);
+	p = send_put_lit(p, "9:info_hash20:");
+	p = send_put(p, target, SHA1_SIZE);
+	p = send_put_lit(p, "4:port");
+	p = send_put_int(p, _main->conf->announce_port);
+	p = send_put_lit(p, "5:token");
+	p = send_put_str(p, token, token_size);
+	p = send_put_lit(p, "e1:q13:announce_peer1:t");
+	p = send_put_str(p, tid, TID_SIZE);
+	p = send_put_lit(p, "1:y1:qe");
+
+	send_krpc(sa, buf, p - buf);
 
 	info(_log, sa, "ANNOUNCE_PEER to");
 }
@@ -671,111 +323,109 @@ void send_announce_request(IP * sa, UCHAR * tid, UCHAR * target,
 
 void send_announce_reply(IP * sa, UCHAR * tid, int tid_size)
 {
-	BEN *dict = ben_init(BEN_DICT);
-	BEN *key = NULL;
-	BEN *val = NULL;
-	RAW *raw = NULL;
-	BEN *arg = ben_init(BEN_DICT);
-
-	/* Node ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "id", 2);
-	ben_str(val, _main->conf->node_id, SHA1_SIZE);
-	ben_dict(arg, key, val);
-
-	/* Argument */
-	key = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "r", 1);
-	ben_dict(dict, key, arg);
-
-	/* Transaction ID */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "t", 1);
-	ben_str(val, tid, tid_size);
-	ben_dict(dict, key, val);
-
-	/* Type of message */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "y", 1);
-	ben_str(val, (UCHAR *) "r", 1);
-	ben_dict(dict, key, val);
-
-	raw = ben_enc(dict);
+	UCHAR buf[BUF_SIZE];
+	UCHAR *p = buf;
+
+	p = send_put(p, _main->send->reply, SEND_HEAD_SIZE);
+	p = send_put_lit(p, "e1:t");
+	p = send_put_str(p, tid, tid_size);
+	p = send_put_lit(p, "1:y1:re");
+
+	send_krpc(sa, buf, p - buf);
+
+	info(_log, sa, "ANNOUNCE SUCCESS to");
+}
+
+/*
+ * The callers bound every variable part: TID_SIZE_MAX, TOKEN_SIZE_MAX,
+ * IP_SIZE_META_TRIPLE8 for nodes and IP_SIZE_META_PAIR8 for values. The
+ * largest message stays far below BUF_SIZE.
+ */
+UCHAR *send_put(UCHAR * p, const void *mem, LONG size)
+{
+	memcpy(p, mem, size);
+	return p + size;
+}
+
+UCHAR *send_put_dec(UCHAR * p, LONG i)
+{
+	UCHAR digits[20];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + i % 10;
+		i /= 10;
+	} while (i > 0);
+
+	while (n > 0) {
+		*p++ = digits[--n];
+	}
+
+	return p;
+}
+
+UCHAR *send_put_str(UCHAR * p, UCHAR * mem, LONG size)
+{
+	p = send_put_dec(p, size);
+	*p++ = ':';
+	return send_put(p, mem, size);
+}
+
+UCHAR *send_put_int(UCHAR * p, LONG i)
+{
+	*p++ = 'i';
+	p = send_put_dec(p, i);
+	*p++ = 'e';
+	return p;
+}
+
+void send_krpc(IP * sa, UCHAR * buf, LONG size)
+{
+	RAW raw;
+
+	raw.code = buf;
+	raw.size = size;
+	raw.p = buf + size;
+
 #ifdef POLARSSL
 	if (_main->conf->bool_encryption) {
-		send_aes(sa, raw);
+		send_aes(sa, &raw);
 	} else {
-		send_udp(sa, raw);
+		send_udp(sa, &raw);
 	}
 #else
-	send_udp(sa, raw);
+	send_udp(sa, &raw);
 #endif
-	raw_free(raw);
-	ben_free(dict);
-
-	info(_log, sa, "ANNOUNCE SUCCESS to");
 }
 
 #ifdef POLARSSL
 void send_aes(IP * sa, RAW * raw)
 {
-	BEN *dict = ben_init(BEN_DICT);
-	BEN *key = NULL;
-	BEN *val = NULL;
-	struct obj_str *aes = NULL;
-	RAW *enc = NULL;
-	UCHAR salt[AES_IV_SIZE];
-
-	/*
-	   1:a[es] XX:LENGTH
-	   1:s[alt] 32:SALT
-	 */
-
-	/* Create random salt */
-	rand_urandom(salt, AES_IV_SIZE);
-
-	/* Encrypt message */
-	aes = aes_encrypt(raw->code, raw->size, salt,
-			  _main->conf->key, strlen(_main->conf->key));
-	if (aes == NULL) {
+	UCHAR packet[AES_PACKET_SIZE];
+	RAW enc;
+	int size = 0;
+
+	/* Version, nonce, ciphertext and tag. No bencode around it. */
+	size = aes_encrypt(packet, raw->code, raw->size);
+	if (size < 0) {
 		info(_log, NULL, "Encoding AES message failed");
-		ben_free(dict);
 		return;
 	}
 
-	/* AES */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "a", 1);
-	ben_str(val, aes->s, aes->i);
-	ben_dict(dict, key, val);
-
-	/* Salt */
-	key = ben_init(BEN_STR);
-	val = ben_init(BEN_STR);
-	ben_str(key, (UCHAR *) "s", 1);
-	ben_str(val, salt, AES_IV_SIZE);
-	ben_dict(dict, key, val);
-
-	enc = ben_enc(dict);
-	send_udp(sa, enc);
-	raw_free(enc);
-	ben_free(dict);
-	str_free(aes);
+	enc.code = packet;
+	enc.size = size;
+	enc.p = packet + size;
+	send_udp(sa, &enc);
 }
 #endif
 
 void send_udp(IP * sa, RAW * raw)
 {
-	socklen_t addrlen = sizeof(IP);
+	UDP *udp = udp_own();
 
-	if (_main->udp->sockfd < 0) {
+	if (udp->sockfd < 0) {
 		return;
 	}
 
-	sendto(_main->udp->sockfd, raw->code, raw->size, 0,
-	       (const struct sockaddr *)sa, addrlen);
+	udp_send(udp->sockfd, sa, raw->code, raw->size);
 }
@@ -27,6 +27,25 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include "hex.h"
 #include "p2p.h"
 
+/* "d1:ad2:id20:" and the node id */
+#define SEND_HEAD_SIZE (12 + SHA1_SIZE)
+
+#ifdef IPV6
+#define SEND_NODES "6:nodes6"
+#elif IPV4
+#define SEND_NODES "5:nodes"
+#endif
+
+#define send_put_lit(p, s) send_put(p, s, sizeof(s) - 1)
+
+struct obj_send {
+	UCHAR query[SEND_HEAD_SIZE];
+	UCHAR reply[SEND_HEAD_SIZE];
+};
+
+struct obj_send *send_init(void);
+void send_free(void);
+
 void send_ping(IP * sa, UCHAR * tid);
 void send_pong(IP * sa, UCHAR * tid, int tid_size);
 
@@ -46,6 +65,12 @@ void send_announce_reply(IP * sa, UCHAR * tid, int tid_size);
 
 void send_ip(IP * sa, UCHAR * tid, int tid_size);
 
+UCHAR *send_put(UCHAR * p, const void *mem, LONG size);
+UCHAR *send_put_dec(UCHAR * p, LONG i);
+UCHAR *send_put_str(UCHAR * p, UCHAR * mem, LONG size);
+UCHAR *send_put_int(UCHAR * p, LONG i);
+void send_krpc(IP * sa, UCHAR * buf, LONG size);
+
 #ifdef POLARSSL
 void send_aes(IP * sa, RAW * raw);
 #endif
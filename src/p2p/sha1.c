@@ -17,24 +17,383 @@ You should have received a copy of the GNU General Public License
 along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+
 #ifdef POLARSSL
 #include <polarssl/sha1.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 #include "sha1.h"
 
-#ifdef POLARSSL
+/* Set once by sha1_init() before any thread starts */
+static int sha1_type = SHA1_PORTABLE;
+
+void sha1_init(void)
+{
+	sha1_type = sha1_cpu();
+}
+
+const char *sha1_backend(void)
+{
+	switch (sha1_type) {
+	case SHA1_X86:
+		return "SHA-NI";
+	}
+	return "Portable";
+}
+
 void sha1_hash(UCHAR * hash, const char *buffer, long int bytes)
 {
-	memset(hash, '\0', SHA1_SIZE);
-	sha1((const UCHAR *)buffer, bytes, hash);
+	sha1_digest(hash, NULL, buffer, bytes);
+}
+
+/* Two messages at a time. Their rounds do not depend on each other. */
+void sha1_hash_many(UCHAR ** hash, const char **buffer, long int *bytes,
+		    int n)
+{
+	SHA1_MSG a;
+	SHA1_MSG b;
+	long int k = 0;
+	int i = 0;
+
+	if (sha1_type == SHA1_PORTABLE) {
+		for (i = 0; i < n; i++) {
+			sha1_hash(hash[i], buffer[i], bytes[i]);
+		}
+		return;
+	}
+
+	for (i = 0; i + 1 < n; i += 2) {
+		sha1_msg_init(&a, (const UCHAR *)buffer[i], bytes[i], 0);
+		sha1_msg_init(&b, (const UCHAR *)buffer[i + 1], bytes[i + 1],
+			      0);
+
+		for (k = 0; k < a.blocks && k < b.blocks; k++) {
+			sha1_blocks_x2(a.state, sha1_msg_block(&a, k),
+				       b.state, sha1_msg_block(&b, k));
+		}
+		for (; k < a.blocks; k++) {
+			sha1_blocks(a.state, sha1_msg_block(&a, k), 1);
+		}
+		for (; k < b.blocks; k++) {
+			sha1_blocks(b.state, sha1_msg_block(&b, k), 1);
+		}
+
+		sha1_msg_final(&a, hash[i]);
+		sha1_msg_final(&b, hash[i + 1]);
+	}
+
+	if (i < n) {
+		sha1_hash(hash[i], buffer[i], bytes[i]);
+	}
+}
+
+/* RFC 2104. The key must not be longer than SHA1_BLOCK_SIZE. */
+void sha1_hmac_hash(UCHAR * hash, UCHAR * key, long int key_size,
+		    const char *buffer, long int bytes)
+{
+	UCHAR pad[SHA1_BLOCK_SIZE];
+	int i = 0;
+
+	memset(pad, '\0', SHA1_BLOCK_SIZE);
+	memcpy(pad, key, key_size);
+	for (i = 0; i < SHA1_BLOCK_SIZE; i++) {
+		pad[i] ^= 0x36;
+	}
+
+	sha1_digest(hash, pad, buffer, bytes);
+
+	/* 0x36 ^ 0x5c */
+	for (i = 0; i < SHA1_BLOCK_SIZE; i++) {
+		pad[i] ^= 0x6a;
+	}
+
+	sha1_digest(hash, pad, (const char *)hash, SHA1_SIZE);
+}
+
+/* SHA1 over an optional first block (head) followed by the buffer */
+void sha1_digest(UCHAR * hash, const UCHAR * head, const char *buffer,
+		 long int bytes)
+{
+	SHA1_MSG m;
+
+	if (sha1_type == SHA1_PORTABLE) {
+		sha1_digest_portable(hash, head, buffer, bytes);
+		return;
+	}
+
+	sha1_msg_init(&m, (const UCHAR *)buffer, bytes,
+		      (head != NULL) ? SHA1_BLOCK_SIZE : 0);
+	if (head != NULL) {
+		sha1_blocks(m.state, head, 1);
+	}
+	sha1_blocks(m.state, m.data, m.full);
+	sha1_blocks(m.state, m.tail, m.blocks - m.full);
+	sha1_msg_final(&m, hash);
+}
+
+#ifdef POLARSSL
+void sha1_digest_portable(UCHAR * hash, const UCHAR * head,
+			  const char *buffer, long int bytes)
+{
+	sha1_context c;
+
+	sha1_starts(&c);
+	if (head != NULL) {
+		sha1_update(&c, head, SHA1_BLOCK_SIZE);
+	}
+	sha1_update(&c, (const UCHAR *)buffer, bytes);
+	sha1_finish(&c, hash);
 }
 #else
-void sha1_hash(UCHAR * hash, const char *buffer, long int bytes)
+void sha1_digest_portable(UCHAR * hash, const UCHAR * head,
+			  const char *buffer, long int bytes)
 {
 	blk_SHA_CTX c;
+
 	blk_SHA1_Init(&c);
+	if (head != NULL) {
+		blk_SHA1_Update(&c, head, SHA1_BLOCK_SIZE);
+	}
 	blk_SHA1_Update(&c, buffer, bytes);
 	blk_SHA1_Final(hash, &c);
 }
 #endif
+
+/*
+ * The full blocks get hashed in place. The rest goes into the tail together
+ * with the padding and the length in bits. The offset counts the bytes that
+ * got hashed before the buffer.
+ */
+void sha1_msg_init(SHA1_MSG * m, const UCHAR * buffer, long int bytes,
+		   long int offset)
+{
+	unsigned long long bits = (unsigned long long)(bytes + offset) << 3;
+	long int rest = bytes % SHA1_BLOCK_SIZE;
+	UCHAR *p = NULL;
+	int j = 0;
+
+	m->state[0] = 0x67452301;
+	m->state[1] = 0xefcdab89;
+	m->state[2] = 0x98badcfe;
+	m->state[3] = 0x10325476;
+	m->state[4] = 0xc3d2e1f0;
+
+	m->data = buffer;
+	m->full = bytes / SHA1_BLOCK_SIZE;
+	m->blocks = m->full + ((rest < SHA1_BLOCK_SIZE - 8) ? 1 : 2);
+
+	memset(m->tail, '\0', 2 * SHA1_BLOCK_SIZE);
+	memcpy(m->tail, buffer + m->full * SHA1_BLOCK_SIZE, rest);
+	m->tail[rest] = 0x80;
+
+	p = m->tail + (m->blocks - m->full) * SHA1_BLOCK_SIZE - 8;
+	for (j = 7; j >= 0; j--) {
+		*p++ = (bits >> (8 * j)) & 0xFF;
+	}
+}
+
+const UCHAR *sha1_msg_block(SHA1_MSG * m, long int k)
+{
+	if (k < m->full) {
+		return m->data + k * SHA1_BLOCK_SIZE;
+	}
+	return m->tail + (k - m->full) * SHA1_BLOCK_SIZE;
+}
+
+void sha1_msg_final(SHA1_MSG * m, UCHAR * hash)
+{
+	int j = 0;
+
+	for (j = 0; j < 5; j++) {
+		hash[4 * j + 0] = (m->state[j] >> 24) & 0xFF;
+		hash[4 * j + 1] = (m->state[j] >> 16) & 0xFF;
+		hash[4 * j + 2] = (m->state[j] >> 8) & 0xFF;
+		hash[4 * j + 3] = m->state[j] & 0xFF;
+	}
+}
+
+void sha1_blocks(UINT * state, const UCHAR * data, long int blocks)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	sha1_x86_blocks(state, data, blocks);
+#endif
+}
+
+void sha1_blocks_x2(UINT * s1, const UCHAR * d1, UINT * s2, const UCHAR * d2)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	sha1_x86_x2(s1, d1, s2, d2);
+#endif
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#ifndef bit_SHA
+#define bit_SHA (1 << 29)
+#endif
+
+int sha1_cpu(void)
+{
+	unsigned int a = 0, b = 0, c = 0, d = 0;
+
+	if (!__get_cpuid(1, &a, &b, &c, &d)) {
+		return SHA1_PORTABLE;
+	}
+	if (!(c & bit_SSSE3) || !(c & bit_SSE4_1)) {
+		return SHA1_PORTABLE;
+	}
+	if (__get_cpuid_max(0, NULL) < 7) {
+		return SHA1_PORTABLE;
+	}
+	__cpuid_count(7, 0, a, b, c, d);
+
+	return (b & bit_SHA) ? SHA1_X86 : SHA1_PORTABLE;
+}
+
+/*
+ * SHA-NI does 4 rounds per instruction. The macros work on lane l of the
+ * register arrays, so two blocks can be interleaved round by round. The
+ * state is stored as ABCD in one register and E in the top of another.
+ */
+#define NI_LOAD(l) \
+	abcd[l] = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)st[l]), 0x1B); \
+	e0[l] = _mm_set_epi32(st[l][4], 0, 0, 0); \
+	m0[l] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(d[l] + 0)), mask); \
+	m1[l] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(d[l] + 16)), mask); \
+	m2[l] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(d[l] + 32)), mask); \
+	m3[l] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(d[l] + 48)), mask);
+
+#define NI_STORE(l) \
+	e0[l] = _mm_sha1nexte_epu32(e0[l], _mm_set_epi32(st[l][4], 0, 0, 0)); \
+	abcd[l] = _mm_add_epi32(abcd[l], _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)st[l]), 0x1B)); \
+	_mm_storeu_si128((__m128i *)st[l], _mm_shuffle_epi32(abcd[l], 0x1B)); \
+	st[l][4] = _mm_extract_epi32(e0[l], 3);
+
+#define NI_R0(l) \
+	e0[l] = _mm_add_epi32(e0[l], m0[l]); \
+	e1[l] = abcd[l]; \
+	abcd[l] = _mm_sha1rnds4_epu32(abcd[l], e0[l], 0);
+
+#define NI_R1(l) \
+	e1[l] = _mm_sha1nexte_epu32(e1[l], m1[l]); \
+	e0[l] = abcd[l]; \
+	abcd[l] = _mm_sha1rnds4_epu32(abcd[l], e1[l], 0); \
+	m0[l] = _mm_sha1msg1_epu32(m0[l], m1[l]);
+
+#define NI_R2(l) \
+	e0[l] = _mm_sha1nexte_epu32(e0[l], m2[l]); \
+	e1[l] = abcd[l]; \
+	abcd[l] = _mm_sha1rnds4_epu32(abcd[l], e0[l], 0); \
+	m1[l] = _mm_sha1msg1_epu32(m1[l], m2[l]); \
+	m0[l] = _mm_xor_si128(m0[l], m2[l]);
+
+#define NI_R(l, ea, eb, w0, w1, w2, w3, f) \
+	ea[l] = _mm_sha1nexte_epu32(ea[l], w0[l]); \
+	eb[l] = abcd[l]; \
+	w1[l] = _mm_sha1msg2_epu32(w1[l], w0[l]); \
+	abcd[l] = _mm_sha1rnds4_epu32(abcd[l], ea[l], f); \
+	w3[l] = _mm_sha1msg1_epu32(w3[l], w0[l]); \
+	w2[l] = _mm_xor_si128(w2[l], w0[l]);
+
+#define NI_R17(l) \
+	e1[l] = _mm_sha1nexte_epu32(e1[l], m1[l]); \
+	e0[l] = abcd[l]; \
+	m2[l] = _mm_sha1msg2_epu32(m2[l], m1[l]); \
+	abcd[l] = _mm_sha1rnds4_epu32(abcd[l], e1[l], 3); \
+	m3[l] = _mm_xor_si128(m3[l], m1[l]);
+
+#define NI_R18(l) \
+	e0[l] = _mm_sha1nexte_epu32(e0[l], m2[l]); \
+	e1[l] = abcd[l]; \
+	m3[l] = _mm_sha1msg2_epu32(m3[l], m2[l]); \
+	abcd[l] = _mm_sha1rnds4_epu32(abcd[l], e0[l], 3);
+
+#define NI_R19(l) \
+	e1[l] = _mm_sha1nexte_epu32(e1[l], m3[l]); \
+	e0[l] = abcd[l]; \
+	abcd[l] = _mm_sha1rnds4_epu32(abcd[l], e1[l], 3);
+
+#define NI_R3(l) NI_R(l, e1, e0, m3, m0, m1, m2, 0)
+#define NI_R4(l) NI_R(l, e0, e1, m0, m1, m2, m3, 0)
+#define NI_R5(l) NI_R(l, e1, e0, m1, m2, m3, m0, 1)
+#define NI_R6(l) NI_R(l, e0, e1, m2, m3, m0, m1, 1)
+#define NI_R7(l) NI_R(l, e1, e0, m3, m0, m1, m2, 1)
+#define NI_R8(l) NI_R(l, e0, e1, m0, m1, m2, m3, 1)
+#define NI_R9(l) NI_R(l, e1, e0, m1, m2, m3, m0, 1)
+#define NI_R10(l) NI_R(l, e0, e1, m2, m3, m0, m1, 2)
+#define NI_R11(l) NI_R(l, e1, e0, m3, m0, m1, m2, 2)
+#define NI_R12(l) NI_R(l, e0, e1, m0, m1, m2, m3, 2)
+#define NI_R13(l) NI_R(l, e1, e0, m1, m2, m3, m0, 2)
+#define NI_R14(l) NI_R(l, e0, e1, m2, m3, m0, m1, 2)
+#define NI_R15(l) NI_R(l, e1, e0, m3, m0, m1, m2, 3)
+#define NI_R16(l) NI_R(l, e0, e1, m0, m1, m2, m3, 3)
+
+/* EACH() repeats a step for every lane */
+#define NI_BLOCK(EACH) \
+	EACH(NI_LOAD) \
+	EACH(NI_R0) \
+	EACH(NI_R1) \
+	EACH(NI_R2) \
+	EACH(NI_R3) \
+	EACH(NI_R4) \
+	EACH(NI_R5) \
+	EACH(NI_R6) \
+	EACH(NI_R7) \
+	EACH(NI_R8) \
+	EACH(NI_R9) \
+	EACH(NI_R10) \
+	EACH(NI_R11) \
+	EACH(NI_R12) \
+	EACH(NI_R13) \
+	EACH(NI_R14) \
+	EACH(NI_R15) \
+	EACH(NI_R16) \
+	EACH(NI_R17) \
+	EACH(NI_R18) \
+	EACH(NI_R19) \
+	EACH(NI_STORE)
+
+#define NI_ONE(STEP) STEP(0)
+#define NI_TWO(STEP) STEP(0) STEP(1)
+
+__attribute__ ((target("sha,ssse3,sse4.1")))
+void sha1_x86_blocks(UINT * state, const UCHAR * data, long int blocks)
+{
+	const __m128i mask =
+	    _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd[1], e0[1], e1[1], m0[1], m1[1], m2[1], m3[1];
+	UINT *st[1] = { state };
+	const UCHAR *d[1] = { data };
+
+	while (blocks-- > 0) {
+		NI_BLOCK(NI_ONE)
+		d[0] += SHA1_BLOCK_SIZE;
+	}
+}
+
+__attribute__ ((target("sha,ssse3,sse4.1")))
+void sha1_x86_x2(UINT * s1, const UCHAR * d1, UINT * s2, const UCHAR * d2)
+{
+	const __m128i mask =
+	    _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+	__m128i abcd[2], e0[2], e1[2], m0[2], m1[2], m2[2], m3[2];
+	UINT *st[2] = { s1, s2 };
+	const UCHAR *d[2] = { d1, d2 };
+
+	NI_BLOCK(NI_TWO)
+}
+
+#else
+
+int sha1_cpu(void)
+{
+	return SHA1_PORTABLE;
+}
+
+#endif
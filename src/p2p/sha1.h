@@ -24,7 +24,52 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include "../ext/sha1-linus.h"
 
 #define SHA1_SIZE 20
+#define SHA1_BLOCK_SIZE 64
+
+/*
+ * The SHA1 instructions of the CPU get used if there are any: SHA-NI on x86.
+ * sha1_init() looks for them once. Until then and on every other CPU, the
+ * portable code does the job.
+ */
+#define SHA1_PORTABLE 0
+#define SHA1_X86 1
+
+/* A message split into its full blocks and the padded tail */
+struct obj_sha1_msg {
+	UINT state[5];
+	const UCHAR *data;
+	long int full;
+	long int blocks;
+	UCHAR tail[2 * SHA1_BLOCK_SIZE];
+};
+typedef struct obj_sha1_msg SHA1_MSG;
+
+void sha1_init(void);
+const char *sha1_backend(void);
 
 void sha1_hash(UCHAR * hash, const char *buffer, long int bytes);
+void sha1_hash_many(UCHAR ** hash, const char **buffer, long int *bytes,
+		    int n);
+void sha1_hmac_hash(UCHAR * hash, UCHAR * key, long int key_size,
+		    const char *buffer, long int bytes);
+
+void sha1_msg_init(SHA1_MSG * m, const UCHAR * buffer, long int bytes,
+		   long int offset);
+const UCHAR *sha1_msg_block(SHA1_MSG * m, long int k);
+void sha1_msg_final(SHA1_MSG * m, UCHAR * hash);
+
+void sha1_digest(UCHAR * hash, const UCHAR * head, const char *buffer,
+		 long int bytes);
+void sha1_digest_portable(UCHAR * hash, const UCHAR * head,
+			  const char *buffer, long int bytes);
+
+void sha1_blocks(UINT * state, const UCHAR * data, long int blocks);
+void sha1_blocks_x2(UINT * s1, const UCHAR * d1, UINT * s2, const UCHAR * d2);
+int sha1_cpu(void);
+
+#if defined(__x86_64__) || defined(__i386__)
+void sha1_x86_blocks(UINT * state, const UCHAR * data, long int blocks);
+void sha1_x86_x2(UINT * s1, const UCHAR * d1, UINT * s2, const UCHAR * d2);
+#endif
 
 #endif
@@ -0,0 +1,416 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+
+#include "snapshot.h"
+
+SNAP *snap_init(void)
+{
+	SNAP *snap = (SNAP *) myalloc(sizeof(SNAP));
+	const char *filename = _main->conf->snapshot;
+	UCHAR *id = NULL;
+	ITEM *i = NULL;
+	ID *h = NULL;
+	size_t size = 0;
+
+	snap->mutex = mutex_init();
+
+	if (_main->conf->bool_snapshot == FALSE) {
+		return snap;
+	}
+
+	/* No snapshot yet */
+	if ((size = file_size(filename)) == 0) {
+		return snap;
+	}
+
+	if (size < SNAP_SIZE_HEADER || size > SNAP_SIZE_MAX) {
+		info(_log, NULL, "Snapshot %s: Bad size", filename);
+		return snap;
+	}
+
+	if ((snap->buffer = (UCHAR *) file_load(filename, 0, size)) == NULL) {
+		info(_log, NULL, "Snapshot %s: Loading failed", filename);
+		return snap;
+	}
+
+	if (memcmp(snap->buffer, SNAP_MAGIC, SNAP_MAGIC_SIZE) != 0) {
+		info(_log, NULL, "Snapshot %s: Unknown format", filename);
+		myfree(snap->buffer);
+		snap->buffer = NULL;
+		return snap;
+	}
+	snap->buffer_size = size;
+
+	/* The nodes out there know me by my old node id. Keep it unless -n
+	 * says otherwise. */
+	if (_main->conf->bool_node_id == TRUE) {
+		return snap;
+	}
+
+	id = snap->buffer + SNAP_MAGIC_SIZE;
+	i = list_start(_main->identity);
+	while (i != NULL) {
+		h = list_value(i);
+		if (memcmp(h->host_id, id, SHA1_SIZE) == 0) {
+			return snap;
+		}
+		i = list_next(i);
+	}
+	memcpy(_main->conf->node_id, id, SHA1_SIZE);
+
+	return snap;
+}
+
+void snap_free(void)
+{
+	myfree(_main->snap->buffer);
+	myfree(_main->snap->nodes);
+	mutex_destroy(_main->snap->mutex);
+	myfree(_main->snap);
+}
+
+void snap_restore(void)
+{
+	SNAP *snap = _main->snap;
+	UCHAR *p = snap->buffer;
+	UCHAR *end = snap->buffer + snap->buffer_size;
+	time_t age = 0;
+	int size = 0;
+
+	if (snap->buffer == NULL) {
+		return;
+	}
+
+	/* Time passed since the snapshot */
+	age = time(NULL) - snap_get64(p + SNAP_MAGIC_SIZE + SHA1_SIZE);
+	if (age < 0) {
+		age = 0;
+	}
+
+	snap->nodes = (UCHAR *) myalloc(SNAP_NODES_MAX * IP_SIZE_META_TRIPLE);
+
+	p += SNAP_SIZE_HEADER;
+	while (p < end) {
+		if ((size = snap_restore_record(p, end, age)) == 0) {
+			info(_log, NULL, "Snapshot %s: Broken record",
+			     _main->conf->snapshot);
+			break;
+		}
+		p += size;
+	}
+
+	info(_log, NULL, "Snapshot %s: %i nodes, %li seconds old",
+	     _main->conf->snapshot, snap->nodes_size, age);
+
+	myfree(snap->buffer);
+	snap->buffer = NULL;
+	snap->buffer_size = 0;
+}
+
+int snap_restore_record(UCHAR * p, UCHAR * end, time_t age)
+{
+	SNAP *snap = _main->snap;
+	time_t ttl = 0;
+
+	switch (*p) {
+	case SNAP_NODE:
+		if (end - p < SNAP_SIZE_NODE) {
+			return 0;
+		}
+		if (snap->nodes_size < SNAP_NODES_MAX) {
+			memcpy(snap->nodes +
+			       snap->nodes_size * IP_SIZE_META_TRIPLE, p + 1,
+			       IP_SIZE_META_TRIPLE);
+			snap->nodes_size++;
+		}
+		return SNAP_SIZE_NODE;
+
+	case SNAP_VALUE:
+		if (end - p < SNAP_SIZE_VALUE) {
+			return 0;
+		}
+		ttl = snap_get32(p + 1 + 2 * SHA1_SIZE + IP_SIZE_META_PAIR);
+		if (ttl > age) {
+			val_restore(p + 1, p + 1 + SHA1_SIZE,
+				    p + 1 + 2 * SHA1_SIZE,
+				    time_now_sec() + ttl - age);
+		}
+		return SNAP_SIZE_VALUE;
+
+	case SNAP_CACHE:
+		if (end - p < SNAP_SIZE_CACHE) {
+			return 0;
+		}
+		ttl = snap_get32(p + 1 + SHA1_SIZE + IP_SIZE_META_PAIR);
+		if (ttl > age) {
+			cache_restore(p + 1, p + 1 + SHA1_SIZE,
+				      time_now_sec() + ttl - age);
+		}
+		return SNAP_SIZE_CACHE;
+	}
+
+	return 0;
+}
+
+int snap_bootstrap(void)
+{
+	SNAP *snap = _main->snap;
+	TID *ti = NULL;
+	IP sin;
+	int size = 0;
+	int j = 0;
+
+	mutex_block(snap->mutex);
+
+	/* Ping all saved nodes at once. Only the first time. */
+	if (snap->nodes_size > 0) {
+		tdb_lock(tdb_self());
+		for (j = 0; j < snap->nodes_size; j++) {
+			ip_tuple_to_sin(&sin, snap->nodes +
+					j * IP_SIZE_META_TRIPLE + SHA1_SIZE);
+			if ((ti = tdb_put(P2P_PING)) != NULL) {
+				send_ping(&sin, tdb_tid(ti));
+			}
+		}
+		tdb_unlock();
+
+		info(_log, NULL, "Snapshot: Pinged %i nodes", snap->nodes_size);
+	}
+
+	size = snap->nodes_size;
+	myfree(snap->nodes);
+	snap->nodes = NULL;
+	snap->nodes_size = 0;
+
+	mutex_unblock(snap->mutex);
+
+	return size;
+}
+
+void snap_write(void)
+{
+	char filename[BUF_SIZE + 4];
+	UCHAR *buffer = NULL;
+	UCHAR *p = NULL;
+	UCHAR *nodes = NULL;
+
+	if (_main->conf->bool_snapshot == FALSE) {
+		return;
+	}
+
+	buffer = (UCHAR *) myalloc(SNAP_SIZE_MAX);
+	p = buffer;
+
+	memcpy(p, SNAP_MAGIC, SNAP_MAGIC_SIZE);
+	p += SNAP_MAGIC_SIZE;
+	memcpy(p, _main->conf->node_id, SHA1_SIZE);
+	p += SHA1_SIZE;
+	p = snap_put64(p, time(NULL));
+
+	nodes = p;
+	p = snap_write_nodes(p);
+
+	/* Keep the old snapshot if the routing table is empty */
+	if (p == nodes) {
+		myfree(buffer);
+		return;
+	}
+
+	p = snap_write_values(p);
+	p = snap_write_cache(p);
+
+	/* Replace the old snapshot at once */
+	snprintf(filename, BUF_SIZE + 4, "%s.tmp", _main->conf->snapshot);
+	if (file_write(filename, (char *)buffer, p - buffer) < 0) {
+		info(_log, NULL, "Snapshot %s: Writing failed", filename);
+	} else if (rename(filename, _main->conf->snapshot) != 0) {
+		info(_log, NULL, "Snapshot %s: Renaming failed", filename);
+	}
+
+	myfree(buffer);
+}
+
+UCHAR *snap_write_nodes(UCHAR * p)
+{
+	BCKT *t = _main->nbhd->bucket;
+	BUCK *b = NULL;
+	int i = 0;
+	int j = 0;
+
+	nbhd_rdlock();
+
+	for (i = 0; i < t->size; i++) {
+		b = t->bucket[i];
+		for (j = 0; j < b->nodes.size; j++) {
+
+			/* No answer to the last 4 pings */
+			if (node_bad(&b->nodes, j)) {
+				continue;
+			}
+
+			*p++ = SNAP_NODE;
+			memcpy(p, b->nodes.id[j], SHA1_SIZE);
+			p += SHA1_SIZE;
+			p = ip_sin_to_tuple(&b->nodes.c_addr[j], p);
+		}
+	}
+
+	nbhd_unlock();
+
+	return p;
+}
+
+UCHAR *snap_write_values(UCHAR * p)
+{
+	TARGET_V *target = NULL;
+	NODE_V *node = NULL;
+	ITEM *i = NULL;
+	ITEM *j = NULL;
+
+	mutex_block(_main->value->mutex);
+
+	/* Backwards like the cache. val_restore() puts each node on top and
+	 * sorts the targets by distance. */
+	i = list_stop(_main->value->list);
+	while (i != NULL) {
+		target = list_value(i);
+
+		j = list_stop(target->list);
+		while (j != NULL) {
+			node = list_value(j);
+
+			*p++ = SNAP_VALUE;
+			memcpy(p, target->target, SHA1_SIZE);
+			p += SHA1_SIZE;
+			memcpy(p, node->id, SHA1_SIZE);
+			p += SHA1_SIZE;
+			memcpy(p, node->pair, IP_SIZE_META_PAIR);
+			p += IP_SIZE_META_PAIR;
+			p = snap_put32(p, snap_ttl(node->eol));
+
+			j = list_prev(j);
+		}
+
+		i = list_prev(i);
+	}
+
+	mutex_unblock(_main->value->mutex);
+
+	return p;
+}
+
+UCHAR *snap_write_cache(UCHAR * p)
+{
+	TARGET_C *target = NULL;
+	NODE_C *node = NULL;
+	ITEM *i = NULL;
+	ITEM *j = NULL;
+
+	mutex_block(_main->cache->mutex);
+
+	/* Backwards as well. cache_restore() puts targets and nodes on top. */
+	i = list_stop(_main->cache->list);
+	while (i != NULL) {
+		target = list_value(i);
+
+		j = list_stop(target->list);
+		while (j != NULL) {
+			node = list_value(j);
+
+			*p++ = SNAP_CACHE;
+			memcpy(p, target->target, SHA1_SIZE);
+			p += SHA1_SIZE;
+			memcpy(p, node->pair, IP_SIZE_META_PAIR);
+			p += IP_SIZE_META_PAIR;
+			p = snap_put32(p, snap_ttl(node->eol));
+
+			j = list_prev(j);
+		}
+
+		i = list_prev(i);
+	}
+
+	mutex_unblock(_main->cache->mutex);
+
+	return p;
+}
+
+UCHAR *snap_put32(UCHAR * p, ULONG value)
+{
+	int j = 0;
+
+	for (j = 3; j >= 0; j--) {
+		*p++ = (value >> (8 * j)) & 0xFF;
+	}
+
+	return p;
+}
+
+ULONG snap_get32(UCHAR * p)
+{
+	ULONG value = 0;
+	int j = 0;
+
+	for (j = 0; j < 4; j++) {
+		value = (value << 8) | p[j];
+	}
+
+	return value;
+}
+
+UCHAR *snap_put64(UCHAR * p, time_t value)
+{
+	int j = 0;
+
+	for (j = 7; j >= 0; j--) {
+		*p++ = ((unsigned long long)value >> (8 * j)) & 0xFF;
+	}
+
+	return p;
+}
+
+time_t snap_get64(UCHAR * p)
+{
+	unsigned long long value = 0;
+	int j = 0;
+
+	for (j = 0; j < 8; j++) {
+		value = (value << 8) | p[j];
+	}
+
+	return (time_t) value;
+}
+
+ULONG snap_ttl(time_t eol)
+{
+	if (eol <= time_now_sec()) {
+		return 0;
+	}
+
+	return eol - time_now_sec();
+}
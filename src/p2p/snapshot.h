@@ -0,0 +1,98 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "../shr/config.h"
+#include "../shr/file.h"
+#include "../shr/log.h"
+#include "torrentkino.h"
+#include "conf.h"
+#include "neighbourhood.h"
+#include "value.h"
+#include "cache.h"
+#include "transaction.h"
+#include "send_udp.h"
+
+/*
+ * The snapshot is a header followed by fixed size records:
+ *
+ * Header: Magic, node id, wall clock time of the snapshot (8 bytes)
+ * Node:   'n', node id, IP/port
+ * Value:  'v', target, node id, IP/port, remaining lifetime (4 bytes)
+ * Cache:  'c', target, IP/port, remaining lifetime (4 bytes)
+ *
+ * Numbers are big endian. The compact IP/port pair differs between tk4 and
+ * tk6. So does the magic.
+ */
+#ifdef IPV6
+#define SNAP_MAGIC "tk6snap1"
+#elif IPV4
+#define SNAP_MAGIC "tk4snap1"
+#endif
+#define SNAP_MAGIC_SIZE 8
+
+#define SNAP_NODE 'n'
+#define SNAP_VALUE 'v'
+#define SNAP_CACHE 'c'
+
+#define SNAP_SIZE_HEADER (SNAP_MAGIC_SIZE + SHA1_SIZE + 8)
+#define SNAP_SIZE_NODE (1 + SHA1_SIZE + IP_SIZE_META_PAIR)
+#define SNAP_SIZE_VALUE (1 + 2 * SHA1_SIZE + IP_SIZE_META_PAIR + 4)
+#define SNAP_SIZE_CACHE (1 + SHA1_SIZE + IP_SIZE_META_PAIR + 4)
+
+#define SNAP_NODES_MAX (BCKT_MAX * NODE_SLOTS)
+#define SNAP_SIZE_MAX (SNAP_SIZE_HEADER + \
+	SNAP_NODES_MAX * SNAP_SIZE_NODE + \
+	VALUE_SIZE_MAX * TGT_V_SIZE_MAX * SNAP_SIZE_VALUE + \
+	CACHE_SIZE_MAX * TGT_C_SIZE_MAX * SNAP_SIZE_CACHE)
+
+struct obj_snap {
+	pthread_mutex_t *mutex;
+
+	/* The saved nodes get pinged once instead of the bootstrap server */
+	UCHAR *nodes;
+	int nodes_size;
+
+	/* File content between snap_init() and snap_restore() */
+	UCHAR *buffer;
+	size_t buffer_size;
+};
+typedef struct obj_snap SNAP;
+
+SNAP *snap_init(void);
+void snap_free(void);
+
+void snap_restore(void);
+int snap_restore_record(UCHAR * p, UCHAR * end, time_t age);
+int snap_bootstrap(void);
+
+void snap_write(void);
+UCHAR *snap_write_nodes(UCHAR * p);
+UCHAR *snap_write_values(UCHAR * p);
+UCHAR *snap_write_cache(UCHAR * p);
+
+UCHAR *snap_put32(UCHAR * p, ULONG value);
+ULONG snap_get32(UCHAR * p);
+UCHAR *snap_put64(UCHAR * p, time_t value);
+time_t snap_get64(UCHAR * p);
+ULONG snap_ttl(time_t eol);
+
+#endif
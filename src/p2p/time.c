@@ -21,6 +21,7 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/time.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -47,27 +48,63 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include "p2p.h"
 #include "time.h"
 
+/*
+ * Milliseconds of CLOCK_MONOTONIC_COARSE. Every thread moves it forward once
+ * per event loop iteration. Readers need no lock. Wall clock jumps do not
+ * matter.
+ */
+static LONG time_clock;
+
 void time_add_1_min(time_t * time)
 {
-	*time = _main->p2p->time_now.tv_sec + 60;
+	*time = time_now_sec() + 60;
 }
 
 void time_add_30_min(time_t * time)
 {
-	*time = _main->p2p->time_now.tv_sec + 1800;
+	*time = time_now_sec() + 1800;
 }
 
 void time_add_5_sec_approx(time_t * time)
 {
-	*time = _main->p2p->time_now.tv_sec + 4 + random() % 3;
+	*time = time_now_sec() + 4 + random() % 3;
 }
 
 void time_add_1_min_approx(time_t * time)
 {
-	*time = _main->p2p->time_now.tv_sec + 50 + random() % 20;
+	*time = time_now_sec() + 50 + random() % 20;
 }
 
 void time_add_5_min_approx(time_t * time)
 {
-	*time = _main->p2p->time_now.tv_sec + 240 + random() % 120;
+	*time = time_now_sec() + 240 + random() % 120;
+}
+
+void time_update(void)
+{
+	struct timespec ts;
+	LONG now = 0;
+	LONG old = 0;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	now = (LONG) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	/* Never backwards. Another thread may have been faster. */
+	old = __atomic_load_n(&time_clock, __ATOMIC_RELAXED);
+	while (now > old &&
+	       !__atomic_compare_exchange_n(&time_clock, &old, now, 1,
+					    __ATOMIC_RELAXED,
+					    __ATOMIC_RELAXED)) {
+	}
+}
+
+time_t time_now_sec(void)
+{
+	return time_now_ms() / 1000;
+}
+
+/* For round trip times */
+LONG time_now_ms(void)
+{
+	return __atomic_load_n(&time_clock, __ATOMIC_RELAXED);
 }
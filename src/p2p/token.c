@@ -42,97 +42,77 @@ struct obj_token *tkn_init(void)
 {
 	struct obj_token *token =
 	    (struct obj_token *)myalloc(sizeof(struct obj_token));
-	token->list = list_init();
-	token->hash = hash_init(10);
-	/* memset( token->null, '\0', TOKEN_SIZE ); */
+	token->mutex = mutex_init();
+	rand_urandom(token->secret, TOKEN_SECRET_SIZE);
+	rand_urandom(token->secret_old, TOKEN_SECRET_SIZE);
 	return token;
 }
 
 void tkn_free(void)
 {
-	list_clear(_main->token->list);
-	list_free(_main->token->list);
-	hash_free(_main->token->hash);
+	mutex_destroy(_main->token->mutex);
 	myfree(_main->token);
 }
 
-void tkn_put(void)
+void tkn_rotate(void)
 {
-	ITEM *item_tkn = NULL;
-	struct obj_tkn *tkn = NULL;
-
-	tkn = (struct obj_tkn *)myalloc(sizeof(struct obj_tkn));
-
-	/* ID */
-	tkn_create(tkn->id);
-
-	/* Availability */
-	time_add_30_min(&tkn->time);
-
-	item_tkn = list_put(_main->token->list, tkn);
-	hash_put(_main->token->hash, tkn->id, TOKEN_SIZE, item_tkn);
+	mutex_block(_main->token->mutex);
+	memcpy(_main->token->secret_old, _main->token->secret,
+	       TOKEN_SECRET_SIZE);
+	rand_urandom(_main->token->secret, TOKEN_SECRET_SIZE);
+	mutex_unblock(_main->token->mutex);
 }
 
-void tkn_del(ITEM * item_tkn)
+/* The address only. The port of a NAT may change. */
+void tkn_create(UCHAR * token, UCHAR * secret, IP * from)
 {
-	struct obj_tkn *tkn = list_value(item_tkn);
-	hash_del(_main->token->hash, tkn->id, TOKEN_SIZE);
-	list_del(_main->token->list, item_tkn);
-	myfree(tkn);
-}
+	UCHAR hash[SHA1_SIZE];
 
-void tkn_expire(time_t now)
-{
-	ITEM *item_tkn = NULL;
-	ITEM *next_tkn = NULL;
-	struct obj_tkn *tkn = NULL;
-
-	item_tkn = list_start(_main->token->list);
-	while (item_tkn != NULL) {
-		tkn = list_value(item_tkn);
-		next_tkn = list_next(item_tkn);
-
-		/* Bad token */
-		if (now > tkn->time) {
-			tkn_del(item_tkn);
-		}
-		item_tkn = next_tkn;
-	}
-}
+#ifdef IPV6
+	sha1_hmac_hash(hash, secret, TOKEN_SECRET_SIZE,
+		       (const char *)&from->sin6_addr, sizeof(from->sin6_addr));
+#elif IPV4
+	sha1_hmac_hash(hash, secret, TOKEN_SECRET_SIZE,
+		       (const char *)&from->sin_addr, sizeof(from->sin_addr));
+#endif
 
-int tkn_validate(UCHAR * id)
-{
-	ITEM *item_tkn = NULL;
-
-	/* Token not found */
-	if ((item_tkn = hash_get(_main->token->hash, id, TOKEN_SIZE)) == NULL) {
-		return 0;
-	}
-
-	return 1;
+	memcpy(token, hash, TOKEN_SIZE);
 }
 
-void tkn_create(UCHAR * id)
+int tkn_validate(UCHAR * token, IP * from)
 {
+	UCHAR secret[TOKEN_SECRET_SIZE];
+	UCHAR secret_old[TOKEN_SECRET_SIZE];
+	UCHAR expected[TOKEN_SIZE];
+	UCHAR expected_old[TOKEN_SIZE];
+	UCHAR diff = 0;
+	UCHAR diff_old = 0;
 	int i = 0;
-	int max = 1000;
 
-	/* Create unique ID but do not try this forever */
-	do {
-		rand_urandom(id, TOKEN_SIZE);
-		i++;
-	} while (hash_exists(_main->token->hash, id, TOKEN_SIZE) && i < max);
+	mutex_block(_main->token->mutex);
+	memcpy(secret, _main->token->secret, TOKEN_SECRET_SIZE);
+	memcpy(secret_old, _main->token->secret_old, TOKEN_SECRET_SIZE);
+	mutex_unblock(_main->token->mutex);
 
-	if (i >= max) {
-		info(_log, NULL, "Tokens exhausted. Giving up.");
+	tkn_create(expected, secret, from);
+	tkn_create(expected_old, secret_old, from);
+
+	/* Compare all bytes. Do not tell how many matched. */
+	for (i = 0; i < TOKEN_SIZE; i++) {
+		diff |= token[i] ^ expected[i];
+		diff_old |= token[i] ^ expected_old[i];
 	}
+
+	return diff == 0 || diff_old == 0;
 }
 
-UCHAR *tkn_read(void)
+void tkn_read(UCHAR * token, IP * from)
 {
-	ITEM *item_tkn = list_stop(_main->token->list);
-	struct obj_tkn *tkn = list_value(item_tkn);
+	UCHAR secret[TOKEN_SECRET_SIZE];
+
+	mutex_block(_main->token->mutex);
+	memcpy(secret, _main->token->secret, TOKEN_SECRET_SIZE);
+	mutex_unblock(_main->token->mutex);
 
-	/* Return newest token */
-	return tkn->id;
+	tkn_create(token, secret, from);
 }
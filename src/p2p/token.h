@@ -23,32 +23,31 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include "../shr/random.h"
 #include "../shr/log.h"
 #include "time.h"
-#include "../shr/hash.h"
+#include "sha1.h"
 #include "ben.h"
 
 #define TOKEN_SIZE 8
 #define TOKEN_SIZE_MAX 20
+#define TOKEN_SECRET_SIZE 20
 
+/*
+ * Tokens are not stored. A token is the HMAC-SHA1 of the requester's IP
+ * address, keyed with a secret. The secret changes every ~5 minutes. A token
+ * made with the previous secret is still accepted.
+ */
 struct obj_token {
-	LIST *list;
-	HASH *hash;
-	/* UCHAR null[TOKEN_SIZE]; */
-};
-
-struct obj_tkn {
-	UCHAR id[TOKEN_SIZE];
-	time_t time;
+	pthread_mutex_t *mutex;
+	UCHAR secret[TOKEN_SECRET_SIZE];
+	UCHAR secret_old[TOKEN_SECRET_SIZE];
 };
 
 struct obj_token *tkn_init(void);
 void tkn_free(void);
 
-void tkn_put(void);
-void tkn_del(ITEM * item_tkn);
+void tkn_rotate(void);
 
-void tkn_create(UCHAR * id);
-void tkn_expire(time_t now);
-int tkn_validate(UCHAR * id);
-UCHAR *tkn_read(void);
+void tkn_create(UCHAR * token, UCHAR * secret, IP * from);
+int tkn_validate(UCHAR * token, IP * from);
+void tkn_read(UCHAR * token, IP * from);
 
 #endif
@@ -39,6 +39,8 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include "cache.h"
 #include "neighbourhood.h"
 #include "transaction.h"
+#include "send_udp.h"
+#include "snapshot.h"
 
 #include "worker.h"
 
@@ -63,8 +65,10 @@ struct obj_main *main_init(int argc, char **argv)
 	_main->token = NULL;
 	_main->nbhd = NULL;
 	_main->value = NULL;
+	_main->snap = NULL;
 	_main->p2p = NULL;
 	_main->udp = NULL;
+	_main->shard = NULL;
 	_main->dns = NULL;
 
 	_log = NULL;
@@ -81,22 +85,46 @@ int main(int argc, char **argv)
 {
 	struct sigaction sig_stop;
 	struct sigaction sig_time;
+	int i = 0;
 
 	_main = main_init(argc, argv);
 	_log = log_init();
 	_main->identity = id_init();
+	sha1_init();
 	_main->conf = conf_init(argc, argv);
+#ifdef POLARSSL
+	if (_main->conf->bool_encryption) {
+		aes_init(_main->conf->key, strlen(_main->conf->key));
+	}
+#endif
 	_main->work = work_init();
+	_main->snap = snap_init();
+
+	/* Start the clock before the timer wheels */
+	time_update();
 
 	_main->nbhd = nbhd_init();
 	_main->value = val_init();
-	_main->transaction = tdb_init();
+	_main->transaction = tdb_init(_main->conf->workers);
 	_main->token = tkn_init();
 	_main->p2p = p2p_init();
-	_main->udp = udp_init();
+	_main->send = send_init();
 	_main->dns = udp_init();
+
+	/* One P2P socket per worker. The first one does the multicast. */
+	_main->shard =
+	    (struct obj_udp **)myalloc(_main->conf->workers *
+				       sizeof(struct obj_udp *));
+	for (i = 0; i < _main->conf->workers; i++) {
+		_main->shard[i] = udp_init();
+		_main->shard[i]->shard = i;
+	}
+	_main->udp = _main->shard[0];
 	_main->cache = cache_init();
 
+	/* Values and cached lookups from the last run */
+	snap_restore();
+
 	/* Check configuration */
 	conf_print();
 
@@ -106,14 +134,15 @@ int main(int argc, char **argv)
 	/* Fork daemon */
 	unix_fork(log_console(_log));
 
-	/* Create kademlia token */
-	tkn_put();
-
 	/* Increase limits */
 	unix_limits(_main->conf->cores, CONF_EPOLL_MAX_EVENTS);
 
 	/* Prepare UDP daemon */
 	udp_start(_main->udp, _main->conf->p2p_port, multicast_enabled);
+	for (i = 1; i < _main->conf->workers; i++) {
+		udp_start(_main->shard[i], _main->conf->p2p_port,
+			  multicast_disabled);
+	}
 	udp_start(_main->dns, _main->conf->dns_port, multicast_disabled);
 
 	/* Drop privileges */
@@ -127,19 +156,32 @@ int main(int argc, char **argv)
 
 	/* Stop UDP daemon */
 	udp_stop(_main->dns, multicast_disabled);
+	for (i = _main->conf->workers - 1; i > 0; i--) {
+		udp_stop(_main->shard[i], multicast_disabled);
+	}
 	udp_stop(_main->udp, multicast_enabled);
 
+	/* Save the routing table for the next start */
+	snap_write();
+
+	snap_free();
 	cache_free();
 	val_free();
 	nbhd_free();
 	tdb_free();
 	tkn_free();
+	send_free();
 	p2p_free();
 	udp_free(_main->dns);
-	udp_free(_main->udp);
+	for (i = 0; i < _main->conf->workers; i++) {
+		udp_free(_main->shard[i]);
+	}
+	myfree(_main->shard);
 	id_free(_main->identity);
 	work_free();
 	conf_free();
+	pool_print();
+	pool_free();
 	log_free(_log);
 	main_free();
 
@@ -37,9 +37,12 @@ struct obj_main {
 	struct obj_token *token;
 	struct obj_nbhd *nbhd;
 	struct obj_udp *udp;
+	struct obj_udp **shard;
 	struct obj_udp *dns;
 	struct obj_p2p *p2p;
+	struct obj_send *send;
 	struct obj_val *value;
+	struct obj_snap *snap;
 	LIST *identity;
 #endif
 };
@@ -33,158 +33,331 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include <signal.h>
 #include <netdb.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
 
 #include "transaction.h"
 #include "torrentkino.h"
 
-struct obj_transaction *tdb_init(void)
+/* The shard this thread works on and the shard it holds right now */
+static __thread int tdb_shard_self;
+static __thread struct obj_transaction *tdb_locked;
+
+struct obj_transaction *tdb_init(int shards)
 {
 	struct obj_transaction *transaction = (struct obj_transaction *)
-	    myalloc(sizeof(struct obj_transaction));
-	transaction->list = list_init();
-	transaction->hash = hash_init(1000);
+	    myalloc(shards * sizeof(struct obj_transaction));
+	int i = 0;
+
+	for (i = 0; i < shards; i++) {
+		transaction[i].mutex = mutex_init();
+		transaction[i].slot = (TID *) myalloc(TDB_SLOTS * sizeof(TID));
+		transaction[i].head = 0;
+		transaction[i].tail = 0;
+		transaction[i].wheel = wheel_init(time_now_ms());
+		transaction[i].sleep = -1;
+		transaction[i].wake = eventfd(0, EFD_NONBLOCK);
+		if (transaction[i].wake < 0) {
+			fail("eventfd() failed");
+		}
+	}
 	return transaction;
 }
 
 void tdb_free(void)
 {
-	tdb_clean();
-	list_clear(_main->transaction->list);
-	list_free(_main->transaction->list);
-	hash_free(_main->transaction->hash);
+	int i = 0;
+
+	for (i = 0; i < _main->conf->workers; i++) {
+		tdb_lock(i);
+		tdb_clean();
+		myfree(tdb_here()->slot);
+		wheel_free(tdb_here()->wheel);
+		tdb_unlock();
+		close(_main->transaction[i].wake);
+		mutex_destroy(_main->transaction[i].mutex);
+	}
 	myfree(_main->transaction);
 }
 
 void tdb_clean(void)
 {
-	while (_main->transaction->list->item != NULL) {
-		tdb_del(_main->transaction->list->item);
+	struct obj_transaction *transaction = tdb_here();
+
+	while (transaction->tail != transaction->head) {
+		tdb_del(&transaction->slot[transaction->tail % TDB_SLOTS]);
+		transaction->tail++;
+	}
+}
+
+/* P2P worker n owns shard n. Every other thread uses shard 0. */
+void tdb_bind(int shard)
+{
+	tdb_shard_self = shard;
+}
+
+int tdb_self(void)
+{
+	return tdb_shard_self;
+}
+
+int tdb_shard(UCHAR * id)
+{
+	return id[0] % _main->conf->workers;
+}
+
+void tdb_lock(int shard)
+{
+	mutex_block(_main->transaction[shard].mutex);
+	tdb_locked = &_main->transaction[shard];
+}
+
+void tdb_unlock(void)
+{
+	struct obj_transaction *transaction = tdb_locked;
+
+	tdb_locked = NULL;
+	mutex_unblock(transaction->mutex);
+}
+
+struct obj_transaction *tdb_here(void)
+{
+	if (tdb_locked == NULL) {
+		fail("tdb_here(): No transaction shard locked");
 	}
+	return tdb_locked;
 }
 
-ITEM *tdb_put(int type)
+TID *tdb_put(int type)
 {
-	ITEM *item = NULL;
+	struct obj_transaction *transaction = tdb_here();
 	TID *tid = NULL;
 
-	tid = (TID *) myalloc(sizeof(TID));
+	/* Skip answered transactions */
+	while (transaction->tail != transaction->head &&
+	       transaction->slot[transaction->tail % TDB_SLOTS].type ==
+	       P2P_TYPE_UNKNOWN) {
+		transaction->tail++;
+	}
 
-	/* ID */
-	tdb_create_random_id(tid->id);
+	if (transaction->head - transaction->tail >= TDB_SLOTS) {
+		info(_log, NULL, "Transaction table full. Giving up.");
+		return NULL;
+	}
+
+	tid = &transaction->slot[transaction->head % TDB_SLOTS];
 
 	/* PING, ANNOUNCE_PEER, FIND_NODE, GET_PEERS */
 	tid->type = type;
 
+	/* ID */
+	tdb_create_id(tid, transaction->head);
+	transaction->head++;
+
 	/* Availability */
 	time_add_1_min(&tid->time);
 
+	/* Round trip time */
+	tid->time_sent = time_now_ms();
+
 	/* More details for ANNOUNCE_PEER and GET_PEERS requests */
 	tid->lookup = NULL;
 
-	item = list_put(_main->transaction->list, tid);
-	hash_put(_main->transaction->hash, tid->id, TID_SIZE, item);
-
-	return item;
+	return tid;
 }
 
-void tdb_del(ITEM * i)
+/* The slot stays in the ring until the tail passes by */
+void tdb_del(TID * tid)
 {
-	TID *tid = NULL;
-
-	if (i == NULL) {
+	if (tid == NULL) {
 		return;
-	} else {
-		tid = list_value(i);
 	}
 
-	switch (tdb_type(i)) {
+	switch (tdb_type(tid)) {
 	case P2P_GET_PEERS:
 	case P2P_ANNOUNCE_START:
-		ldb_free(tdb_ldb(i));
+		ldb_free(tdb_ldb(tid));
 		break;
 	}
 
-	hash_del(_main->transaction->hash, tdb_tid(i), TID_SIZE);
-	list_del(_main->transaction->list, i);
-	myfree(tid);
+	wheel_del(&tid->timer);
+	tid->type = P2P_TYPE_UNKNOWN;
+	tid->lookup = NULL;
 }
 
 void tdb_expire(time_t now)
 {
-	ITEM *item = NULL;
-	ITEM *next = NULL;
-	TID *tid = NULL;
+	int i = 0;
 
-	item = list_start(_main->transaction->list);
-	while (item != NULL) {
-		next = list_next(item);
-		tid = list_value(item);
+	for (i = 0; i < _main->conf->workers; i++) {
+		tdb_lock(i);
+		tdb_expire_shard(now);
+		tdb_unlock();
+	}
+}
 
-		/* Too OLD or GAME OVER */
-		if (now > tid->time || status == GAMEOVER) {
+void tdb_expire_shard(time_t now)
+{
+	struct obj_transaction *transaction = tdb_here();
+	TID *tid = NULL;
 
-			switch (tid->type) {
-			case P2P_ANNOUNCE_START:
-				p2p_cron_announce(item);
+	/* Too OLD. GAME OVER takes them all. */
+	while (transaction->tail != transaction->head) {
+		tid = &transaction->slot[transaction->tail % TDB_SLOTS];
+
+		if (tid->type != P2P_TYPE_UNKNOWN) {
+			if (status != GAMEOVER && now <= tid->time) {
 				break;
 			}
-
-			tdb_del(item);
+			tdb_timeout(tid);
 		}
 
-		item = next;
+		transaction->tail++;
 	}
 }
 
-ITEM *tdb_item(UCHAR * id)
+/* Per hop timeouts of the lookups in this thread's shard. In ms. Returns the
+ * milliseconds until the next hop may time out or -1 if there is none. */
+LONG tdb_hops(LONG now)
 {
-	return hash_get(_main->transaction->hash, id, TID_SIZE);
+	struct obj_transaction *transaction = NULL;
+	ILIST due;
+	TIMER *timer = NULL;
+	LONG next = 0;
+
+	tdb_lock(tdb_self());
+	transaction = tdb_here();
+
+	ilist_init(&due);
+	wheel_expire(transaction->wheel, now, &due);
+	while ((timer = wheel_next(&due)) != NULL) {
+		tdb_timeout(wheel_value(timer, TID, timer));
+	}
+
+	/* The owner sleeps until then. Others wake it up for anything earlier. */
+	next = wheel_due(transaction->wheel);
+	transaction->sleep = next;
+
+	tdb_unlock();
+
+	if (next < 0) {
+		return -1;
+	}
+
+	return (next > now) ? next - now : 0;
 }
 
-void tdb_link_ldb(ITEM * i, LOOKUP * l)
+/* Lookups continue on whatever worker the reply arrives. Wake up the owner of
+ * the shard if it would sleep past the new hop timeout. */
+void tdb_arm(TID * tid, LONG due)
 {
-	TID *tid = list_value(i);
-	tid->lookup = l;
+	struct obj_transaction *transaction = tdb_here();
+	uint64_t one = 1;
+
+	wheel_add(transaction->wheel, &tid->timer, due, 0);
+
+	if (transaction == &_main->transaction[tdb_self()]) {
+		return;
+	}
+	if (transaction->sleep >= 0 && transaction->sleep <= due) {
+		return;
+	}
+
+	transaction->sleep = due;
+	if (write(transaction->wake, &one, sizeof(uint64_t)) < 0 &&
+	    errno != EAGAIN) {
+		info(_log, NULL, "tdb_arm: write() failed / %s",
+		     strerror(errno));
+	}
 }
 
-int tdb_type(ITEM * i)
+/* Reset the wake up call of a shard */
+void tdb_awake(int shard)
 {
-	TID *tid = NULL;
+	uint64_t count = 0;
 
-	if (i == NULL) {
+	if (read(_main->transaction[shard].wake, &count, sizeof(uint64_t))
+	    < 0 && errno != EAGAIN) {
+		info(_log, NULL, "tdb_awake: read() failed / %s",
+		     strerror(errno));
+	}
+}
+
+void tdb_timeout(TID * tid)
+{
+	switch (tid->type) {
+	case P2P_GET_PEERS:
+	case P2P_ANNOUNCE_START:
+		/* A hop timed out or the lookup is over */
+		p2p_lookup_expire(tid);
+		return;
+	}
+
+	tdb_del(tid);
+}
+
+TID *tdb_item(UCHAR * id)
+{
+	TID *tid = &tdb_here()->slot[((id[2] << 8) | id[3]) % TDB_SLOTS];
+
+	/* Same slot, generation and type. And still in use. */
+	if (memcmp(tid->id, id, TID_SIZE) != 0) {
+		return NULL;
+	}
+	if (tid->type == P2P_TYPE_UNKNOWN) {
+		return NULL;
+	}
+
+	return tid;
+}
+
+void tdb_link_ldb(TID * tid, LOOKUP * l)
+{
+	tid->lookup = l;
+}
+
+int tdb_type(TID * tid)
+{
+	if (tid == NULL) {
 		return P2P_TYPE_UNKNOWN;
-	} else {
-		tid = list_value(i);
 	}
 
 	return tid->type;
 }
 
-LOOKUP *tdb_ldb(ITEM * i)
+LOOKUP *tdb_ldb(TID * tid)
 {
-	TID *tid = list_value(i);
 	return tid->lookup;
 }
 
-UCHAR *tdb_tid(ITEM * i)
+UCHAR *tdb_tid(TID * tid)
 {
-	TID *tid = list_value(i);
 	return tid->id;
 }
 
-void tdb_create_random_id(UCHAR * id)
+void tdb_create_id(TID * tid, ULONG index)
 {
-	int i = 0;
-	int max = 1000;
+	int shard = tdb_here() - _main->transaction;
+	int workers = _main->conf->workers;
+	ULONG address = 0;
+	int first = 0;
+
+	/* Route the reply back to this shard */
+	rand_urandom(&tid->id[0], 1);
+	first = tid->id[0] - tid->id[0] % workers + shard;
+	if (first > 255) {
+		first -= workers;
+	}
+	tid->id[0] = first;
 
-	/* Create unique ID but do not try this forever */
-	do {
-		rand_urandom(id, TID_SIZE);
-		i++;
-	} while (hash_exists(_main->transaction->hash, id, TID_SIZE)
-		 && i < max);
+	/* Replies to the previous user of this slot do not match anymore */
+	tid->gen = (tid->gen + 1) & TDB_GEN_MASK;
 
-	if (i >= max) {
-		info(_log, NULL, "Transaction IDs exhausted. Giving up.");
-	}
+	address = tid->type & 0x07;
+	address = (address << TDB_GEN_BITS) | tid->gen;
+	address = (address << TDB_SLOTS_BITS) | (index % TDB_SLOTS);
+
+	tid->id[1] = (address >> 16) & 0xFF;
+	tid->id[2] = (address >> 8) & 0xFF;
+	tid->id[3] = address & 0xFF;
 }
@@ -20,37 +20,84 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef TRANSACTION_H
 #define TRANSACTION_H
 
+#include "../shr/wheel.h"
 #include "lookup.h"
 #include "p2p.h"
 
-struct obj_transaction {
-	LIST *list;
-	HASH *hash;
-};
+/*
+ * One shard per P2P worker. A TID and its LOOKUP may only be touched while
+ * its shard is locked.
+ *
+ * Every shard is a ring of TDB_SLOTS transactions, used in the order they
+ * were created. All of them live for a minute, so they expire in ring order
+ * too. The wheel only carries the per hop timeouts of lookups. It counts
+ * milliseconds and every UDP thread drains the wheel of its own shard. A
+ * thread that arms a hop timer in a foreign shard writes to the eventfd of
+ * that shard if its owner would sleep past the deadline.
+ *
+ * The 4 byte TID is the address of its slot:
+ *
+ * Byte 0:     Random. Modulo the number of workers it selects the shard.
+ * Bytes 1..3: Type (3 bits), generation (7 bits), slot index (14 bits).
+ *
+ * The generation grows whenever a slot gets reused. A reply must match all
+ * 4 bytes. A full ring takes no new queries until the oldest ones expire.
+ */
+#define TDB_SLOTS_BITS 14
+#define TDB_SLOTS (1 << TDB_SLOTS_BITS)
+#define TDB_GEN_BITS 7
+#define TDB_GEN_MASK ((1 << TDB_GEN_BITS) - 1)
 
 struct obj_tid {
+	TIMER timer;
 	UCHAR id[TID_SIZE];
 	time_t time;
+	LONG time_sent;
 	int type;
+	int gen;
 	LOOKUP *lookup;
 };
 typedef struct obj_tid TID;
 
-struct obj_transaction *tdb_init(void);
+struct obj_transaction {
+	pthread_mutex_t *mutex;
+	TID *slot;
+	ULONG head;
+	ULONG tail;
+	WHEEL *wheel;
+
+	/* The owner sleeps until this ms deadline. -1: No deadline. */
+	LONG sleep;
+	int wake;
+};
+
+struct obj_transaction *tdb_init(int shards);
 void tdb_free(void);
 
-ITEM *tdb_put(int type);
-void tdb_del(ITEM * i);
+void tdb_bind(int shard);
+int tdb_self(void);
+int tdb_shard(UCHAR * id);
+void tdb_lock(int shard);
+void tdb_unlock(void);
+struct obj_transaction *tdb_here(void);
+
+TID *tdb_put(int type);
+void tdb_del(TID * tid);
 
 void tdb_clean(void);
 void tdb_expire(time_t now);
+void tdb_expire_shard(time_t now);
+LONG tdb_hops(LONG now);
+void tdb_arm(TID * tid, LONG due);
+void tdb_awake(int shard);
+void tdb_timeout(TID * tid);
 
-void tdb_link_ldb(ITEM * i, LOOKUP * l);
+void tdb_link_ldb(TID * tid, LOOKUP * l);
 
-void tdb_create_random_id(UCHAR * id);
-ITEM *tdb_item(UCHAR * id);
-int tdb_type(ITEM * i);
-LOOKUP *tdb_ldb(ITEM * i);
-UCHAR *tdb_tid(ITEM * i);
+void tdb_create_id(TID * tid, ULONG index);
+TID *tdb_item(UCHAR * id);
+int tdb_type(TID * tid);
+LOOKUP *tdb_ldb(TID * tid);
+UCHAR *tdb_tid(TID * tid);
 
 #endif
@@ -17,6 +17,9 @@ You should have received a copy of the GNU General Public License
 along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+/* recvmmsg() and sendmmsg() */
+#define _GNU_SOURCE
+
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -30,6 +33,35 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "udp.h"
 
+/*
+ * Datagrams received with one recvmmsg() and replies queued for one
+ * sendmmsg(). Every thread owns one.
+ */
+struct obj_udp_batch {
+	/* Inbound ring */
+	struct mmsghdr in_msg[UDP_MMSG];
+	struct iovec in_iov[UDP_MMSG];
+	IP in_addr[UDP_MMSG];
+	UCHAR in_buf[UDP_MMSG][UDP_BUF + 1];
+
+	/* Outbound queue */
+	int depth;
+	int out_fd;
+	int out_size;
+	struct mmsghdr out_msg[UDP_MMSG];
+	struct iovec out_iov[UDP_MMSG];
+	IP out_addr[UDP_MMSG];
+	UCHAR out_buf[UDP_MMSG][UDP_BUF];
+};
+
+static __thread UDP_BATCH *udp_batch;
+
+/* The P2P socket of this worker */
+static __thread UDP *udp_mine;
+
+/* Cleared once the kernel says ENOSYS. Then recvfrom()/sendto() it is. */
+static int udp_mmsg = TRUE;
+
 UDP *udp_init(void)
 {
 	UDP *udp = (UDP *) myalloc(sizeof(UDP));
@@ -43,6 +75,7 @@ UDP *udp_init(void)
 	udp->multicast = FALSE;
 
 	udp->type = udp_p2p_worker;
+	udp->shard = 0;
 
 	return udp;
 }
@@ -54,9 +87,7 @@ void udp_free(UDP * udp)
 
 void udp_start(UDP * udp, int port, int multicast_mode)
 {
-#ifdef IPV6
 	int optval = 1;
-#endif
 
 #ifdef IPV6
 	if ((udp->sockfd = socket(PF_INET6, SOCK_DGRAM, 0)) < 0) {
@@ -91,6 +122,34 @@ void udp_start(UDP * udp, int port, int multicast_mode)
 	/* } */
 #endif
 
+	/* Every P2P worker binds its own socket to the same port */
+	if (udp->type == udp_p2p_worker && _main->conf->workers > 1) {
+		if (setsockopt(udp->sockfd, SOL_SOCKET, SO_REUSEPORT,
+			       &optval, sizeof(int)) == -1) {
+			fail("Setting SO_REUSEPORT failed");
+		}
+	}
+
+	/* Multicast datagrams reach every socket on the port, not just one of
+	 * the group. Only the socket that joined shall see them. */
+	if (udp->type == udp_p2p_worker && multicast_mode == multicast_disabled) {
+		optval = 0;
+#ifdef IPV6
+		if (setsockopt(udp->sockfd, IPPROTO_IPV6, IPV6_MULTICAST_ALL,
+			       &optval, sizeof(int)) == -1) {
+			info(_log, NULL, "Setting IPV6_MULTICAST_ALL failed: %s",
+			     strerror(errno));
+		}
+#elif IPV4
+		if (setsockopt(udp->sockfd, IPPROTO_IP, IP_MULTICAST_ALL,
+			       &optval, sizeof(int)) == -1) {
+			info(_log, NULL, "Setting IP_MULTICAST_ALL failed: %s",
+			     strerror(errno));
+		}
+#endif
+		optval = 1;
+	}
+
 	if (bind(udp->sockfd, (struct sockaddr *)&udp->s_addr, udp->s_addrlen)) {
 		fail("bind() to socket failed.");
 	}
@@ -136,6 +195,19 @@ void udp_event(UDP * udp)
 	if (epoll_ctl(udp->epollfd, EPOLL_CTL_ADD, udp->sockfd, &ev) == -1) {
 		fail("udp_event: epoll_ctl() failed");
 	}
+
+	if (udp->type != udp_p2p_worker) {
+		return;
+	}
+
+	/* Hop timers armed in this shard by other workers */
+	memset(&ev, '\0', sizeof(struct epoll_event));
+	ev.events = EPOLLIN;
+	ev.data.fd = _main->transaction[udp->shard].wake;
+
+	if (epoll_ctl(udp->epollfd, EPOLL_CTL_ADD, ev.data.fd, &ev) == -1) {
+		fail("udp_event: epoll_ctl() failed");
+	}
 }
 
 void *udp_thread(void *arg)
@@ -144,6 +216,7 @@ void *udp_thread(void *arg)
 	struct epoll_event events[CONF_EPOLL_MAX_EVENTS];
 	int nfds;
 	int id = 0;
+	int timeout = CONF_EPOLL_WAIT;
 
 	mutex_block(_main->work->mutex);
 	id = _main->work->id++;
@@ -152,10 +225,20 @@ void *udp_thread(void *arg)
 	info(_log, NULL, "UDP Thread[%i] - Max events: %i", id,
 	     CONF_EPOLL_MAX_EVENTS);
 
+	/* Replies leave through the socket they came in. Queries made here
+	 * belong to this worker's transaction shard. */
+	if (udp->type == udp_p2p_worker) {
+		udp_mine = udp;
+		tdb_bind(udp->shard);
+	}
+
 	while (status == RUMBLE) {
 
 		nfds = epoll_wait(udp->epollfd, events,
-				  CONF_EPOLL_MAX_EVENTS, CONF_EPOLL_WAIT);
+				  CONF_EPOLL_MAX_EVENTS, timeout);
+
+		/* Tick Tock */
+		time_update();
 
 		/* Shutdown server */
 		if (status != RUMBLE) {
@@ -173,8 +256,15 @@ void *udp_thread(void *arg)
 		} else if (nfds > 0) {
 			udp_worker(udp, events, nfds);
 		}
+
+		/* Lookup hops time out in milliseconds */
+		udp_batch_start();
+		timeout = udp_timeout(tdb_hops(time_now_ms()));
+		udp_batch_stop();
 	}
 
+	udp_batch_free();
+
 	pthread_exit(NULL);
 }
 
@@ -186,7 +276,11 @@ void *udp_client(void *arg)
 		pthread_exit(NULL);
 	}
 
+	udp_batch_start();
 	p2p_bootstrap();
+	udp_batch_stop();
+
+	udp_batch_free();
 	pthread_exit(NULL);
 }
 
@@ -195,7 +289,11 @@ void udp_worker(UDP * udp, struct epoll_event *events, int nfds)
 	int i;
 
 	for (i = 0; i < nfds; i++) {
-		if ((events[i].events & EPOLLIN) == EPOLLIN) {
+		if (udp->type == udp_p2p_worker &&
+		    events[i].data.fd == _main->transaction[udp->shard].wake) {
+			/* The hops get looked at right after this */
+			tdb_awake(udp->shard);
+		} else if ((events[i].events & EPOLLIN) == EPOLLIN) {
 			udp_input(udp, events[i].data.fd);
 			udp_rearm(udp, events[i].data.fd);
 		} else {
@@ -232,6 +330,78 @@ int udp_nonblocking(int sock)
 }
 
 void udp_input(UDP * udp, int sockfd)
+{
+	if (udp_mmsg && udp_input_mmsg(udp, sockfd)) {
+		return;
+	}
+
+	udp_input_single(udp, sockfd);
+}
+
+/* Returns FALSE if recvmmsg() is not available */
+int udp_input_mmsg(UDP * udp, int sockfd)
+{
+	UDP_BATCH *batch = udp_batch_get();
+	struct msghdr *hdr = NULL;
+	ssize_t bytes = 0;
+	int n = 0;
+	int i = 0;
+
+	while (status == RUMBLE) {
+		for (i = 0; i < UDP_MMSG; i++) {
+			hdr = &batch->in_msg[i].msg_hdr;
+			hdr->msg_name = &batch->in_addr[i];
+			hdr->msg_namelen = sizeof(IP);
+			hdr->msg_iov = &batch->in_iov[i];
+			hdr->msg_iovlen = 1;
+			hdr->msg_control = NULL;
+			hdr->msg_controllen = 0;
+			hdr->msg_flags = 0;
+			batch->in_iov[i].iov_base = batch->in_buf[i];
+			batch->in_iov[i].iov_len = UDP_BUF;
+		}
+
+		n = recvmmsg(sockfd, batch->in_msg, UDP_MMSG, 0, NULL);
+
+		if (n < 0) {
+			if (errno == ENOSYS) {
+				udp_mmsg = FALSE;
+				return FALSE;
+			}
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				info(_log, NULL, "UDP error while recvmmsg");
+			}
+			return TRUE;
+		}
+
+		/* A long burst keeps the clock going */
+		time_update();
+
+		udp_batch_start();
+		for (i = 0; i < n; i++) {
+			bytes = batch->in_msg[i].msg_len;
+
+			if (bytes == 0) {
+				info(_log, &batch->in_addr[i], "UDP error 0 bytes");
+				continue;
+			}
+
+			batch->in_buf[i][bytes] = '\0';
+			udp_packet(udp, batch->in_buf[i], bytes,
+				   &batch->in_addr[i]);
+		}
+		udp_batch_stop();
+
+		/* Drained. The rearmed epoll event reports anything newer. */
+		if (n < UDP_MMSG) {
+			return TRUE;
+		}
+	}
+
+	return TRUE;
+}
+
+void udp_input_single(UDP * udp, int sockfd)
 {
 	UCHAR buffer[UDP_BUF + 1];
 	ssize_t bytes = 0;
@@ -257,14 +427,21 @@ void udp_input(UDP * udp, int sockfd)
 			return;
 		}
 
-		if (udp->type == udp_p2p_worker) {
-			/* Parse UDP packet */
-			p2p_parse(buffer, bytes, &c_addr);
-			udp_cron(udp);
-		} else {
-			/* Parse DNS packet */
-			r_parse(buffer, bytes, &c_addr);
-		}
+		udp_batch_start();
+		udp_packet(udp, buffer, bytes, &c_addr);
+		udp_batch_stop();
+	}
+}
+
+void udp_packet(UDP * udp, UCHAR * buffer, size_t bytes, IP * from)
+{
+	if (udp->type == udp_p2p_worker) {
+		/* Parse UDP packet */
+		p2p_parse(buffer, bytes, from);
+		udp_cron(udp);
+	} else {
+		/* Parse DNS packet */
+		r_parse(buffer, bytes, from);
 	}
 }
 
@@ -274,9 +451,120 @@ void udp_cron(UDP * udp)
 		return;
 	}
 
-	mutex_block(_main->work->mutex);
+	/* One worker runs the timers. The others carry on. */
+	if (pthread_mutex_trylock(_main->work->mutex) != 0) {
+		return;
+	}
+
+	udp_batch_start();
 	p2p_cron();
 	mutex_unblock(_main->work->mutex);
+	udp_batch_stop();
+}
+
+/* Sleep until the next lookup hop of this thread's shard is due. Lookups
+ * started by the DNS thread live in shard 0, so it keeps an eye on them as
+ * well. */
+int udp_timeout(LONG wait)
+{
+	if (wait < 0 || wait > CONF_EPOLL_WAIT) {
+		return CONF_EPOLL_WAIT;
+	}
+
+	return wait;
+}
+
+UDP *udp_own(void)
+{
+	return (udp_mine != NULL) ? udp_mine : _main->udp;
+}
+
+UDP_BATCH *udp_batch_get(void)
+{
+	if (udp_batch == NULL) {
+		udp_batch = (UDP_BATCH *) myalloc(sizeof(UDP_BATCH));
+	}
+	return udp_batch;
+}
+
+void udp_batch_free(void)
+{
+	myfree(udp_batch);
+	udp_batch = NULL;
+}
+
+/*
+ * Between udp_batch_start() and udp_batch_stop() udp_send() queues the
+ * datagrams of this thread. The outermost stop sends them all at once.
+ */
+void udp_batch_start(void)
+{
+	udp_batch_get()->depth++;
+}
+
+void udp_batch_stop(void)
+{
+	UDP_BATCH *batch = udp_batch_get();
+
+	if (--batch->depth == 0) {
+		udp_flush(batch);
+	}
+}
+
+void udp_send(int sockfd, IP * sa, UCHAR * buffer, LONG size)
+{
+	UDP_BATCH *batch = udp_batch;
+	int i = 0;
+
+	if (!udp_mmsg || batch == NULL || batch->depth == 0 || size > UDP_BUF) {
+		sendto(sockfd, buffer, size, 0,
+		       (const struct sockaddr *)sa, sizeof(IP));
+		return;
+	}
+
+	if (batch->out_size == UDP_MMSG
+	    || (batch->out_size > 0 && batch->out_fd != sockfd)) {
+		udp_flush(batch);
+	}
+
+	i = batch->out_size++;
+	batch->out_fd = sockfd;
+	memcpy(batch->out_buf[i], buffer, size);
+	memcpy(&batch->out_addr[i], sa, sizeof(IP));
+	batch->out_iov[i].iov_base = batch->out_buf[i];
+	batch->out_iov[i].iov_len = size;
+	memset(&batch->out_msg[i], '\0', sizeof(struct mmsghdr));
+	batch->out_msg[i].msg_hdr.msg_name = &batch->out_addr[i];
+	batch->out_msg[i].msg_hdr.msg_namelen = sizeof(IP);
+	batch->out_msg[i].msg_hdr.msg_iov = &batch->out_iov[i];
+	batch->out_msg[i].msg_hdr.msg_iovlen = 1;
+}
+
+void udp_flush(UDP_BATCH * batch)
+{
+	int i = 0;
+	int n = 0;
+
+	while (i < batch->out_size) {
+		n = sendmmsg(batch->out_fd, &batch->out_msg[i],
+			     batch->out_size - i, 0);
+
+		if (n < 0 && errno == ENOSYS) {
+			udp_mmsg = FALSE;
+			for (; i < batch->out_size; i++) {
+				sendto(batch->out_fd, batch->out_buf[i],
+				       batch->out_iov[i].iov_len, 0,
+				       (const struct sockaddr *)
+				       &batch->out_addr[i], sizeof(IP));
+			}
+			break;
+		}
+
+		/* Drop a datagram the kernel refuses like sendto() would */
+		i += (n > 0) ? n : 1;
+	}
+
+	batch->out_size = 0;
 }
 
 #ifdef IPV6
@@ -25,6 +25,9 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #define UDP_BUF 1460
 
+/* Datagrams per recvmmsg() and sendmmsg() */
+#define UDP_MMSG 32
+
 enum {
 	multicast_enabled = 0,
 	multicast_disabled = 1,
@@ -51,9 +54,14 @@ struct obj_udp {
 
 	/* Type of operation */
 	int type;
+
+	/* P2P worker number and transaction shard */
+	int shard;
 };
 typedef struct obj_udp UDP;
 
+typedef struct obj_udp_batch UDP_BATCH;
+
 #include "p2p.h"
 
 UDP *udp_init(void);
@@ -70,8 +78,21 @@ void *udp_client(void *arg);
 void udp_worker(UDP * udp, struct epoll_event *events, int nfds);
 void udp_rearm(UDP * udp, int sockfd);
 
+UDP *udp_own(void);
+
 void udp_input(UDP * udp, int sockfd);
+int udp_input_mmsg(UDP * udp, int sockfd);
+void udp_input_single(UDP * udp, int sockfd);
+void udp_packet(UDP * udp, UCHAR * buffer, size_t bytes, IP * from);
 void udp_cron(UDP * udp);
+int udp_timeout(LONG wait);
+
+UDP_BATCH *udp_batch_get(void);
+void udp_batch_free(void);
+void udp_batch_start(void);
+void udp_batch_stop(void);
+void udp_send(int sockfd, IP * sa, UCHAR * buffer, LONG size);
+void udp_flush(UDP_BATCH * batch);
 
 void udp_multicast(UDP * udp, int mode, int runmode);
 
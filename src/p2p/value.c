@@ -27,8 +27,10 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 VALUE *val_init(void)
 {
 	VALUE *value = (VALUE *) myalloc(sizeof(VALUE));
+	value->mutex = mutex_init();
 	value->list = list_init();
-	value->hash = hash_init(VALUE_SIZE_MAX + 1);
+	value->hash = hash_init_fixed(VALUE_SIZE_MAX + 1, SHA1_SIZE);
+	value->wheel = wheel_init(time_now_sec());
 	return value;
 }
 
@@ -38,6 +40,8 @@ void val_free(void)
 	list_clear(_main->value->list);
 	list_free(_main->value->list);
 	hash_free(_main->value->hash);
+	wheel_free(_main->value->wheel);
+	mutex_destroy(_main->value->mutex);
 	myfree(_main->value);
 }
 
@@ -50,21 +54,50 @@ void val_clean(void)
 
 void val_put(UCHAR * target_id, UCHAR * node_id, int port, IP * from)
 {
-	TARGET_V *target = val_find(target_id);
+	TARGET_V *target = NULL;
+
+	mutex_block(_main->value->mutex);
 
 	/* Create a new target if necessary  */
-	if (target == NULL) {
+	if ((target = val_find(target_id)) == NULL) {
 		target = val_ins_sort(target_id);
 	}
 
 	/* Still NULL:
 	 * That means that the target_id does not match my node_id very well. */
-	if (target == NULL) {
-		return;
+	if (target != NULL) {
+		/* Insert node into the target list */
+		tgt_v_update(target, node_id, from, port);
+	}
+
+	mutex_unblock(_main->value->mutex);
+}
+
+void val_restore(UCHAR * target_id, UCHAR * node_id, UCHAR * pair,
+		 time_t eol)
+{
+	TARGET_V *target = NULL;
+	NODE_V *node = NULL;
+	IP sin;
+
+	ip_tuple_to_sin(&sin, pair);
+
+	mutex_block(_main->value->mutex);
+
+	if ((target = val_find(target_id)) == NULL) {
+		target = val_ins_sort(target_id);
+	}
+
+	if (target != NULL) {
+		tgt_v_update(target, node_id, &sin, ip_sin_to_port(&sin));
+
+		/* Keep the lifetime the announcement had left */
+		node = list_value(tgt_v_find(target, node_id));
+		node->eol = eol;
+		wheel_add(_main->value->wheel, &node->timer, node->eol, 0);
 	}
 
-	/* Insert node into the target list */
-	tgt_v_update(target, node_id, from, port);
+	mutex_unblock(_main->value->mutex);
 }
 
 TARGET_V *val_ins_sort(UCHAR * target_id)
@@ -82,7 +115,7 @@ TARGET_V *val_ins_sort(UCHAR * target_id)
 		if (str_sha1_compare
 		    (target_id, old->target, _main->conf->node_id) < 0) {
 			new = tgt_v_init(target_id);
-			list_ins(_main->value->list, i, new);
+			new->item = list_ins(_main->value->list, i, new);
 			hash_put(_main->value->hash, new->target, SHA1_SIZE,
 				 new);
 
@@ -98,7 +131,7 @@ TARGET_V *val_ins_sort(UCHAR * target_id)
 	 * persist. */
 	if (done == FALSE && list_size(_main->value->list) < VALUE_SIZE_MAX) {
 		new = tgt_v_init(target_id);
-		list_put(_main->value->list, new);
+		new->item = list_put(_main->value->list, new);
 		hash_put(_main->value->hash, new->target, SHA1_SIZE, new);
 
 		done = TRUE;
@@ -127,27 +160,29 @@ void val_del(ITEM * i)
 
 void val_expire(time_t now)
 {
-	ITEM *i = NULL, *n = NULL;
+	ILIST due;
+	TIMER *timer = NULL;
+	NODE_V *node = NULL;
 	TARGET_V *target = NULL;
-	int index = 0;
 
-	i = list_start(_main->value->list);
-	while (i != NULL) {
-		n = list_next(i);
-		target = list_value(i);
+	mutex_block(_main->value->mutex);
 
-		/* Look at the nodes within the target */
-		tgt_v_expire(target, now);
+	/* Delete info_hash after 30 minutes without announcement. */
+	ilist_init(&due);
+	wheel_expire(_main->value->wheel, now, &due);
+	while ((timer = wheel_next(&due)) != NULL) {
+		node = wheel_value(timer, NODE_V, timer);
+		target = node->target;
+
+		tgt_v_del(target, tgt_v_find(target, node->id));
 
 		/* The target contains no more nodes */
-		/* Or the target does not match well enough */
 		if (list_size(target->list) == 0) {
-			val_del(i);
+			val_del(target->item);
 		}
-
-		i = n;
-		index++;
 	}
+
+	mutex_unblock(_main->value->mutex);
 }
 
 void val_print(void)
@@ -183,8 +218,11 @@ int val_compact_list(UCHAR * nodes_compact_list, UCHAR * target_id)
 	int j = 0;
 	int size = 0;
 
+	mutex_block(_main->value->mutex);
+
 	/* Look into the local database */
 	if ((target = val_find(target_id)) == NULL) {
+		mutex_unblock(_main->value->mutex);
 		return 0;
 	}
 
@@ -207,6 +245,8 @@ int val_compact_list(UCHAR * nodes_compact_list, UCHAR * target_id)
 	 * after each request. */
 //      list_rotate( target->list );
 
+	mutex_unblock(_main->value->mutex);
+
 	return size;
 }
 
@@ -221,14 +261,20 @@ TARGET_V *tgt_v_init(UCHAR * target_id)
 
 	memcpy(target->target, target_id, SHA1_SIZE);
 	target->list = list_init();
-	target->hash = hash_init(TGT_V_SIZE_MAX + 1);
+	target->hash = hash_init_fixed(TGT_V_SIZE_MAX + 1, SHA1_SIZE);
 
 	return target;
 }
 
 void tgt_v_free(TARGET_V * target)
 {
-	list_clear(target->list);
+	ITEM *i = NULL;
+
+	i = list_start(target->list);
+	while (i != NULL) {
+		node_v_free(list_value(i));
+		i = list_next(i);
+	}
 	list_free(target->list);
 	hash_free(target->hash);
 	myfree(target);
@@ -240,7 +286,7 @@ void tgt_v_put(TARGET_V * target, UCHAR * node_id, IP * from, int port)
 	ITEM *i = NULL;
 	ITEM *s = NULL;
 
-	node = node_v_init(node_id, from, port);
+	node = node_v_init(target, node_id, from, port);
 	s = list_start(target->list);
 	i = list_ins(target->list, s, node);
 	hash_put(target->hash, node->id, SHA1_SIZE, i);
@@ -260,26 +306,6 @@ void tgt_v_del(TARGET_V * target, ITEM * i)
 	node_v_free(node_v);
 }
 
-void tgt_v_expire(TARGET_V * target, time_t now)
-{
-	ITEM *i = NULL;
-	ITEM *n = NULL;
-	NODE_V *node = NULL;
-
-	i = list_start(target->list);
-	while (i != NULL) {
-		n = list_next(i);
-		node = list_value(i);
-
-		/* Delete info_hash after 30 minutes without announcement. */
-		if (now > node->eol) {
-			tgt_v_del(target, i);
-		}
-
-		i = n;
-	}
-}
-
 void tgt_v_print(TARGET_V * target)
 {
 	ITEM *i = NULL;
@@ -335,16 +361,19 @@ void tgt_v_update(TARGET_V * target, UCHAR * node_id, IP * from, int port)
 
 }
 
-NODE_V *node_v_init(UCHAR * node_id, IP * from, int port)
+NODE_V *node_v_init(TARGET_V * target, UCHAR * node_id, IP * from, int port)
 {
-	NODE_V *node_v = (NODE_V *) myalloc(sizeof(NODE_V));
+	NODE_V *node_v =
+	    (NODE_V *) pool_alloc(POOL_NODE_V, sizeof(NODE_V));
+	node_v->target = target;
 	node_v_update(node_v, node_id, from, port);
 	return node_v;
 }
 
 void node_v_free(NODE_V * node_v)
 {
-	myfree(node_v);
+	wheel_del(&node_v->timer);
+	pool_put(POOL_NODE_V, node_v);
 }
 
 void node_v_update(NODE_V * node_v, UCHAR * node_id, IP * from, int port)
@@ -357,4 +386,5 @@ void node_v_update(NODE_V * node_v, UCHAR * node_id, IP * from, int port)
 
 	memcpy(node_v->id, node_id, SHA1_SIZE);
 	time_add_30_min(&node_v->eol);
+	wheel_add(_main->value->wheel, &node_v->timer, node_v->eol, 0);
 }
@@ -22,6 +22,7 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../shr/list.h"
 #include "../shr/hash.h"
+#include "../shr/wheel.h"
 #include "hex.h"
 #include "../shr/log.h"
 #include "time.h"
@@ -34,18 +35,23 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #define TGT_V_SIZE_MAX 10
 
 struct obj_val {
+	pthread_mutex_t *mutex;
 	LIST *list;
 	HASH *hash;
+	WHEEL *wheel;
 };
 typedef struct obj_val VALUE;
 
 typedef struct {
 	UCHAR target[SHA1_SIZE];
+	ITEM *item;
 	LIST *list;
 	HASH *hash;
 } TARGET_V;
 
 typedef struct {
+	TIMER timer;
+	TARGET_V *target;
 	UCHAR id[SHA1_SIZE];
 	UCHAR pair[IP_SIZE_META_PAIR];
 	time_t eol;
@@ -55,6 +61,8 @@ VALUE *val_init(void);
 void val_free(void);
 void val_clean(void);
 void val_put(UCHAR * target_id, UCHAR * node_id, int port, IP * from);
+void val_restore(UCHAR * target_id, UCHAR * node_id, UCHAR * pair,
+		 time_t eol);
 void val_del(ITEM * i);
 TARGET_V *val_ins_sort(UCHAR * target_id);
 void val_expire(time_t now);
@@ -66,12 +74,11 @@ TARGET_V *tgt_v_init(UCHAR * target_id);
 void tgt_v_free(TARGET_V * target);
 void tgt_v_put(TARGET_V * target, UCHAR * node_id, IP * from, int port);
 void tgt_v_del(TARGET_V * target, ITEM * i);
-void tgt_v_expire(TARGET_V * target, time_t now);
 void tgt_v_print(TARGET_V * target);
 ITEM *tgt_v_find(TARGET_V * target, UCHAR * pair);
 void tgt_v_update(TARGET_V * target, UCHAR * node_id, IP * from, int port);
 
-NODE_V *node_v_init(UCHAR * node_id, IP * from, int port);
+NODE_V *node_v_init(TARGET_V * target, UCHAR * node_id, IP * from, int port);
 void node_v_free(NODE_V * node_v);
 void node_v_update(NODE_V * node_v, UCHAR * node_id, IP * from, int port);
 
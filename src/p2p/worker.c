@@ -48,8 +48,9 @@ struct obj_work *work_init(void)
 	work->id = 0;
 	work->active = 0;
 
-	/* The bootstrap thread immediately stops after the start procedure. */
-	work->number_of_threads = 3;
+	/* P2P workers, DNS server and the bootstrap thread. The bootstrap
+	 * thread immediately stops after the start procedure. */
+	work->number_of_threads = _main->conf->workers + 2;
 	return work;
 }
 
@@ -62,6 +63,7 @@ void work_free(void)
 void work_start(void)
 {
 	int number_of_worker = _main->work->number_of_threads - 1;
+	int i = 0;
 
 	info(_log, NULL, "Worker: %i", number_of_worker);
 
@@ -75,22 +77,26 @@ void work_start(void)
 				   sizeof(pthread_t *));
 
 	/* P2P Server */
-	_main->work->threads[0] = (pthread_t *) myalloc(sizeof(pthread_t));
-	if (pthread_create(_main->work->threads[0], &_main->work->attr,
-			   udp_thread, _main->udp) != 0) {
-		fail("pthread_create()");
+	for (i = 0; i < _main->conf->workers; i++) {
+		_main->work->threads[i] =
+		    (pthread_t *) myalloc(sizeof(pthread_t));
+		if (pthread_create(_main->work->threads[i], &_main->work->attr,
+				   udp_thread, _main->shard[i]) != 0) {
+			fail("pthread_create()");
+		}
 	}
 
 	/* DNS Server */
-	_main->work->threads[1] = (pthread_t *) myalloc(sizeof(pthread_t));
-	if (pthread_create(_main->work->threads[1], &_main->work->attr,
+	_main->work->threads[i] = (pthread_t *) myalloc(sizeof(pthread_t));
+	if (pthread_create(_main->work->threads[i], &_main->work->attr,
 			   udp_thread, _main->dns) != 0) {
 		fail("pthread_create()");
 	}
+	i++;
 
 	/* Send 1st request while the P2P worker is starting */
-	_main->work->threads[2] = (pthread_t *) myalloc(sizeof(pthread_t));
-	if (pthread_create(_main->work->threads[2], &_main->work->attr,
+	_main->work->threads[i] = (pthread_t *) myalloc(sizeof(pthread_t));
+	if (pthread_create(_main->work->threads[i], &_main->work->attr,
 			   udp_client, _main->udp) != 0) {
 		fail("pthread_create()");
 	}
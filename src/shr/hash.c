@@ -19,35 +19,48 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
+#include <time.h>
 
 #include "hash.h"
+#include "random.h"
 
 HASH *hash_init(LONG capacity)
+{
+	return hash_init_fixed(capacity, 0);
+}
+
+HASH *hash_init_fixed(LONG capacity, LONG keysize)
 {
 	HASH *map = myalloc(sizeof(HASH));
+	LONG size = HASH_CAPACITY_MIN;
+
+	/* Round up to the next power of two that keeps the load factor */
+	while (size < LONG_MAX / 2 && size * HASH_LOAD_MAX / 100 < capacity) {
+		size <<= 1;
+	}
 
-	map->size = capacity;
-	map->buckets = myalloc(map->size * sizeof(BUCKET));
+	map->size = size;
+	map->used = 0;
+	map->keysize = keysize;
+	map->mask = size - 1;
+	map->pairs = myalloc(map->size * sizeof(PAIR));
+
+	/* Keys are chosen by remote nodes. Keep them from guessing buckets. */
+	if (keysize != 0) {
+		rand_urandom(&map->seed, sizeof(map->seed));
+	}
 
 	return map;
 }
 
 void hash_free(HASH * map)
 {
-	LONG i = 0;
-	BUCKET *bucket = NULL;
-
 	if (map == NULL) {
 		return;
 	}
 
-	bucket = map->buckets;
-	for (i = 0; i < map->size; i++) {
-		myfree(bucket->pairs);
-		bucket++;
-	}
-
-	myfree(map->buckets);
+	myfree(map->pairs);
 	myfree(map);
 	map = NULL;
 }
@@ -67,17 +80,17 @@ int hash_exists(const HASH * map, UCHAR * key, LONG size)
 
 void *hash_get(const HASH * map, UCHAR * key, LONG size)
 {
-	LONG index = 0;
-	BUCKET *bucket = NULL;
 	PAIR *pair = NULL;
 
 	if (map == NULL || key == NULL) {
 		return NULL;
 	}
 
-	index = hash_this(key, size) % map->size;
-	bucket = &(map->buckets[index]);
-	pair = hash_getpair(bucket, key, size);
+	if (map->keysize != 0 && size != map->keysize) {
+		return NULL;
+	}
+
+	pair = hash_getpair(map, key, size, hash_key(map, key, size));
 
 	if (pair == NULL) {
 		return NULL;
@@ -88,119 +101,149 @@ void *hash_get(const HASH * map, UCHAR * key, LONG size)
 
 int hash_put(HASH * map, UCHAR * key, LONG size, void *value)
 {
-	LONG index = 0;
-	BUCKET *bucket = NULL;
+	ULONG hash = 0;
+	ULONG index = 0;
 	PAIR *pair = NULL;
 
 	if (map == NULL || key == NULL || value == NULL) {
 		return FALSE;
 	}
 
-	index = hash_this(key, size) % map->size;
-	bucket = &(map->buckets[index]);
+	if (map->keysize != 0 && size != map->keysize) {
+		return FALSE;
+	}
+
+	hash = hash_key(map, key, size);
 
 	/* Key already exists */
-	if ((pair = hash_getpair(bucket, key, size)) != NULL) {
+	if ((pair = hash_getpair(map, key, size, hash)) != NULL) {
 		pair->value = value;
 		return TRUE;
 	}
 
-	/* Create new obj_pair */
-	if (bucket->size == 0) {
-		bucket->pairs = myalloc(sizeof(PAIR));
-		bucket->size = 1;
-	} else if (bucket->size == LONG_MAX) {
-		/* Overflow */
-		return FALSE;
-	} else {
-		bucket->pairs =
-		    myrealloc(bucket->pairs, (bucket->size + 1) * sizeof(PAIR));
-		bucket->size++;
+	/* Keep the load factor low enough for short probe sequences */
+	if ((map->used + 1) * 100 > map->size * HASH_LOAD_MAX) {
+		if (map->size >= LONG_MAX / 2) {
+			/* Overflow */
+			return FALSE;
+		}
+		hash_grow(map);
+	}
+
+	/* Find the first free slot */
+	index = hash & map->mask;
+	while (map->pairs[index].key != NULL) {
+		index = (index + 1) & map->mask;
 	}
 
 	/* Store key pairs */
-	pair = &(bucket->pairs[bucket->size - 1]);
+	pair = &map->pairs[index];
 	pair->key = key;
 	pair->size = size;
+	pair->hash = hash;
 	pair->value = value;
+	map->used++;
 
 	return TRUE;
 }
 
 void hash_del(HASH * map, UCHAR * key, LONG size)
 {
-	BUCKET *bucket = NULL;
-	PAIR *thispair = NULL;
-	PAIR *oldpair = NULL;
-	PAIR *newpair = NULL;
-	PAIR *p_old = NULL;
-	PAIR *p_new = NULL;
-	LONG index = 0;
-	LONG i = 0;
+	PAIR *pair = NULL;
+	ULONG hole = 0;
+	ULONG index = 0;
+	ULONG home = 0;
 
 	if (map == NULL || key == NULL) {
 		return;
 	}
 
-	/* Compute bucket */
-	index = hash_this(key, size) % map->size;
-	bucket = &(map->buckets[index]);
+	if (map->keysize != 0 && size != map->keysize) {
+		return;
+	}
 
 	/* Not found */
-	if ((thispair = hash_getpair(bucket, key, size)) == NULL) {
+	pair = hash_getpair(map, key, size, hash_key(map, key, size));
+	if (pair == NULL) {
 		return;
 	}
 
-	if (bucket->size == 1) {
-		myfree(bucket->pairs);
-		bucket->pairs = NULL;
-		bucket->size = 0;
-	} else if (bucket->size > 1) {
-		/* Get new memory and remember the old one */
-		oldpair = bucket->pairs;
-		newpair = myalloc((bucket->size - 1) * sizeof(PAIR));
-
-		/* Copy pairs except the one to delete */
-		p_old = oldpair;
-		p_new = newpair;
-		for (i = 0; i < bucket->size; i++) {
-			if (p_old != thispair) {
-				memcpy(p_new++, p_old, sizeof(PAIR));
-			}
-
-			p_old++;
+	/* Shift the rest of the probe sequence back into the hole. A pair may
+	 * only move if its home slot does not lie between the hole and its
+	 * current position. */
+	hole = pair - map->pairs;
+	index = hole;
+	for (;;) {
+		index = (index + 1) & map->mask;
+		pair = &map->pairs[index];
+
+		if (pair->key == NULL) {
+			break;
 		}
 
-		myfree(oldpair);
-		bucket->pairs = newpair;
-		bucket->size--;
+		home = pair->hash & map->mask;
+		if (((index - home) & map->mask) >= ((index - hole) & map->mask)) {
+			memcpy(&map->pairs[hole], pair, sizeof(PAIR));
+			hole = index;
+		}
 	}
+
+	memset(&map->pairs[hole], '\0', sizeof(PAIR));
+	map->used--;
 }
 
-PAIR *hash_getpair(BUCKET * bucket, UCHAR * key, LONG size)
+PAIR *hash_getpair(const HASH * map, UCHAR * key, LONG size, ULONG hash)
 {
-	LONG i = 0;
+	ULONG index = hash & map->mask;
 	PAIR *pair = NULL;
 
-	if (bucket->size == 0) {
-		return NULL;
-	}
+	for (;;) {
+		pair = &map->pairs[index];
+
+		if (pair->key == NULL) {
+			return NULL;
+		}
 
-	pair = bucket->pairs;
-	for (i = 0; i < bucket->size; i++) {
-		if (pair->size == size) {
-			if (pair->key != NULL && pair->value != NULL) {
-				if (memcmp(pair->key, key, size) == 0) {
-					return pair;
-				}
+		if (pair->hash == hash && pair->size == size) {
+			if (hash_equal(pair->key, key, size)) {
+				return pair;
 			}
 		}
-		pair++;
+
+		index = (index + 1) & map->mask;
 	}
 
 	return NULL;
 }
 
+void hash_grow(HASH * map)
+{
+	PAIR *old = map->pairs;
+	LONG size = map->size;
+	ULONG index = 0;
+	LONG i = 0;
+
+	map->size = size << 1;
+	map->mask = map->size - 1;
+	map->pairs = myalloc(map->size * sizeof(PAIR));
+
+	/* Rehash. The stored hash values make this a pure copy. */
+	for (i = 0; i < size; i++) {
+		if (old[i].key == NULL) {
+			continue;
+		}
+
+		index = old[i].hash & map->mask;
+		while (map->pairs[index].key != NULL) {
+			index = (index + 1) & map->mask;
+		}
+
+		memcpy(&map->pairs[index], &old[i], sizeof(PAIR));
+	}
+
+	myfree(old);
+}
+
 ULONG hash_this(UCHAR * key, LONG size)
 {
 	ULONG result = 5381;
@@ -212,3 +255,65 @@ ULONG hash_this(UCHAR * key, LONG size)
 
 	return result;
 }
+
+ULONG hash_word(ULONG seed, UCHAR * key, LONG size)
+{
+	uint64_t result = seed;
+	uint64_t word = 0;
+	UINT half = 0;
+	LONG i = 0;
+
+	/* Every word of the key counts. The last one may overlap. */
+	if (size >= (LONG) sizeof(uint64_t)) {
+		for (i = 0; i + (LONG) sizeof(uint64_t) < size;
+		     i += sizeof(uint64_t)) {
+			memcpy(&word, key + i, sizeof(uint64_t));
+			result = hash_mix(result ^ word);
+		}
+		memcpy(&word, key + size - sizeof(uint64_t), sizeof(uint64_t));
+		result ^= word;
+	} else if (size >= (LONG) sizeof(UINT)) {
+		memcpy(&half, key + size - sizeof(UINT), sizeof(UINT));
+		result ^= half;
+	} else {
+		result ^= hash_this(key, size);
+	}
+
+	return hash_mix(result);
+}
+
+/* The 64 bit finalizer of MurmurHash3 */
+ULONG hash_mix(uint64_t word)
+{
+	word ^= word >> 33;
+	word *= 0xff51afd7ed558ccdULL;
+	word ^= word >> 33;
+	word *= 0xc4ceb9fe1a85ec53ULL;
+	word ^= word >> 33;
+
+	return word;
+}
+
+ULONG hash_key(const HASH * map, UCHAR * key, LONG size)
+{
+	if (map->keysize != 0) {
+		return hash_word(map->seed, key, size);
+	}
+
+	return hash_this(key, size);
+}
+
+int hash_equal(const UCHAR * key1, const UCHAR * key2, LONG size)
+{
+	/* Constant sizes let the compiler replace memcmp with wide compares */
+	switch (size) {
+	case SHA1_SIZE:
+		return memcmp(key1, key2, SHA1_SIZE) == 0;
+	case 8:
+		return memcmp(key1, key2, 8) == 0;
+	case 4:
+		return memcmp(key1, key2, 4) == 0;
+	default:
+		return memcmp(key1, key2, size) == 0;
+	}
+}
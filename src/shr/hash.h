@@ -20,29 +20,49 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef HASH_H
 #define HASH_H
 
+#include <stdint.h>
+
 #include "malloc.h"
 
+/* Open addressing with linear probing. The capacity is always a power of two
+ * and the table grows as soon as it gets filled beyond HASH_LOAD_MAX percent.
+ * Deleted pairs are removed in place by shifting the following pairs of the
+ * probe sequence back, so there are no tombstones.
+ *
+ * Tables created with hash_init_fixed() only accept keys of exactly keysize
+ * bytes (SHA1 ids, tokens, transaction ids). Those keys come from remote
+ * nodes, so they get hashed a word at a time with a secret seed per table
+ * instead of djb2. */
+#define HASH_CAPACITY_MIN 8
+#define HASH_LOAD_MAX 75
+
 typedef struct {
 	UCHAR *key;
-	LONG size;
 	void *value;
+	ULONG hash;
+	LONG size;
 } PAIR;
 
 typedef struct {
 	PAIR *pairs;
 	LONG size;
-} BUCKET;
-
-typedef struct {
-	BUCKET *buckets;
-	LONG size;
+	LONG used;
+	LONG keysize;
+	ULONG mask;
+	ULONG seed;
 } HASH;
 
 HASH *hash_init(LONG capacity);
+HASH *hash_init_fixed(LONG capacity, LONG keysize);
 void hash_free(HASH * map);
 
 ULONG hash_this(UCHAR * key, LONG size);
-PAIR *hash_getpair(BUCKET * bucket, UCHAR * key, LONG size);
+ULONG hash_word(ULONG seed, UCHAR * key, LONG size);
+ULONG hash_mix(uint64_t word);
+ULONG hash_key(const HASH * map, UCHAR * key, LONG size);
+int hash_equal(const UCHAR * key1, const UCHAR * key2, LONG size);
+PAIR *hash_getpair(const HASH * map, UCHAR * key, LONG size, ULONG hash);
+void hash_grow(HASH * map);
 
 void *hash_get(const HASH * map, UCHAR * key, LONG size);
 int hash_put(HASH * map, UCHAR * key, LONG size, void *value);
@@ -27,6 +27,7 @@ LIST *list_init(void)
 	LIST *list = (LIST *) myalloc(sizeof(LIST));
 
 	list->item = NULL;
+	list->stop = NULL;
 	list->size = 0;
 
 	return list;
@@ -62,46 +63,20 @@ void list_clear(LIST * list)
 
 ITEM *list_start(LIST * list)
 {
-	ITEM *item = NULL;
-
 	if (list == NULL) {
 		return NULL;
 	}
 
-	if (list->item == NULL) {
-		return NULL;
-	}
-
-	item = list->item;
-	while (item->prev != NULL) {
-		item = list_prev(item);
-	}
-
-	if (item != list->item) {
-		list->item = item;
-	}
-
-	return item;
+	return list->item;
 }
 
 ITEM *list_stop(LIST * list)
 {
-	ITEM *item = NULL;
-
 	if (list == NULL) {
 		return NULL;
 	}
 
-	if (list->item == NULL) {
-		return NULL;
-	}
-
-	item = list->item;
-	while (item->next != NULL) {
-		item = list_next(item);
-	}
-
-	return item;
+	return list->stop;
 }
 
 LONG list_size(LIST * list)
@@ -112,7 +87,6 @@ LONG list_size(LIST * list)
 ITEM *list_put(LIST * list, void *payload)
 {
 	ITEM *item = NULL;
-	ITEM *stop = NULL;
 
 	if (list == NULL) {
 		return NULL;
@@ -122,23 +96,19 @@ ITEM *list_put(LIST * list, void *payload)
 		return NULL;
 	}
 
-	item = (ITEM *) myalloc(sizeof(ITEM));
+	item = (ITEM *) pool_alloc(POOL_ITEM, sizeof(ITEM));
 	item->val = payload;
 	item->next = NULL;
-	item->prev = NULL;
+	item->prev = list->stop;
 
 	/* First item? */
-	if (list->item == NULL) {
+	if (list->stop == NULL) {
 		list->item = item;
-		list->size = 1;
-		return item;
+	} else {
+		list->stop->next = item;
 	}
 
-	stop = list_stop(list);
-
-	item->prev = stop;
-	stop->next = item;
-
+	list->stop = item;
 	list->size += 1;
 
 	return item;
@@ -162,7 +132,7 @@ ITEM *list_ins(LIST * list, ITEM * here, void *payload)
 	}
 
 	/* Payload */
-	item = (ITEM *) myalloc(sizeof(ITEM));
+	item = (ITEM *) pool_alloc(POOL_ITEM, sizeof(ITEM));
 	item->val = payload;
 
 	/* Pointer */
@@ -175,6 +145,8 @@ ITEM *list_ins(LIST * list, ITEM * here, void *payload)
 
 	if (prev != NULL) {
 		prev->next = item;
+	} else {
+		list->item = item;
 	}
 
 	list->size += 1;
@@ -200,7 +172,7 @@ ITEM *list_add(LIST * list, ITEM * here, void *payload)
 	}
 
 	/* Payload */
-	item = (ITEM *) myalloc(sizeof(ITEM));
+	item = (ITEM *) pool_alloc(POOL_ITEM, sizeof(ITEM));
 	item->val = payload;
 
 	/* Pointer */
@@ -213,6 +185,8 @@ ITEM *list_add(LIST * list, ITEM * here, void *payload)
 
 	if (next != NULL) {
 		next->prev = item;
+	} else {
+		list->stop = item;
 	}
 
 	list->size += 1;
@@ -229,19 +203,19 @@ ITEM *list_del(LIST * list, ITEM * item)
 		return NULL;
 	}
 
-	if (item->next == NULL && item->prev == NULL) {
-		list->item = NULL;
-	} else if (item->next == NULL) {
-		item->prev->next = NULL;
-	} else if (item->prev == NULL) {
+	if (item->prev == NULL) {
 		list->item = item->next;
-		item->next->prev = NULL;
 	} else {
 		item->prev->next = item->next;
+	}
+
+	if (item->next == NULL) {
+		list->stop = item->prev;
+	} else {
 		item->next->prev = item->prev;
 	}
 
-	myfree(item);
+	pool_put(POOL_ITEM, item);
 
 	list->size -= 1;
 
@@ -289,9 +263,140 @@ void list_rotate(LIST * list)
 	stop = list_stop(list);
 
 	list->item = start->next;
+	list->stop = start;
 
 	start->next->prev = NULL;
 	start->next = NULL;
 	start->prev = stop;
 	stop->next = start;
 }
+
+void ilist_init(ILIST * list)
+{
+	list->start = NULL;
+	list->stop = NULL;
+	list->size = 0;
+}
+
+ILINK *ilist_start(ILIST * list)
+{
+	if (list == NULL) {
+		return NULL;
+	}
+
+	return list->start;
+}
+
+ILINK *ilist_stop(ILIST * list)
+{
+	if (list == NULL) {
+		return NULL;
+	}
+
+	return list->stop;
+}
+
+LONG ilist_size(ILIST * list)
+{
+	return list->size;
+}
+
+ILINK *ilist_put(ILIST * list, ILINK * link)
+{
+	if (list == NULL || link == NULL) {
+		return NULL;
+	}
+
+	if (ilist_size(list) == LONG_MAX) {
+		return NULL;
+	}
+
+	link->next = NULL;
+	link->prev = list->stop;
+
+	if (list->stop == NULL) {
+		list->start = link;
+	} else {
+		list->stop->next = link;
+	}
+
+	list->stop = link;
+	list->size += 1;
+
+	return link;
+}
+
+ILINK *ilist_ins(ILIST * list, ILINK * here, ILINK * link)
+{
+	if (list == NULL || link == NULL) {
+		return NULL;
+	}
+
+	if (ilist_size(list) == LONG_MAX) {
+		return NULL;
+	}
+
+	if (here == NULL) {
+		return ilist_put(list, link);
+	}
+
+	link->next = here;
+	link->prev = here->prev;
+
+	if (here->prev == NULL) {
+		list->start = link;
+	} else {
+		here->prev->next = link;
+	}
+	here->prev = link;
+
+	list->size += 1;
+
+	return link;
+}
+
+ILINK *ilist_del(ILIST * list, ILINK * link)
+{
+	ILINK *next = NULL;
+
+	if (list == NULL || link == NULL) {
+		return NULL;
+	}
+
+	next = link->next;
+
+	if (link->prev == NULL) {
+		list->start = link->next;
+	} else {
+		link->prev->next = link->next;
+	}
+
+	if (link->next == NULL) {
+		list->stop = link->prev;
+	} else {
+		link->next->prev = link->prev;
+	}
+
+	link->next = NULL;
+	link->prev = NULL;
+
+	list->size -= 1;
+
+	return next;
+}
+
+ILINK *ilist_next(ILINK * link)
+{
+	if (link == NULL) {
+		return NULL;
+	}
+	return link->next;
+}
+
+ILINK *ilist_prev(ILINK * link)
+{
+	if (link == NULL) {
+		return NULL;
+	}
+	return link->prev;
+}
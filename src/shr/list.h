@@ -20,7 +20,10 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef LIST_H
 #define LIST_H
 
+#include <stddef.h>
+
 #include "malloc.h"
+#include "pool.h"
 
 #ifdef NSS
 #define list_add _nss_tk_list_add
@@ -37,10 +40,22 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #define list_start _nss_tk_list_start
 #define list_stop _nss_tk_list_stop
 #define list_value _nss_tk_list_value
+#define ilist_init _nss_tk_ilist_init
+#define ilist_start _nss_tk_ilist_start
+#define ilist_stop _nss_tk_ilist_stop
+#define ilist_size _nss_tk_ilist_size
+#define ilist_put _nss_tk_ilist_put
+#define ilist_ins _nss_tk_ilist_ins
+#define ilist_del _nss_tk_ilist_del
+#define ilist_next _nss_tk_ilist_next
+#define ilist_prev _nss_tk_ilist_prev
 #endif
 
+/* The list remembers its first (item) and its last (stop) element, so
+ * appending and removing never walks the list. */
 struct obj_list {
 	struct obj_item *item;
+	struct obj_item *stop;
 	LONG size;
 };
 typedef struct obj_list LIST;
@@ -73,4 +88,37 @@ void list_rotate(LIST * list);
 
 void *list_value(ITEM * item);
 
+/* Intrusive list: The payload embeds an ILINK and the list only chains
+ * those links together. Inserting or removing an object never allocates.
+ * ilist_value() converts a link back into its payload. */
+struct obj_ilink {
+	struct obj_ilink *next;
+	struct obj_ilink *prev;
+};
+typedef struct obj_ilink ILINK;
+
+struct obj_ilist {
+	ILINK *start;
+	ILINK *stop;
+	LONG size;
+};
+typedef struct obj_ilist ILIST;
+
+#define ilist_value(link, type, member) \
+	((link) == NULL ? NULL : \
+	 (type *)((char *)(link) - offsetof(type, member)))
+
+void ilist_init(ILIST * list);
+
+ILINK *ilist_start(ILIST * list);
+ILINK *ilist_stop(ILIST * list);
+LONG ilist_size(ILIST * list);
+
+ILINK *ilist_put(ILIST * list, ILINK * link);
+ILINK *ilist_ins(ILIST * list, ILINK * here, ILINK * link);
+ILINK *ilist_del(ILIST * list, ILINK * link);
+
+ILINK *ilist_next(ILINK * link);
+ILINK *ilist_prev(ILINK * link);
+
 #endif
@@ -0,0 +1,204 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pool.h"
+
+#define POOL_ENTRY(n) { .name = n, .mutex = PTHREAD_MUTEX_INITIALIZER }
+
+static POOL pools[POOL_MAX] = {
+	[POOL_ITEM] = POOL_ENTRY("ITEM"),
+#ifdef TORRENTKINO
+	[POOL_NODE_C] = POOL_ENTRY("NODE_C"),
+	[POOL_NODE_V] = POOL_ENTRY("NODE_V"),
+#elif TUMBLEWEED
+	[POOL_RESPONSE] = POOL_ENTRY("RESPONSE"),
+	[POOL_TCP_NODE] = POOL_ENTRY("TCP_NODE"),
+#endif
+};
+
+/* Per thread free lists. Only touched by the owning thread. */
+static __thread POOL_CACHE_T pool_cache[POOL_MAX];
+
+void *pool_alloc(int type, LONG size)
+{
+	POOL *pool = &pools[type];
+	POOL_CACHE_T *cache = &pool_cache[type];
+	POOL_LINK *link = NULL;
+	LONG live = 0;
+
+	if (cache->free == NULL) {
+		pool_refill(pool, cache, size);
+	}
+
+	link = cache->free;
+	cache->free = link->next;
+	cache->free_size--;
+
+	/* The peak is statistics only. A lost update does not matter. */
+	live = __sync_add_and_fetch(&pool->live, 1);
+	if (live > pool->peak) {
+		pool->peak = live;
+	}
+
+	memset(link, '\0', size);
+
+	return link;
+}
+
+void pool_put(int type, void *arg)
+{
+	POOL *pool = &pools[type];
+	POOL_CACHE_T *cache = &pool_cache[type];
+	POOL_LINK *link = arg;
+
+	if (arg == NULL) {
+		return;
+	}
+
+	link->next = cache->free;
+	cache->free = link;
+	cache->free_size++;
+
+	__sync_sub_and_fetch(&pool->live, 1);
+
+	if (cache->free_size > POOL_CACHE) {
+		pool_flush(pool, cache);
+	}
+}
+
+void pool_refill(POOL * pool, POOL_CACHE_T * cache, LONG size)
+{
+	POOL_LINK *first = NULL;
+	POOL_LINK *last = NULL;
+	LONG i = 0;
+
+	/* Round up to keep every object aligned */
+	size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+	pthread_mutex_lock(&pool->mutex);
+
+	if (pool->size == 0) {
+		pool->size = size;
+	} else if (pool->size != size) {
+		fail("pool_refill(): Size mismatch in pool %s", pool->name);
+	}
+
+	while (pool->free_size < POOL_BATCH) {
+		pool_slab(pool);
+	}
+
+	/* Detach a batch from the shared list */
+	first = pool->free;
+	last = first;
+	for (i = 1; i < POOL_BATCH; i++) {
+		last = last->next;
+	}
+	pool->free = last->next;
+	pool->free_size -= POOL_BATCH;
+
+	pthread_mutex_unlock(&pool->mutex);
+
+	last->next = cache->free;
+	cache->free = first;
+	cache->free_size += POOL_BATCH;
+}
+
+void pool_flush(POOL * pool, POOL_CACHE_T * cache)
+{
+	POOL_LINK *first = cache->free;
+	POOL_LINK *last = first;
+	LONG i = 0;
+
+	/* Hand a batch back to the shared list */
+	for (i = 1; i < POOL_BATCH; i++) {
+		last = last->next;
+	}
+	cache->free = last->next;
+	cache->free_size -= POOL_BATCH;
+
+	pthread_mutex_lock(&pool->mutex);
+	last->next = pool->free;
+	pool->free = first;
+	pool->free_size += POOL_BATCH;
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void pool_slab(POOL * pool)
+{
+	UCHAR *slab = myalloc(POOL_SLAB * pool->size);
+	POOL_LINK *link = NULL;
+	LONG i = 0;
+
+	pool->slabs =
+	    (UCHAR **) myrealloc(pool->slabs,
+				 (pool->slabs_size + 1) * sizeof(UCHAR *));
+	pool->slabs[pool->slabs_size] = slab;
+	pool->slabs_size++;
+
+	for (i = POOL_SLAB - 1; i >= 0; i--) {
+		link = (POOL_LINK *) (slab + i * pool->size);
+		link->next = pool->free;
+		pool->free = link;
+	}
+	pool->free_size += POOL_SLAB;
+}
+
+void pool_free(void)
+{
+	POOL *pool = NULL;
+	LONG i = 0;
+	int type = 0;
+
+	/* The worker threads are gone. Their caches point into the slabs. */
+	for (type = 0; type < POOL_MAX; type++) {
+		pool = &pools[type];
+
+		pthread_mutex_lock(&pool->mutex);
+		for (i = 0; i < pool->slabs_size; i++) {
+			myfree(pool->slabs[i]);
+		}
+		myfree(pool->slabs);
+		pool->slabs = NULL;
+		pool->slabs_size = 0;
+		pool->free = NULL;
+		pool->free_size = 0;
+		pthread_mutex_unlock(&pool->mutex);
+
+		pool_cache[type].free = NULL;
+		pool_cache[type].free_size = 0;
+	}
+}
+
+void pool_print(void)
+{
+	POOL *pool = NULL;
+	int type = 0;
+
+	for (type = 0; type < POOL_MAX; type++) {
+		pool = &pools[type];
+		info(_log, NULL,
+		     "Pool %s: %li live, %li peak, %li slabs, %li bytes",
+		     pool->name, pool->live, pool->peak, pool->slabs_size,
+		     pool->slabs_size * POOL_SLAB * pool->size);
+	}
+}
@@ -0,0 +1,89 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <pthread.h>
+
+#include "config.h"
+#include "malloc.h"
+#include "log.h"
+#include "fail.h"
+
+/* Objects per slab */
+#define POOL_SLAB 128
+
+/* Objects a thread keeps for itself before handing some back */
+#define POOL_CACHE 64
+#define POOL_BATCH 32
+
+/* Hot fixed-size objects */
+#define POOL_ITEM 0
+#ifdef TORRENTKINO
+#define POOL_NODE_C 1
+#define POOL_NODE_V 2
+#define POOL_MAX 3
+#elif TUMBLEWEED
+#define POOL_RESPONSE 1
+#define POOL_TCP_NODE 2
+#define POOL_MAX 3
+#endif
+
+struct obj_pool_link {
+	struct obj_pool_link *next;
+};
+typedef struct obj_pool_link POOL_LINK;
+
+struct obj_pool {
+	const char *name;
+	LONG size;
+
+	pthread_mutex_t mutex;
+
+	/* Shared free list, refilled from new slabs */
+	POOL_LINK *free;
+	LONG free_size;
+
+	/* Slabs are never returned to the system before pool_free() */
+	UCHAR **slabs;
+	LONG slabs_size;
+
+	/* Objects handed out to callers */
+	LONG live;
+	LONG peak;
+};
+typedef struct obj_pool POOL;
+
+struct obj_pool_cache {
+	POOL_LINK *free;
+	LONG free_size;
+};
+typedef struct obj_pool_cache POOL_CACHE_T;
+
+void *pool_alloc(int type, LONG size);
+void pool_put(int type, void *arg);
+void pool_free(void);
+void pool_print(void);
+
+void pool_refill(POOL * pool, POOL_CACHE_T * cache, LONG size);
+void pool_flush(POOL * pool, POOL_CACHE_T * cache);
+void pool_slab(POOL * pool);
+
+#endif				/* POOL_H */
@@ -25,18 +25,130 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include <time.h>
 #include <signal.h>
 #include <netinet/in.h>
+#include <sys/random.h>
 
 #include "random.h"
 
+#define RAND_ROTL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define RAND_QR(a, b, c, d) \
+	a += b; d ^= a; d = RAND_ROTL(d, 16); \
+	c += d; b ^= c; b = RAND_ROTL(b, 12); \
+	a += b; d ^= a; d = RAND_ROTL(d, 8); \
+	c += d; b ^= c; b = RAND_ROTL(b, 7)
+
+static __thread RAND rand_self;
+
 void rand_urandom(void *buffer, size_t size)
 {
+	RAND *r = &rand_self;
+	UCHAR *p = buffer;
+	size_t chunk = 0;
+
+	while (size > 0) {
+		if (r->offset == 0 || r->offset >= RAND_BUFFER_SIZE) {
+			rand_refill(r);
+		}
+
+		chunk = RAND_BUFFER_SIZE - r->offset;
+		if (chunk > size) {
+			chunk = size;
+		}
+
+		/* Never hand out the same bytes twice */
+		memcpy(p, r->buffer + r->offset, chunk);
+		memset(r->buffer + r->offset, '\0', chunk);
+
+		r->offset += chunk;
+		p += chunk;
+		size -= chunk;
+	}
+}
+
+void rand_refill(RAND * r)
+{
+	uint32_t state[16];
+	int i = 0;
+
+	if (!r->seeded || r->refills >= RAND_RESEED) {
+		rand_seed(r);
+	}
+
+	/* "expand 32-byte k", key, block counter, nonce */
+	state[0] = 0x61707865;
+	state[1] = 0x3320646e;
+	state[2] = 0x79622d32;
+	state[3] = 0x6b206574;
+	memcpy(&state[4], r->key, RAND_KEY_SIZE);
+	state[13] = 0;
+	state[14] = 0;
+	state[15] = 0;
+
+	for (i = 0; i < RAND_BLOCKS; i++) {
+		state[12] = i;
+		rand_chacha20(state, r->buffer + i * RAND_BLOCK_SIZE);
+	}
+
+	/* The old key is gone. Past output cannot be recomputed. */
+	memcpy(r->key, r->buffer, RAND_KEY_SIZE);
+	memset(r->buffer, '\0', RAND_KEY_SIZE);
+	memset(state, '\0', sizeof(state));
+	r->offset = RAND_KEY_SIZE;
+	r->refills++;
+}
+
+void rand_seed(RAND * r)
+{
+	UCHAR seed[RAND_KEY_SIZE];
 	UCHAR *random = NULL;
+	UCHAR *key = (UCHAR *) r->key;
+	int i = 0;
+
+	if (getrandom(seed, RAND_KEY_SIZE, 0) != RAND_KEY_SIZE) {
 
-	if ((random = (UCHAR *) file_load("/dev/urandom", 0, size)) == NULL) {
-		fail("Failed to read /dev/urandom");
+		/* Old kernel */
+		if ((random = (UCHAR *) file_load("/dev/urandom", 0,
+						  RAND_KEY_SIZE)) == NULL) {
+			fail("Failed to read /dev/urandom");
+		}
+		memcpy(seed, random, RAND_KEY_SIZE);
+		myfree(random);
 	}
 
-	memcpy(buffer, random, size);
+	/* Mix, do not replace. The old key still counts. */
+	for (i = 0; i < RAND_KEY_SIZE; i++) {
+		key[i] ^= seed[i];
+	}
+	memset(seed, '\0', RAND_KEY_SIZE);
 
-	myfree(random);
+	r->seeded = TRUE;
+	r->refills = 0;
+}
+
+/* One ChaCha20 block (RFC 7539) */
+void rand_chacha20(uint32_t * state, UCHAR * out)
+{
+	uint32_t x[16];
+	int i = 0;
+
+	memcpy(x, state, sizeof(x));
+
+	for (i = 0; i < 10; i++) {
+		RAND_QR(x[0], x[4], x[8], x[12]);
+		RAND_QR(x[1], x[5], x[9], x[13]);
+		RAND_QR(x[2], x[6], x[10], x[14]);
+		RAND_QR(x[3], x[7], x[11], x[15]);
+		RAND_QR(x[0], x[5], x[10], x[15]);
+		RAND_QR(x[1], x[6], x[11], x[12]);
+		RAND_QR(x[2], x[7], x[8], x[13]);
+		RAND_QR(x[3], x[4], x[9], x[14]);
+	}
+
+	for (i = 0; i < 16; i++) {
+		x[i] += state[i];
+		out[4 * i] = x[i] & 0xFF;
+		out[4 * i + 1] = (x[i] >> 8) & 0xFF;
+		out[4 * i + 2] = (x[i] >> 16) & 0xFF;
+		out[4 * i + 3] = (x[i] >> 24) & 0xFF;
+	}
 }
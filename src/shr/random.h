@@ -20,14 +20,41 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef RAND_H
 #define RAND_H
 
+#include <stdint.h>
+
 #include "config.h"
 #include "file.h"
 #include "fail.h"
 
+/*
+ * ChaCha20 keystream, one per thread. Every refill makes RAND_BLOCKS blocks
+ * and takes the first 32 bytes as the next key. Bytes handed out are wiped.
+ * Fresh entropy from the kernel gets mixed into the key every RAND_RESEED
+ * refills.
+ */
+#define RAND_KEY_SIZE 32
+#define RAND_BLOCK_SIZE 64
+#define RAND_BLOCKS 8
+#define RAND_BUFFER_SIZE (RAND_BLOCKS * RAND_BLOCK_SIZE)
+#define RAND_RESEED 4096
+
 #ifdef NSS
 #define rand_urandom _nss_tk_rand_urandom
 #endif
 
+struct obj_rand {
+	uint32_t key[RAND_KEY_SIZE / 4];
+	UCHAR buffer[RAND_BUFFER_SIZE];
+	size_t offset;
+	LONG refills;
+	int seeded;
+};
+typedef struct obj_rand RAND;
+
 void rand_urandom(void *buffer, size_t size);
 
+void rand_refill(RAND * r);
+void rand_seed(RAND * r);
+void rand_chacha20(uint32_t * state, UCHAR * out);
+
 #endif
@@ -0,0 +1,193 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "wheel.h"
+
+WHEEL *wheel_init(time_t now)
+{
+	WHEEL *w = (WHEEL *) myalloc(sizeof(WHEEL));
+	int level = 0;
+	int i = 0;
+
+	w->now = now;
+	for (level = 0; level < WHEEL_LEVELS; level++) {
+		for (i = 0; i < WHEEL_SIZE; i++) {
+			ilist_init(&w->slot[level][i]);
+		}
+	}
+
+	return w;
+}
+
+/* The owner frees the objects the timers are embedded into */
+void wheel_free(WHEEL * w)
+{
+	myfree(w);
+}
+
+/* The timer fires as soon as now > due */
+void wheel_add(WHEEL * w, TIMER * timer, time_t due, int type)
+{
+	wheel_del(timer);
+
+	timer->due = due;
+	timer->type = type;
+
+	/* The current second has been handled already */
+	wheel_link(w, timer, w->now + 1);
+}
+
+void wheel_del(TIMER * timer)
+{
+	if (timer->list == NULL) {
+		return;
+	}
+
+	ilist_del(timer->list, &timer->link);
+	timer->list = NULL;
+}
+
+int wheel_pending(TIMER * timer)
+{
+	return timer->list != NULL;
+}
+
+/* Move every timer that fired up to now into due. They stay linked there
+ * until wheel_next() or wheel_del() takes them out again. */
+void wheel_expire(WHEEL * w, time_t now, ILIST * due)
+{
+	while (w->now < now) {
+		wheel_tick(w, due);
+	}
+}
+
+/* The first tick at which wheel_expire() may fire a timer. Exact within
+ * level 0, the next cascade beyond that. -1 if the wheel is empty. */
+time_t wheel_due(WHEEL * w)
+{
+	int level = 0;
+	int i = 0;
+
+	for (i = 1; i < WHEEL_SIZE; i++) {
+		if (ilist_start(&w->slot[0][(w->now + i) & WHEEL_MASK]) != NULL) {
+			return w->now + i;
+		}
+	}
+
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		for (i = 0; i < WHEEL_SIZE; i++) {
+			if (ilist_start(&w->slot[level][i]) != NULL) {
+				return ((w->now >> WHEEL_BITS) + 1) << WHEEL_BITS;
+			}
+		}
+	}
+
+	return -1;
+}
+
+TIMER *wheel_next(ILIST * due)
+{
+	TIMER *timer = NULL;
+	ILINK *link = NULL;
+
+	if ((link = ilist_start(due)) == NULL) {
+		return NULL;
+	}
+
+	timer = ilist_value(link, TIMER, link);
+	wheel_del(timer);
+
+	return timer;
+}
+
+void wheel_tick(WHEEL * w, ILIST * due)
+{
+	ILIST *slot = NULL;
+	ILINK *link = NULL;
+	TIMER *timer = NULL;
+	int level = 0;
+
+	w->now++;
+
+	/* Pull the next slot of every level that wrapped. Upper levels first,
+	 * because they feed the ones below. */
+	for (level = 1; level < WHEEL_LEVELS; level++) {
+		if ((w->now >> (WHEEL_BITS * level - WHEEL_BITS)) & WHEEL_MASK) {
+			break;
+		}
+	}
+	for (level--; level >= 1; level--) {
+		wheel_cascade(w, level);
+	}
+
+	slot = &w->slot[0][w->now & WHEEL_MASK];
+	while ((link = ilist_start(slot)) != NULL) {
+		timer = ilist_value(link, TIMER, link);
+		ilist_del(slot, link);
+		ilist_put(due, link);
+		timer->list = due;
+	}
+}
+
+void wheel_cascade(WHEEL * w, int level)
+{
+	ILIST *slot = NULL;
+	ILINK *link = NULL;
+	TIMER *timer = NULL;
+
+	slot = &w->slot[level][(w->now >> (WHEEL_BITS * level)) & WHEEL_MASK];
+	while ((link = ilist_start(slot)) != NULL) {
+		timer = ilist_value(link, TIMER, link);
+		ilist_del(slot, link);
+		wheel_link(w, timer, w->now);
+	}
+}
+
+/* Put the timer into the slot of its deadline, but not before first */
+void wheel_link(WHEEL * w, TIMER * timer, time_t first)
+{
+	time_t expires = timer->due + 1;
+	time_t delta = 0;
+	int level = 0;
+
+	/* Overdue */
+	if (expires < first) {
+		expires = first;
+	}
+
+	/* Find the level whose range covers the deadline */
+	delta = expires - w->now;
+	for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+		if (delta < ((time_t) 1 << (WHEEL_BITS * (level + 1)))) {
+			break;
+		}
+	}
+
+	/* Too far away: Park it in the farthest slot of the last level */
+	if (delta >= ((time_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))) {
+		expires = w->now + ((time_t) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+	}
+
+	timer->list = &w->slot[level][(expires >> (WHEEL_BITS * level))
+				       & WHEEL_MASK];
+	ilist_put(timer->list, &timer->link);
+}
@@ -0,0 +1,77 @@
+/*
+Copyright 2006 Aiko Barz
+
+This file is part of torrentkino.
+
+torrentkino is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+torrentkino is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include <time.h>
+
+#include "config.h"
+#include "malloc.h"
+#include "list.h"
+
+/*
+ * Hierarchical timer wheel. One tick is whatever unit the owner counts in:
+ * Seconds for most of them, milliseconds for the lookup hops. Level 0 has
+ * one slot per tick, every further level covers WHEEL_SIZE slots of the
+ * level below. The slots of a level get cascaded into the level below whenever
+ * that one wraps around. Deadlines beyond the last level are parked in its
+ * farthest slot and pushed down until they fit.
+ *
+ * A TIMER is embedded into the object it belongs to. The owner converts it
+ * back with wheel_value() and tells its timers apart by type. The wheel has
+ * no lock of its own. It is protected by the lock of its owner.
+ */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 3
+
+struct obj_timer {
+	ILINK link;
+	ILIST *list;
+	time_t due;
+	int type;
+};
+typedef struct obj_timer TIMER;
+
+struct obj_wheel {
+	time_t now;
+	ILIST slot[WHEEL_LEVELS][WHEEL_SIZE];
+};
+typedef struct obj_wheel WHEEL;
+
+#define wheel_value(timer, type, member) \
+	((type *)((char *)(timer) - offsetof(type, member)))
+
+WHEEL *wheel_init(time_t now);
+void wheel_free(WHEEL * w);
+
+void wheel_add(WHEEL * w, TIMER * timer, time_t due, int type);
+void wheel_del(TIMER * timer);
+int wheel_pending(TIMER * timer);
+
+void wheel_expire(WHEEL * w, time_t now, ILIST * due);
+time_t wheel_due(WHEEL * w);
+TIMER *wheel_next(ILIST * due);
+void wheel_tick(WHEEL * w, ILIST * due);
+void wheel_cascade(WHEEL * w, int level);
+void wheel_link(WHEEL * w, TIMER * timer, time_t first);
+
+#endif				/* WHEEL_H */
@@ -346,14 +346,14 @@ void http_read(TCP_NODE * n, char *p_cmd, char *p_url, char *p_proto,
 
 		/* Header */
 		if ((r_head =
-		     resp_put(n->response, RESPONSE_FROM_MEMORY)) == NULL) {
+		     resp_put(&n->response, RESPONSE_FROM_MEMORY)) == NULL) {
 			node_status(n, NODE_SHUTDOWN);
 			goto END;
 		}
 
 		/* File */
 		if ((r_file =
-		     resp_put(n->response, RESPONSE_FROM_FILE)) == NULL) {
+		     resp_put(&n->response, RESPONSE_FROM_FILE)) == NULL) {
 			node_status(n, NODE_SHUTDOWN);
 			goto END;
 		}
@@ -380,14 +380,14 @@ void http_read(TCP_NODE * n, char *p_cmd, char *p_url, char *p_proto,
 
 		/* Header */
 		if ((r_head =
-		     resp_put(n->response, RESPONSE_FROM_MEMORY)) == NULL) {
+		     resp_put(&n->response, RESPONSE_FROM_MEMORY)) == NULL) {
 			node_status(n, NODE_SHUTDOWN);
 			goto END;
 		}
 
 		/* zsync bug? One more \r\n between header and body. */
 		if ((r_zsyncbug =
-		     resp_put(n->response, RESPONSE_FROM_MEMORY)) == NULL) {
+		     resp_put(&n->response, RESPONSE_FROM_MEMORY)) == NULL) {
 			node_status(n, NODE_SHUTDOWN);
 			goto END;
 		}
@@ -402,7 +402,7 @@ void http_read(TCP_NODE * n, char *p_cmd, char *p_url, char *p_proto,
 
 		/* Bottom */
 		if ((r_bottom =
-		     resp_put(n->response, RESPONSE_FROM_MEMORY)) == NULL) {
+		     resp_put(&n->response, RESPONSE_FROM_MEMORY)) == NULL) {
 			node_status(n, NODE_SHUTDOWN);
 			goto END;
 		}
@@ -441,7 +441,7 @@ void http_body(TCP_NODE * n, char *filename, size_t filesize)
 		return;
 	}
 
-	if ((r = resp_put(n->response, RESPONSE_FROM_FILE)) == NULL) {
+	if ((r = resp_put(&n->response, RESPONSE_FROM_FILE)) == NULL) {
 		return;
 	}
 
@@ -696,17 +696,17 @@ int http_range_complex(TCP_NODE * n, char *filename, size_t filesize,
 	RESPONSE *r_head = NULL, *r_file = NULL, *r_bottom = NULL;
 
 	/* Boundary head */
-	if ((r_head = resp_put(n->response, RESPONSE_FROM_MEMORY)) == NULL) {
+	if ((r_head = resp_put(&n->response, RESPONSE_FROM_MEMORY)) == NULL) {
 		return FALSE;
 	}
 
 	/* File */
-	if ((r_file = resp_put(n->response, RESPONSE_FROM_FILE)) == NULL) {
+	if ((r_file = resp_put(&n->response, RESPONSE_FROM_FILE)) == NULL) {
 		return FALSE;
 	}
 
 	/* Boundary bottom */
-	if ((r_bottom = resp_put(n->response, RESPONSE_FROM_MEMORY)) == NULL) {
+	if ((r_bottom = resp_put(&n->response, RESPONSE_FROM_MEMORY)) == NULL) {
 		return FALSE;
 	}
 
@@ -746,7 +746,7 @@ int http_range_complex(TCP_NODE * n, char *filename, size_t filesize,
 
 void http_404(TCP_NODE * n, char *keepalive)
 {
-	RESPONSE *r = resp_put(n->response, RESPONSE_FROM_MEMORY);
+	RESPONSE *r = resp_put(&n->response, RESPONSE_FROM_MEMORY);
 	char datebuf[DATE_SIZE];
 	char buffer[BUF_SIZE] =
 	    "<!DOCTYPE html>"
@@ -777,7 +777,7 @@ void http_404(TCP_NODE * n, char *keepalive)
 
 void http_304(TCP_NODE * n, char *keepalive)
 {
-	RESPONSE *r = resp_put(n->response, RESPONSE_FROM_MEMORY);
+	RESPONSE *r = resp_put(&n->response, RESPONSE_FROM_MEMORY);
 	char datebuf[DATE_SIZE];
 
 	if (r == NULL) {
@@ -797,7 +797,7 @@ void http_304(TCP_NODE * n, char *keepalive)
 void http_200(TCP_NODE * n, char *lastmodified, char *filename, size_t filesize,
 	      char *keepalive, const char *mimetype)
 {
-	RESPONSE *r = resp_put(n->response, RESPONSE_FROM_MEMORY);
+	RESPONSE *r = resp_put(&n->response, RESPONSE_FROM_MEMORY);
 	char datebuf[DATE_SIZE];
 
 	if (r == NULL) {
@@ -36,29 +36,30 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #include "tcp.h"
 #include "worker.h"
 
-LIST *node_init(void)
+ILIST *node_init(void)
 {
-	return list_init();
+	ILIST *list = (ILIST *) myalloc(sizeof(ILIST));
+	ilist_init(list);
+	return list;
 }
 
 void node_free(void)
 {
-	ITEM *i = NULL;
 	TCP_NODE *n = NULL;
 
-	while ((i = list_start(_main->node)) != NULL) {
-		n = list_value(i);
+	while ((n = ilist_value(ilist_start(_main->node), TCP_NODE, link))
+	       != NULL) {
 		node_status(n, NODE_SHUTDOWN);
-		node_shutdown(i);
+		node_shutdown(n);
 	}
 
-	list_free(_main->node);
+	myfree(_main->node);
 }
 
-ITEM *node_put(void)
+TCP_NODE *node_put(void)
 {
-	TCP_NODE *n = (TCP_NODE *) myalloc(sizeof(TCP_NODE));
-	ITEM *thisnode = NULL;
+	TCP_NODE *n = (TCP_NODE *) pool_alloc(POOL_TCP_NODE, sizeof(TCP_NODE));
+	ILINK *thisnode = NULL;
 
 	/* Address information */
 	n->c_addrlen = sizeof(IP);
@@ -75,38 +76,36 @@ ITEM *node_put(void)
 	n->keepalive = HTTP_UNDEF;
 
 	/* Respnses */
-	n->response = list_init();
+	resp_init(&n->response);
 
 	/* Connect node to the list */
 	mutex_block(_main->work->tcp_node);
-	thisnode = list_put(_main->node, n);
+	thisnode = ilist_put(_main->node, &n->link);
 	mutex_unblock(_main->work->tcp_node);
 
 	if (thisnode == NULL) {
-		list_free(n->response);
-		myfree(n);
+		pool_put(POOL_TCP_NODE, n);
+		return NULL;
 	}
 
-	return thisnode;
+	return n;
 }
 
-void node_shutdown(ITEM * thisnode)
+void node_shutdown(TCP_NODE * n)
 {
-	TCP_NODE *n = list_value(thisnode);
-
 	mutex_block(_main->work->tcp_node);
 
 	/* Disconnect */
 	node_disconnect(n->connfd);
 
 	/* Clear response list */
-	resp_free(n->response);
-
-	/* Delete node */
-	myfree(n);
+	resp_free(&n->response);
 
 	/* Unlink node object */
-	list_del(_main->node, thisnode);
+	ilist_del(_main->node, &n->link);
+
+	/* Delete node */
+	pool_put(POOL_TCP_NODE, n);
 
 	mutex_unblock(_main->work->tcp_node);
 }
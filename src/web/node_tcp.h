@@ -34,6 +34,7 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 #define NODE_SHUTDOWN 	5
 
 typedef struct {
+	ILINK link;
 	int connfd;
 	IP c_addr;
 	socklen_t c_addrlen;
@@ -49,16 +50,16 @@ typedef struct {
 	int pipeline;
 
 	/* Response list */
-	LIST *response;
+	ILIST response;
 
 } TCP_NODE;
 
-LIST *node_init(void);
+ILIST *node_init(void);
 void node_free(void);
 
-ITEM *node_put(void);
+TCP_NODE *node_put(void);
 void node_disconnect(int connfd);
-void node_shutdown(ITEM * thisnode);
+void node_shutdown(TCP_NODE * n);
 void node_status(TCP_NODE * n, int status);
 
 ssize_t node_appendBuffer(TCP_NODE * n, char *buffer, ssize_t bytes);
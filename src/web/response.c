@@ -34,27 +34,30 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "response.h"
 
-LIST *resp_init(void)
+void resp_init(ILIST * list)
 {
-	return list_init();
+	ilist_init(list);
 }
 
-void resp_free(LIST * list)
+void resp_free(ILIST * list)
 {
-	list_clear(list);
-	list_free(list);
+	RESPONSE *r = NULL;
+
+	while ((r = ilist_value(ilist_start(list), RESPONSE, link)) != NULL) {
+		resp_del(list, r);
+	}
 }
 
-RESPONSE *resp_put(LIST * list, int type)
+RESPONSE *resp_put(ILIST * list, int type)
 {
 	RESPONSE *r = NULL;
 
 	/* Enough */
-	if (list_size(list) > 100) {
+	if (ilist_size(list) > 100) {
 		return NULL;
 	}
 
-	r = (RESPONSE *) myalloc(sizeof(RESPONSE));
+	r = (RESPONSE *) pool_alloc(POOL_RESPONSE, sizeof(RESPONSE));
 
 	/* Init response */
 	if (type == RESPONSE_FROM_MEMORY) {
@@ -70,26 +73,22 @@ RESPONSE *resp_put(LIST * list, int type)
 	}
 
 	/* Connect response to the list */
-	list_put(list, r);
+	ilist_put(list, &r->link);
 
 	return r;
 }
 
-void resp_del(LIST * list, ITEM * item)
+void resp_del(ILIST * list, RESPONSE * r)
 {
-	RESPONSE *r = NULL;
-
 	if (list == NULL) {
 		return;
 	}
-	if (item == NULL) {
+	if (r == NULL) {
 		return;
 	}
 
-	r = list_value(item);
-	myfree(r);
-
-	list_del(list, item);
+	ilist_del(list, &r->link);
+	pool_put(POOL_RESPONSE, r);
 }
 
 int resp_set_memory(RESPONSE * r, const char *format, ...)
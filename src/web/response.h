@@ -38,6 +38,7 @@ typedef struct {
 } R_FILE;
 
 typedef struct {
+	ILINK link;
 	int type;
 
 	union {
@@ -46,11 +47,11 @@ typedef struct {
 	} data;
 } RESPONSE;
 
-LIST *resp_init(void);
-void resp_free(LIST * list);
+void resp_init(ILIST * list);
+void resp_free(ILIST * list);
 
-RESPONSE *resp_put(LIST * list, int TYPE);
-void resp_del(LIST * list, ITEM * item);
+RESPONSE *resp_put(ILIST * list, int TYPE);
+void resp_del(ILIST * list, RESPONSE * r);
 
 int resp_set_memory(RESPONSE * r, const char *format, ...);
 
@@ -78,21 +78,19 @@ void send_cork_start(TCP_NODE * n)
 
 void send_data(TCP_NODE * n)
 {
-	ITEM *i = NULL;
 	RESPONSE *r = NULL;
 
 	if (n->pipeline != NODE_SEND_DATA) {
 		return;
 	}
 
-	while (status == RUMBLE && list_size(n->response) > 0) {
-		i = list_start(n->response);
-		r = list_value(i);
+	while (status == RUMBLE && ilist_size(&n->response) > 0) {
+		r = ilist_value(ilist_start(&n->response), RESPONSE, link);
 
 		if (r->type == RESPONSE_FROM_MEMORY) {
-			send_mem(n, i);
+			send_mem(n, r);
 		} else {
-			send_file(n, i);
+			send_file(n, r);
 		}
 
 		if (n->pipeline == NODE_SHUTDOWN) {
@@ -103,9 +101,8 @@ void send_data(TCP_NODE * n)
 	node_status(n, NODE_SEND_STOP);
 }
 
-void send_mem(TCP_NODE * n, ITEM * item_r)
+void send_mem(TCP_NODE * n, RESPONSE * r)
 {
-	RESPONSE *r = list_value(item_r);
 	ssize_t bytes_sent = 0;
 	ssize_t bytes_todo = 0;
 	char *p = NULL;
@@ -131,15 +128,14 @@ void send_mem(TCP_NODE * n, ITEM * item_r)
 
 		/* Done */
 		if (r->data.memory.send_offset >= r->data.memory.send_size) {
-			resp_del(n->response, item_r);
+			resp_del(&n->response, r);
 			return;
 		}
 	}
 }
 
-void send_file(TCP_NODE * n, ITEM * item_r)
+void send_file(TCP_NODE * n, RESPONSE * r)
 {
-	RESPONSE *r = list_value(item_r);
 	ssize_t bytes_sent = 0;
 	ssize_t bytes_todo = 0;
 	int fh = 0;
@@ -176,7 +172,7 @@ void send_file(TCP_NODE * n, ITEM * item_r)
 
 		/* Done */
 		if (r->data.file.f_offset > r->data.file.f_stop) {
-			resp_del(n->response, item_r);
+			resp_del(&n->response, r);
 			return;
 		}
 	}
@@ -20,6 +20,6 @@ along with torrentkino.  If not, see <http://www.gnu.org/licenses/>.
 void send_tcp(TCP_NODE * n);
 void send_cork_start(TCP_NODE * n);
 void send_data(TCP_NODE * n);
-void send_mem(TCP_NODE * n, ITEM * item_r);
-void send_file(TCP_NODE * n, ITEM * item_r);
+void send_mem(TCP_NODE * n, RESPONSE * r);
+void send_file(TCP_NODE * n, RESPONSE * r);
 void send_cork_stop(TCP_NODE * n);
@@ -199,7 +199,7 @@ void *tcp_thread(void *arg)
 
 void tcp_worker(struct epoll_event *events, int nfds, int thrd_id)
 {
-	ITEM *listItem = NULL;
+	TCP_NODE *n = NULL;
 	int i;
 
 	mutex_block(_main->work->mutex);
@@ -210,16 +210,16 @@ void tcp_worker(struct epoll_event *events, int nfds, int thrd_id)
 		if (events[i].data.fd == _main->tcp->sockfd) {
 			tcp_newconn();
 		} else {
-			listItem = events[i].data.ptr;
+			n = events[i].data.ptr;
 
 			if (events[i].events & EPOLLIN) {
-				tcp_input(listItem);
+				tcp_input(n);
 			} else if (events[i].events & EPOLLOUT) {
-				tcp_output(listItem);
+				tcp_output(n);
 			}
 
 			/* Close, Input or Output next? */
-			tcp_gate(listItem);
+			tcp_gate(n);
 		}
 	}
 
@@ -228,30 +228,27 @@ void tcp_worker(struct epoll_event *events, int nfds, int thrd_id)
 	mutex_unblock(_main->work->mutex);
 }
 
-void tcp_gate(ITEM * listItem)
+void tcp_gate(TCP_NODE * n)
 {
-	TCP_NODE *n = list_value(listItem);
-
 	switch (n->pipeline) {
 	case NODE_SHUTDOWN:
-		node_shutdown(listItem);
+		node_shutdown(n);
 		break;
 	case NODE_READY:
-		tcp_rearm(listItem, TCP_INPUT);
+		tcp_rearm(n, TCP_INPUT);
 		break;
 	case NODE_SEND_INIT:
 	case NODE_SEND_DATA:
 	case NODE_SEND_STOP:
-		tcp_rearm(listItem, TCP_OUTPUT);
+		tcp_rearm(n, TCP_OUTPUT);
 		break;
 	default:
 		fail("No shit");
 	}
 }
 
-void tcp_rearm(ITEM * listItem, int mode)
+void tcp_rearm(TCP_NODE * n, int mode)
 {
-	TCP_NODE *n = list_value(listItem);
 	struct epoll_event ev;
 
 	memset(&ev, '\0', sizeof(struct epoll_event));
@@ -262,7 +259,7 @@ void tcp_rearm(ITEM * listItem, int mode)
 		ev.events = EPOLLET | EPOLLOUT | EPOLLONESHOT;
 	}
 
-	ev.data.ptr = listItem;
+	ev.data.ptr = n;
 
 	if (epoll_ctl(_main->tcp->epollfd, EPOLL_CTL_MOD, n->connfd, &ev) == -1) {
 		info(_log, NULL, strerror(errno));
@@ -287,7 +284,6 @@ int tcp_nonblocking(int sock)
 void tcp_newconn(void)
 {
 	struct epoll_event ev;
-	ITEM *listItem = NULL;
 	TCP_NODE *n = NULL;
 	int connfd;
 	IP c_addr;
@@ -310,14 +306,13 @@ void tcp_newconn(void)
 		}
 
 		/* New connection: Create node object */
-		if ((listItem = node_put()) == NULL) {
+		if ((n = node_put()) == NULL) {
 			info(_log, NULL, "The linked list reached its limits");
 			node_disconnect(connfd);
 			break;
 		}
 
 		/* Store data */
-		n = list_value(listItem);
 		n->connfd = connfd;
 		memcpy(&n->c_addr, &c_addr, c_addrlen);
 		n->c_addrlen = c_addrlen;
@@ -328,7 +323,7 @@ void tcp_newconn(void)
 		}
 
 		ev.events = EPOLLET | EPOLLIN | EPOLLONESHOT;
-		ev.data.ptr = listItem;
+		ev.data.ptr = n;
 		if (epoll_ctl
 		    (_main->tcp->epollfd, EPOLL_CTL_ADD, n->connfd,
 		     &ev) == -1) {
@@ -338,10 +333,8 @@ void tcp_newconn(void)
 	}
 }
 
-void tcp_output(ITEM * i)
+void tcp_output(TCP_NODE * n)
 {
-	TCP_NODE *n = list_value(i);
-
 	switch (n->pipeline) {
 	case NODE_SEND_INIT:
 	case NODE_SEND_DATA:
@@ -352,9 +345,8 @@ void tcp_output(ITEM * i)
 	}
 }
 
-void tcp_input(ITEM * listItem)
+void tcp_input(TCP_NODE * n)
 {
-	TCP_NODE *n = list_value(listItem);
 	char buffer[BUF_SIZE];
 	ssize_t bytes = 0;
 
@@ -49,10 +49,10 @@ void *tcp_thread(void *arg);
 void tcp_worker(struct epoll_event *events, int nfds, int thrd_id);
 
 void tcp_newconn(void);
-void tcp_output(ITEM * listItem);
-void tcp_input(ITEM * listItem);
-void tcp_gate(ITEM * listItem);
-void tcp_rearm(ITEM * listItem, int mode);
+void tcp_output(TCP_NODE * n);
+void tcp_input(TCP_NODE * n);
+void tcp_gate(TCP_NODE * n);
+void tcp_rearm(TCP_NODE * n, int mode);
 
 void tcp_buffer(TCP_NODE * n, char *buffer, ssize_t bytes);
 
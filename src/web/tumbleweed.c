@@ -121,6 +121,8 @@ int main(int argc, char **argv)
 
 	work_free();
 	conf_free();
+	pool_print();
+	pool_free();
 	log_free(_log);
 	main_free();
 
@@ -41,7 +41,7 @@ struct obj_main {
 #endif
 
 #ifdef TUMBLEWEED
-	struct obj_list *node;
+	struct obj_ilist *node;
 	struct obj_mdb *mime;
 	struct obj_tcp *tcp;
 #endif